@@ -499,6 +499,10 @@ protected:
  * at a periodic interval. This wraps an animation around a built in
  * timer to run the animation.
  *
+ * By default, the animation is stepped once per frame of the event loop's
+ * FrameClock, so all running animations advance together, in step with the
+ * display refresh.
+ *
  * @ingroup animation
  */
 class EGT_API AutoAnimation : public Animation
@@ -534,18 +538,33 @@ public:
     /**
      * Change the interval of the internal timer.
      *
-     * The internal timer defaults to an interval of 30ms.  See
-     * @ref Timer::change_duration() for more information on the ramifications
-     * of making this change on a running timer.
+     * Calling this stops the animation from following the FrameClock, and
+     * instead runs it from an internal timer with the specified interval.
+     * See @ref Timer::change_duration() for more information on the
+     * ramifications of making this change on a running timer.
      */
     void interval(std::chrono::milliseconds duration);
 
+    ~AutoAnimation() noexcept override;
+
 protected:
 
+    /// Start stepping the animation from the timer or the frame clock.
+    void schedule();
+
+    /// Remove the frame clock callback, if any.
+    void remove_frame_handler();
+
     /**
      * Periodic timer used to run the animation.
      */
     PeriodicTimer m_timer;
+
+    /// Frame clock callback handle, or 0 if not registered.
+    uint64_t m_frame_handle{0};
+
+    /// Run from m_timer instead of the frame clock.
+    bool m_use_timer{false};
 };
 
 /**
@@ -130,6 +130,8 @@ public:
 
     void draw(Painter& painter, const Rect& rect) override;
 
+    void prepare_draw(Painter& painter) override;
+
     /**
      * Add an event handler to be called when the widget receives an
      * EventId::pointer_click event.
@@ -267,6 +269,9 @@ public:
      */
     static void default_draw(const Switch& widget, Painter& painter, const Rect& rect);
 
+    /// The box is filled with the label background, which is not checked.
+    EGT_NODISCARD bool opaque() const override { return false; }
+
     using Button::min_size_hint;
 
     EGT_NODISCARD Size min_size_hint() const override;
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_DETAIL_GLYPHCACHE_H
+#define EGT_DETAIL_GLYPHCACHE_H
+
+#include <array>
+#include <atomic>
+#include <cairo.h>
+#include <cstddef>
+#include <cstdint>
+#include <egt/detail/meta.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+/**
+ * Internal cache of the extents of code points in a scaled font.
+ *
+ * Measuring text with cairo_text_extents() converts it to glyphs and looks up
+ * every glyph in the font, which adds up when text is measured one code point
+ * at a time, as editing and moving the cursor in a TextBox does.  A GlyphCache
+ * measures each code point once: code points up to U+00FF are kept in an
+ * array, and the others in a hash map.
+ *
+ * A cache is attached to its scaled font as user data, so there is one per
+ * scaled font and it is released with it.  Lookups may be done from any
+ * thread.
+ */
+class EGT_API GlyphCache
+{
+public:
+
+    /**
+     * Get the cache of a scaled font.
+     */
+    static GlyphCache& get(cairo_scaled_font_t* font);
+
+    /**
+     * Get the cache of the current scaled font of a context.
+     */
+    static GlyphCache& get(cairo_t* cr)
+    {
+        return get(cairo_get_scaled_font(cr));
+    }
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    /**
+     * Get the extents of a code point.
+     */
+    const cairo_text_extents_t& extents(uint32_t code_point);
+
+    /**
+     * Get the advance of a code point.
+     */
+    double advance(uint32_t code_point)
+    {
+        return extents(code_point).x_advance;
+    }
+
+    /**
+     * Get the extents of UTF-8 text, like cairo_text_extents() does.
+     *
+     * The extents are combined from the extents of the code points, so the
+     * text is not looked up in the font again.  Invalid UTF-8 has empty
+     * extents.
+     */
+    void extents(const char* begin, const char* end, cairo_text_extents_t& te);
+
+    /// @copydoc extents(const char*, const char*, cairo_text_extents_t&)
+    void extents(const std::string& text, cairo_text_extents_t& te)
+    {
+        extents(text.data(), text.data() + text.size(), te);
+    }
+
+    /**
+     * Get the advance of UTF-8 text.
+     */
+    double advance(const char* begin, const char* end);
+
+    /// @copydoc advance(const char*, const char*)
+    double advance(const std::string& text)
+    {
+        return advance(text.data(), text.data() + text.size());
+    }
+
+    /**
+     * Get the number of code points measured.
+     */
+    EGT_NODISCARD size_t size() const;
+
+private:
+
+    explicit GlyphCache(cairo_scaled_font_t* font) noexcept;
+
+    /// Measure a code point in the font.
+    void measure(uint32_t code_point, cairo_text_extents_t& te) const;
+
+    /// Code points below this are in the array.
+    static constexpr uint32_t DENSE_SIZE = 256;
+
+    /// The scaled font, which owns the cache.
+    cairo_scaled_font_t* m_font;
+
+    /// Extents of code points below DENSE_SIZE.
+    std::array<cairo_text_extents_t, DENSE_SIZE> m_dense{};
+
+    /// Set once the extents in m_dense are written.
+    std::array<std::atomic<bool>, DENSE_SIZE> m_dense_valid{};
+
+    /// Extents of other code points.
+    std::unordered_map<uint32_t, cairo_text_extents_t> m_sparse;
+
+    /// Guards m_sparse and the writing of m_dense.
+    mutable std::mutex m_mutex;
+};
+
+}
+}
+}
+
+#endif
@@ -6,11 +6,15 @@
 #ifndef EGT_DETAIL_IMAGECACHE_H
 #define EGT_DETAIL_IMAGECACHE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <egt/detail/meta.h>
 #include <egt/painter.h>
-#include <map>
+#include <egt/respath.h>
+#include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace egt
 {
@@ -26,13 +30,28 @@ namespace detail
  * prevents multiple attempts at loading the same file as well as re-scaling
  * the image to the same scale multiple times.
  *
- * This is a trade off in consuming more memory instead of possibly
- * constantly reloading or scaling the same image.
+ * The total size of the cached surfaces is limited by a budget.  When a new
+ * surface would go over the budget, the least recently used surfaces are
+ * released.  Surfaces that are still in use somewhere else, for example by an
+ * Image, are pinned and never released by the cache.
  */
 class EGT_API ImageCache
 {
 public:
 
+    /// Image cache statistics.
+    struct Stats
+    {
+        /// Number of get() calls served from the cache.
+        uint64_t hits{0};
+        /// Number of get() calls that had to load or scale an image.
+        uint64_t misses{0};
+        /// Number of surfaces released to stay in the budget.
+        uint64_t evictions{0};
+    };
+
+    ImageCache();
+
     /**
      * Get an image surface.
      */
@@ -40,22 +59,171 @@ public:
                                float hscale = 1.0, float vscale = 1.0,
                                bool approximate = true);
 
+    /**
+     * Get an image surface only if it is already in the cache.
+     *
+     * @return nullptr if the image is not in the cache.
+     */
+    shared_cairo_surface_t find(const std::string& uri,
+                                float hscale = 1.0, float vscale = 1.0,
+                                bool approximate = true);
+
+    /**
+     * Add an image surface that was loaded elsewhere, for example on another
+     * thread, so that get() returns it.
+     */
+    void add(const std::string& uri, const shared_cairo_surface_t& surface,
+             float hscale = 1.0, float vscale = 1.0,
+             bool approximate = true);
+
     /**
      * Clear the image cache.
      */
     void clear();
 
+    /**
+     * Set the budget, in bytes, for all surfaces.
+     *
+     * A budget of 0 means no limit.
+     */
+    void budget(size_t bytes);
+
+    /**
+     * Get the budget, in bytes, for all surfaces.
+     */
+    EGT_NODISCARD size_t budget() const { return m_budget; }
+
+    /**
+     * Get the number of bytes used by all surfaces, including pinned ones.
+     */
+    EGT_NODISCARD size_t used() const { return m_used; }
+
+    /**
+     * Get the number of surfaces in the cache.
+     */
+    EGT_NODISCARD size_t size() const { return m_entries.size(); }
+
+    /**
+     * Get statistics.
+     */
+    EGT_NODISCARD const Stats& stats() const { return m_stats; }
+
+    /**
+     * Set the format opaque images are converted to.
+     *
+     * This is normally the format of the screen.  Images without any
+     * transparent pixels are converted once, when they are loaded, so that
+     * drawing them is a copy instead of a format conversion on every paint.
+     * Only formats without alpha, CAIRO_FORMAT_RGB16_565 and
+     * CAIRO_FORMAT_RGB24, are used.  Any other format, like the default
+     * CAIRO_FORMAT_INVALID, leaves images in the format they were decoded to.
+     */
+    void native_format(cairo_format_t format) { m_native_format = format; }
+
+    /**
+     * Get the format opaque images are converted to.
+     */
+    EGT_NODISCARD cairo_format_t native_format() const { return m_native_format; }
+
+    /**
+     * Load an image without using the cache.
+     *
+     * This does not use any state of the cache, so it may be called from any
+     * thread for the resource and filesystem schemes.
+     *
+     * @param[in] type Scheme of the path, as returned by resolve_path().
+     * @param[in] path Resolved path.
+     */
+    static shared_cairo_surface_t load(SchemeType type, const std::string& path);
+
+    /**
+     * Load a scaled image from its closest pre-scaled variant.
+     *
+     * Variants are resources named "<name>@<scale>", or
+     * "<name>@<hscale>x<vscale>", registered with ResourceManager next to the
+     * original.  The variant is used as is if it has the requested scale, and
+     * is scaled the rest of the way otherwise.  Like load(), this may be
+     * called from any thread.
+     *
+     * @param[in] name Name of the original resource.
+     * @param[in] hscale Horizontal scale.
+     * @param[in] vscale Vertical scale.
+     * @return nullptr if there is no variant closer to the scale than the
+     *         original.
+     */
+    static shared_cairo_surface_t load_variant(const std::string& name,
+            float hscale, float vscale);
+
+    /**
+     * Convert an opaque surface to a format without alpha.
+     *
+     * Like load(), this may be called from any thread.
+     *
+     * @param[in] surface The surface.
+     * @param[in] format CAIRO_FORMAT_RGB16_565 or CAIRO_FORMAT_RGB24.
+     * @return @p surface itself if it has transparent pixels, already has
+     *         the format, or @p format is not one of the above.
+     */
+    static shared_cairo_surface_t convert_opaque(const shared_cairo_surface_t& surface,
+            cairo_format_t format);
+
     static shared_cairo_surface_t scale_surface(const shared_cairo_surface_t& old_surface,
             float old_width, float old_height,
             float new_width, float new_height);
 
 protected:
 
+    /// Cache key.
+    struct Key
+    {
+        /// URI of the image.
+        std::string uri;
+        /// Bit pattern of the horizontal scale.
+        uint32_t hscale;
+        /// Bit pattern of the vertical scale.
+        uint32_t vscale;
+
+        bool operator==(const Key& rhs) const
+        {
+            return hscale == rhs.hscale && vscale == rhs.vscale && uri == rhs.uri;
+        }
+    };
+
+    /// Hash of a Key.
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const noexcept;
+    };
+
+    /// Cached surface.
+    struct Entry
+    {
+        /// The surface.
+        shared_cairo_surface_t surface;
+        /// Size of the surface in bytes.
+        size_t bytes{0};
+        /// Position in the LRU list.
+        std::list<const Key*>::iterator lru;
+    };
+
+    /// Add a surface to the cache.
+    void insert(Key key, const shared_cairo_surface_t& surface);
+
+    /// Release unpinned surfaces until @p bytes more fit in the budget.
+    void evict(size_t bytes);
+
     static float round(float v, float fraction);
 
-    static std::string id(const std::string& name, float hscale, float vscale);
+    static Key key(const std::string& name, float hscale, float vscale,
+                   bool approximate);
 
-    std::map<std::string, shared_cairo_surface_t> m_cache;
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    /// Keys of all entries, most recently used first.
+    std::list<const Key*> m_lru;
+    size_t m_budget;
+    size_t m_used{0};
+    Stats m_stats;
+    cairo_format_t m_native_format{CAIRO_FORMAT_INVALID};
 };
 
 /**
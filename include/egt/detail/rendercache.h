@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_DETAIL_RENDERCACHE_H
+#define EGT_DETAIL_RENDERCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <egt/detail/meta.h>
+#include <egt/geometry.h>
+#include <egt/types.h>
+#include <list>
+#include <unordered_map>
+
+namespace egt
+{
+inline namespace v1
+{
+class Widget;
+
+namespace detail
+{
+
+/**
+ * Internal render cache.
+ *
+ * Holds the retained rendering of widgets with Widget::Flag::cached.  Each
+ * widget gets an offscreen surface the size of its box that is drawn once
+ * and then copied to the screen until the widget, or one of its children, is
+ * damaged.
+ *
+ * The total size of all surfaces is limited by a budget.  When a new surface
+ * would go over the budget, the least recently drawn surfaces are released.
+ */
+class EGT_API RenderCache
+{
+public:
+
+    /// Retained rendering of a widget.
+    struct Entry
+    {
+        /// Offscreen surface.
+        shared_cairo_surface_t surface;
+        /// Size of the surface.
+        Size size;
+        /// Size of the surface in bytes.
+        size_t bytes{0};
+        /// The surface holds the current rendering of the widget.
+        bool valid{false};
+        /// Position in the LRU list.
+        std::list<const Widget*>::iterator lru;
+    };
+
+    /// Render cache statistics.
+    struct Stats
+    {
+        /// Number of draws served from a valid surface.
+        uint64_t hits{0};
+        /// Number of draws that had to render the widget.
+        uint64_t misses{0};
+        /// Number of surfaces released to stay in the budget.
+        uint64_t evictions{0};
+    };
+
+    RenderCache();
+
+    /**
+     * Get the entry of a widget, creating a surface for it if needed.
+     *
+     * The entry is moved to the front of the LRU list.  Returns nullptr if a
+     * surface of this size does not fit in the budget.
+     */
+    Entry* get(const Widget* widget, const Size& size);
+
+    /**
+     * Mark the rendering of a widget as up to date.
+     *
+     * Does nothing if the entry was released in the meantime.
+     */
+    void validate(const Widget* widget);
+
+    /**
+     * Mark the rendering of a widget as out of date.
+     *
+     * The surface is kept so it can be drawn into again.
+     */
+    void invalidate(const Widget* widget);
+
+    /**
+     * Release the surface of a widget.
+     */
+    void remove(const Widget* widget);
+
+    /**
+     * Release all surfaces.
+     */
+    void clear();
+
+    /**
+     * Set the budget, in bytes, for all surfaces.
+     */
+    void budget(size_t bytes);
+
+    /**
+     * Get the budget, in bytes, for all surfaces.
+     */
+    EGT_NODISCARD size_t budget() const { return m_budget; }
+
+    /**
+     * Get the number of bytes used by all surfaces.
+     */
+    EGT_NODISCARD size_t used() const { return m_used; }
+
+    /**
+     * Get statistics.
+     */
+    EGT_NODISCARD const Stats& stats() const { return m_stats; }
+
+    /// @private
+    void hit() { ++m_stats.hits; }
+
+    /// @private
+    void miss() { ++m_stats.misses; }
+
+protected:
+
+    /// Release surfaces until @p bytes more fit in the budget.
+    void evict(size_t bytes);
+
+    std::unordered_map<const Widget*, Entry> m_entries;
+    std::list<const Widget*> m_lru;
+    size_t m_budget;
+    size_t m_used{0};
+    Stats m_stats;
+};
+
+/**
+ * Global render cache instance.
+ */
+EGT_API RenderCache& render_cache();
+
+}
+}
+}
+
+#endif
@@ -106,6 +106,13 @@ public:
 
     uint32_t index() override;
 
+    /**
+     * Get statistics of the flip queue.
+     *
+     * All values are zero when the plane has a single buffer.
+     */
+    EGT_NODISCARD FlipStats flip_stats() const;
+
 protected:
     /// Plane instance pointer.
     unique_plane_t m_plane;
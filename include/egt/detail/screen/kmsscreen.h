@@ -74,6 +74,15 @@ public:
 
     uint32_t index() override;
 
+    /**
+     * Get statistics of the flip queue.
+     *
+     * All values are zero when the plane has a single buffer.
+     */
+    EGT_NODISCARD FlipStats flip_stats() const;
+
+    EGT_NODISCARD std::chrono::steady_clock::time_point presentation_time() const override;
+
     /// Close and release the screen.
     void close();
 
@@ -6,6 +6,9 @@
 #ifndef EGT_DETAIL_SCREEN_KMSTYPE_H
 #define EGT_DETAIL_SCREEN_KMSTYPE_H
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 struct plane_data;
@@ -29,6 +32,37 @@ struct plane_t_deleter
 using unique_plane_t =
     std::unique_ptr<plane_data, detail::plane_t_deleter>;
 
+/**
+ * Statistics of a plane flip queue.
+ *
+ * When the queue is full, scheduling a flip blocks until the display has
+ * released a buffer.  A growing blocked count means drawing is waiting on
+ * the display instead of the other way around.
+ */
+struct FlipStats
+{
+    /// Maximum number of queued flips.
+    size_t capacity{0};
+    /// Number of flips currently queued.
+    size_t depth{0};
+    /// Highest number of flips that were queued at once.
+    size_t max_depth{0};
+    /// Number of completed flips.
+    uint64_t flips{0};
+    /// Number of times scheduling a flip had to wait for a free slot.
+    uint64_t blocked{0};
+    /// Total time spent waiting for a free slot.
+    std::chrono::microseconds blocked_time{0};
+    /// Time from queuing to completion of the last flip.
+    std::chrono::microseconds latency{0};
+    /// Highest flip latency.
+    std::chrono::microseconds max_latency{0};
+    /// Average flip latency.
+    std::chrono::microseconds average_latency{0};
+    /// Total damaged area, in pixels, of all flipped buffers.
+    uint64_t damage_area{0};
+};
+
 }
 }
 }
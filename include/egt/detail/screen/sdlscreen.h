@@ -49,7 +49,9 @@ public:
     void schedule_flip() override
     {}
 
-    void flip(const DamageArray& damage) override;
+    using Screen::flip;
+
+    void flip(const Region& damage) override;
 
     void quit()
     {
@@ -62,7 +64,7 @@ protected:
 
     void pointer_event(EventId e, const Pointer& pointer);
     void key_event(EventId e, const Key& key);
-    void sdl_draw(const DamageArray& damage);
+    void sdl_draw(const Region& damage);
     static KeyboardCode sdl_to_egtkeys(int key);
 
     /// @private
@@ -53,7 +53,9 @@ public:
     void schedule_flip() override
     {}
 
-    void flip(const DamageArray& damage) override;
+    using Screen::flip;
+
+    void flip(const Region& damage) override;
 
     /// Disable window decorations
     void disable_window_decorations();
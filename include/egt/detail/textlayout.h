@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_DETAIL_TEXTLAYOUT_H
+#define EGT_DETAIL_TEXTLAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <egt/detail/meta.h>
+#include <egt/font.h>
+#include <egt/geometry.h>
+#include <egt/text.h>
+#include <egt/types.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+class Image;
+class Painter;
+class Pattern;
+
+namespace detail
+{
+
+/**
+ * Internal text layout.
+ *
+ * Holds text laid out by draw_text(): the glyphs of every code point,
+ * positioned relative to the box of the text, along with what is needed to
+ * draw a selection and a cursor.  Laying out text means tokenizing it,
+ * measuring every token, and running a flex layout, while drawing a layout is
+ * only a cairo_show_glyphs() call.
+ *
+ * A layout is only computed again when the text, the font, the size of the
+ * box, or one of the flags or alignments it was computed with changes, so
+ * widgets keep one to draw unchanged text again without any of that work.
+ */
+class EGT_API TextLayout
+{
+public:
+
+    /**
+     * Lay out text, unless it is already laid out with the same arguments.
+     *
+     * @param[in] painter Painter used to measure the text.
+     * @param[in] size Size of the box of the text.
+     * @param[in] text The text.
+     * @param[in] font Font of the text.
+     * @param[in] flags Text flags, only multiline and word_wrap are used.
+     * @param[in] text_align Alignment of the text in the box.
+     * @param[in] justify Justification of the text.
+     * @param[in] image_align Alignment of the image relative to the text.
+     * @param[in] image_size Size of the image, or empty if there is none.
+     * @return true if the text was laid out again.
+     */
+    bool layout(Painter& painter,
+                const Size& size,
+                const std::string& text,
+                const Font& font,
+                const TextBox::TextFlags& flags,
+                const AlignFlags& text_align,
+                Justification justify,
+                const AlignFlags& image_align = {},
+                const Size& image_size = {});
+
+    /**
+     * Draw the text.
+     *
+     * @param[in] painter Painter to draw with.
+     * @param[in] point Origin of the box of the text.
+     * @param[in] text_color Color of the text.
+     * @param[in] image The image, if the text was laid out with one.
+     * @param[in] draw_cursor Callback to draw the cursor.
+     * @param[in] cursor_pos Position of the cursor, in code points.
+     * @param[in] highlight_color Color of the selection.
+     * @param[in] select_start Start of the selection, in code points.
+     * @param[in] select_len Length of the selection, in code points.
+     */
+    void draw(Painter& painter,
+              const Point& point,
+              const Pattern& text_color,
+              const Image* image = nullptr,
+              const std::function<void(const Point& offset, size_t height)>& draw_cursor = nullptr,
+              size_t cursor_pos = 0,
+              const Pattern* highlight_color = nullptr,
+              size_t select_start = 0,
+              size_t select_len = 0) const;
+
+    /**
+     * Forget the layout, so the next call to layout() computes it.
+     */
+    void clear();
+
+    /**
+     * Get the number of glyphs in the layout.
+     */
+    EGT_NODISCARD size_t glyph_count() const { return m_glyphs.size(); }
+
+    /**
+     * Get the number of times the text was laid out.
+     */
+    EGT_NODISCARD uint64_t layouts() const { return m_layouts; }
+
+protected:
+
+    /// A laid out code point.
+    struct CodePoint
+    {
+        /// Left of the code point, relative to the box.
+        float x;
+        /// Top of the line of the code point, relative to the box.
+        float y;
+        /// Advance of the code point.
+        float width;
+        /// Height of the line of the code point.
+        float height;
+    };
+
+    /// Text the layout was computed for.
+    std::string m_text;
+    /// Font the layout was computed for.
+    Font m_font;
+    /// Box size the layout was computed for.
+    Size m_size;
+    /// Flags the layout was computed for.
+    TextBox::TextFlags m_flags;
+    /// Text alignment the layout was computed for.
+    AlignFlags m_text_align;
+    /// Justification the layout was computed for.
+    Justification m_justify{Justification::start};
+    /// Image alignment the layout was computed for.
+    AlignFlags m_image_align;
+    /// Image size the layout was computed for.
+    Size m_image_size;
+    /// The layout was computed.
+    bool m_valid{false};
+
+    /// Glyphs of the text, positioned relative to the box.
+    std::vector<cairo_glyph_t> m_glyphs;
+    /// Code points that can have the cursor or be selected.
+    std::vector<CodePoint> m_code_points;
+    /// Position of the image, relative to the box.
+    Point m_image_point;
+    /// Position of the cursor after the last code point, relative to the box.
+    Point m_end;
+    /// Height of a line.
+    float m_line_height{0};
+    /// Number of times the text was laid out.
+    uint64_t m_layouts{0};
+};
+
+}
+}
+}
+
+#endif
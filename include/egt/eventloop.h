@@ -27,6 +27,8 @@ inline namespace v1
 {
 class Application;
 
+class FrameClock;
+
 namespace detail
 {
 class PriorityQueue;
@@ -50,17 +52,25 @@ public:
      */
     asio::io_context& io();
 
+    /**
+     * Get the frame clock that paces animations and drawing.
+     */
+    FrameClock& frame_clock();
+
     /**
      * Perform a draw.
      *
      * @note You do not normally need to call this directly.  It is called by
-     * step() and run() automatically.
+     * step() and the frame clock automatically.
      */
     void draw();
 
     /**
      * Run the event loop.
      *
+     * While running, damage is not drawn after every batch of events, but
+     * once per frame of the frame_clock().
+     *
      * This will not return until quit() is called.
      *
      * @return The number of events handled.
@@ -109,6 +119,22 @@ public:
      */
     void add_idle_callback(IdleCallback func);
 
+    /**
+     * Run work on a background thread, then a callback on the event loop.
+     *
+     * Work is run by a small pool of worker threads owned by the event loop.
+     * When the event loop is destroyed, the pool is joined before io() is, so
+     * work never outlives it.  Work that has not started by then is dropped.
+     *
+     * @param work Function run on a worker thread.  It must not touch any
+     *        widget or other state of the event loop.
+     * @param done Function invoked from the event loop once @p work is done,
+     *        unless @p work returns false.
+     *
+     * @note Must be called from the event loop thread.
+     */
+    void async_work(std::function<bool ()> work, std::function<void ()> done);
+
     /// @private
     detail::PriorityQueue& queue();
 
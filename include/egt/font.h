@@ -16,7 +16,9 @@
 #include <egt/types.h>
 #include <iosfwd>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace egt
 {
@@ -78,6 +80,11 @@ public:
     /**
      * Create a font from an in-memory font.
      *
+     * The font is read from @p data, without a copy, whenever glyphs are
+     * loaded, so the memory must stay valid for as long as this font, or any
+     * copy of it, is used.  All sizes of the font and its copies share one
+     * FreeType face.
+     *
      * @param[in] data Raw memory to the font.
      * @param[in] len Size of bytes of the ram memory.
      * @param[in] size The size of the font.
@@ -173,8 +180,9 @@ public:
     /**
      * Generates a FontConfig scaled font instance.
      *
-     * Internally, this may use a font cache to limit regeneration of the same
-     * font more than once.
+     * Internally, this uses a font cache to limit regeneration of the same
+     * font more than once.  The scaled fonts of all the sizes of a font share
+     * the same font face.
      */
     EGT_NODISCARD cairo_scaled_font_t* scaled_font() const;
 
@@ -198,6 +206,21 @@ public:
      */
     void on_screen_resized();
 
+    /**
+     * Load fonts ahead of time, typically at startup.
+     *
+     * The first time a font is drawn, its face is opened with FreeType, or
+     * matched by Fontconfig, and its glyphs are loaded.  Preloading does this
+     * for the fonts an application uses, along with the metrics of the
+     * printable ASCII glyphs, so that the first paint of each screen does not
+     * stall on it.  Fonts that cannot be loaded are skipped.
+     *
+     * @code{.cpp}
+     * Font::preload({Font(16), Font(24, Font::Weight::bold)});
+     * @endcode
+     */
+    static void preload(const std::vector<Font>& fonts);
+
     /**
      * Clears any internal font cache.
      *
@@ -234,6 +257,8 @@ protected:
 
     /// Only used when an in-memory font is created.
     mutable shared_cairo_scaled_font_t m_scaled_font;
+    /// Face of an in-memory font, shared by the scaled fonts of every size.
+    mutable std::shared_ptr<cairo_font_face_t> m_font_face;
     const unsigned char* m_data{nullptr};
     size_t m_len{0};
 
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_FRAMECLOCK_H
+#define EGT_FRAMECLOCK_H
+
+/**
+ * @file
+ * @brief Display synchronized frame clock.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <egt/detail/meta.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace egt
+{
+namespace asio
+{
+class io_context;
+}
+
+inline namespace v1
+{
+
+/**
+ * Frame pacing statistics of a FrameClock.
+ */
+struct FrameStats
+{
+    /// Number of frames dispatched.
+    uint64_t frames{0};
+    /// Number of refresh periods that passed without a frame while one was requested.
+    uint64_t missed{0};
+    /// Time between the last two frames.
+    std::chrono::microseconds interval{0};
+    /// Longest time between two consecutive frames.
+    std::chrono::microseconds max_interval{0};
+    /// Time it took to dispatch the last frame.
+    std::chrono::microseconds dispatch{0};
+};
+
+/**
+ * Clock that paces updates and rendering to the display refresh.
+ *
+ * Instead of every animation running its own timer and the event loop
+ * drawing after every batch of events, anything that needs a new frame calls
+ * request_frame().  No matter how many requests are made, the clock
+ * dispatches at most one frame per refresh period: first all
+ * Phase::update callbacks, which advance animations, then all Phase::paint
+ * callbacks, which render.
+ *
+ * Frames are aligned to the presentation time reported by the screen when it
+ * is able to, for example when KMS page flips complete, or to a steady clock
+ * running at the refresh interval otherwise.
+ *
+ * The EventLoop owns the frame clock used by the application.
+ */
+class EGT_API FrameClock
+{
+public:
+
+    /// Clock used for frame times.
+    using clock = std::chrono::steady_clock;
+
+    /// Frame callback, given the target time of the frame.
+    using FrameCallback = std::function<void(clock::time_point)>;
+
+    /// Function returning the time the display last presented a frame.
+    using PresentationSource = std::function<clock::time_point()>;
+
+    /// Handle type used to remove a callback.
+    using RegisterHandle = uint64_t;
+
+    /// Stage of a frame a callback is run in.
+    enum class Phase
+    {
+        /// Advance animations and other state.
+        update,
+        /// Render.
+        paint,
+    };
+
+    /**
+     * @param[in] io The io_context the clock runs on.
+     * @param[in] interval Refresh interval of the display.
+     */
+    explicit FrameClock(asio::io_context& io,
+                        std::chrono::microseconds interval = std::chrono::microseconds(16667));
+
+    FrameClock(const FrameClock&) = delete;
+    FrameClock& operator=(const FrameClock&) = delete;
+    FrameClock(FrameClock&&) = delete;
+    FrameClock& operator=(FrameClock&&) = delete;
+
+    /**
+     * Request that a frame be dispatched at the next refresh.
+     *
+     * Multiple requests before the frame is dispatched are coalesced.  A
+     * request made while a frame is being dispatched is for the next frame,
+     * and is scheduled once the current frame is done.
+     */
+    void request_frame();
+
+    /**
+     * Returns true if a frame is requested and not dispatched yet.
+     */
+    EGT_NODISCARD bool frame_pending() const { return m_pending; }
+
+    /**
+     * Returns true while frame callbacks are being invoked.
+     */
+    EGT_NODISCARD bool dispatching() const { return m_dispatching; }
+
+    /**
+     * Returns true while Phase::paint callbacks are being invoked.
+     */
+    EGT_NODISCARD bool painting() const
+    {
+        return m_dispatching && m_phase == Phase::paint;
+    }
+
+    /**
+     * Register a callback invoked every time a frame is dispatched.
+     *
+     * Callbacks are not a request for frames.  A callback that needs another
+     * frame, like a running animation, must call request_frame() again.
+     */
+    RegisterHandle on_frame(FrameCallback callback, Phase phase = Phase::update);
+
+    /**
+     * Remove a callback registered with on_frame().
+     */
+    void remove_handler(RegisterHandle handle);
+
+    /**
+     * Set the refresh interval.
+     */
+    void interval(std::chrono::microseconds interval);
+
+    /**
+     * Get the refresh interval.
+     */
+    EGT_NODISCARD std::chrono::microseconds interval() const { return m_interval; }
+
+    /**
+     * Set the source of presentation timestamps used to align frames.
+     *
+     * When the source returns a default constructed time_point, frames are
+     * aligned to the clock's own previous frames.
+     */
+    void presentation_source(PresentationSource source);
+
+    /**
+     * Target time of the current, or last, frame.
+     */
+    EGT_NODISCARD clock::time_point frame_time() const { return m_frame_time; }
+
+    /**
+     * Get frame pacing statistics.
+     */
+    EGT_NODISCARD const FrameStats& stats() const { return m_stats; }
+
+    /**
+     * Dispatch a frame now, regardless of any request.
+     */
+    void dispatch();
+
+    ~FrameClock() noexcept;
+
+protected:
+
+    /// Compute the target time of the next frame.
+    clock::time_point next_frame_time(clock::time_point now) const;
+
+    /// Dispatch a frame with the specified target time.
+    void run_frame(clock::time_point time);
+
+    /// Run all callbacks of a phase.
+    void invoke_handlers(Phase phase);
+
+    /// @private
+    struct CallbackMeta
+    {
+        CallbackMeta(FrameCallback c, Phase p, RegisterHandle h) noexcept
+            : callback(std::move(c)),
+              phase(p),
+              handle(h)
+        {}
+
+        FrameCallback callback;
+        Phase phase;
+        RegisterHandle handle{0};
+    };
+
+    struct FrameClockImpl;
+
+    /// Internal implementation.
+    std::unique_ptr<FrameClockImpl> m_impl;
+
+    /// Registered callbacks.
+    std::vector<CallbackMeta> m_callbacks;
+
+    /// Callbacks registered while dispatching.
+    std::vector<CallbackMeta> m_added;
+
+    /// Counter used to generate unique handles.
+    RegisterHandle m_handle_counter{0};
+
+    /// Refresh interval.
+    std::chrono::microseconds m_interval;
+
+    /// Presentation timestamp source.
+    PresentationSource m_presentation;
+
+    /// Target time of the last frame.
+    clock::time_point m_frame_time;
+
+    /// Frame requested and timer armed.
+    bool m_pending{false};
+
+    /// Currently invoking callbacks.
+    bool m_dispatching{false};
+    /// Phase of the callbacks being invoked.
+    Phase m_phase{Phase::update};
+    /// Frame requested while dispatching.
+    bool m_requested{false};
+
+    /// Frame pacing statistics.
+    FrameStats m_stats;
+};
+
+}
+}
+
+#endif
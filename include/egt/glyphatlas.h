@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_GLYPHATLAS_H
+#define EGT_GLYPHATLAS_H
+
+/**
+ * @file
+ * @brief Pre-rendered glyphs of a font.
+ */
+
+#include <cstdint>
+#include <egt/detail/meta.h>
+#include <egt/font.h>
+#include <egt/geometry.h>
+#include <egt/image.h>
+#include <egt/types.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace egt
+{
+inline namespace v1
+{
+
+class Painter;
+
+/**
+ * The glyphs of a font, rendered once into a single alpha only image.
+ *
+ * Drawing text through cairo rasterizes glyphs with FreeType the first time
+ * they are used, and again whenever they are evicted from the glyph cache of
+ * cairo.  A glyph atlas holds the glyphs of a font at a fixed size already
+ * rendered, and draws each of them as an alpha mask of the current source,
+ * which pixman blends with its SIMD paths.
+ *
+ * Once added with add_glyph_atlas(), an atlas is used for all text laid out
+ * by widgets with its font, as long as it is drawn without scaling.  Glyphs
+ * that are not in the atlas are still drawn by cairo.
+ *
+ * An atlas is either rendered at runtime for a Font, or pre-rendered with the
+ * gfx-convert tool and loaded from an A8 image and an index with one line per
+ * glyph:
+ *
+ *     code_point x y width height x_offset y_offset
+ *
+ * The offsets are from the origin of the glyph to its top left corner.  Empty
+ * lines and lines starting with '#' are ignored.
+ *
+ * @b Example
+ * @code{.cpp}
+ * add_glyph_atlas(GlyphAtlas(Font(16)));
+ *
+ * // or pre-rendered with: gfx-convert --glyph-atlas sans16 --font-size 16
+ * add_glyph_atlas(GlyphAtlas(Font(16), "file:sans16.eraw", "file:sans16.glyphs"));
+ * @endcode
+ *
+ * @ingroup media
+ */
+class EGT_API GlyphAtlas
+{
+public:
+
+    /**
+     * Printable ASCII and Latin-1 characters, rendered by default.
+     */
+    static const std::string& default_characters();
+
+    /**
+     * Render the glyphs of a font.
+     *
+     * @param font The font.
+     * @param characters UTF-8 characters to render the glyphs of.
+     */
+    explicit GlyphAtlas(const Font& font,
+                        const std::string& characters = default_characters());
+
+    /**
+     * Load pre-rendered glyphs of a font.
+     *
+     * @param font The font the glyphs were rendered with.
+     * @param uri Resource path of the atlas image. @see @ref resources
+     * @param index Resource path of the atlas index.
+     * @throws std::runtime_error if the image or index cannot be read.
+     */
+    GlyphAtlas(const Font& font, const std::string& uri, const std::string& index);
+
+    /**
+     * Save the atlas to NAME.eraw and its index to NAME.glyphs.
+     *
+     * @throws std::runtime_error if the files cannot be written.
+     */
+    void save(const std::string& name) const;
+
+    /**
+     * Draw glyphs of the font of the atlas, like cairo_show_glyphs(), with the
+     * current source of a context.
+     *
+     * The glyphs found in the atlas are combined into one mask, composited
+     * once for the whole run.  If the context is scaled or rotated, all glyphs
+     * are drawn by cairo.
+     */
+    void draw(cairo_t* cr, const cairo_glyph_t* glyphs, size_t count) const;
+
+    /**
+     * Draw text with the current source of the painter.
+     *
+     * @param painter The painter.
+     * @param point Origin of the first glyph, on the baseline.
+     * @param text UTF-8 text.
+     */
+    void draw(Painter& painter, const Point& point, const std::string& text) const;
+
+    /**
+     * Returns true if the atlas has the glyphs of a scaled font, when drawn
+     * without scaling and with the same font options, like antialiasing and
+     * hinting.
+     */
+    EGT_NODISCARD bool matches(cairo_scaled_font_t* scaled_font) const;
+
+    /**
+     * Returns true if the atlas has the glyph of a code point.
+     */
+    EGT_NODISCARD bool contains(uint32_t code_point) const;
+
+    /**
+     * Get the number of glyphs.
+     */
+    EGT_NODISCARD size_t size() const { return m_glyphs.size(); }
+
+    /**
+     * Get the font of the glyphs.
+     */
+    EGT_NODISCARD const Font& font() const { return m_font; }
+
+    /**
+     * Get the atlas image itself.
+     */
+    EGT_NODISCARD const Image& atlas() const { return m_atlas; }
+
+protected:
+
+    /// A glyph in the atlas.
+    struct Glyph
+    {
+        /// Code point of the glyph.
+        uint32_t code_point;
+        /// Position and size of the glyph in the atlas, empty for blank glyphs.
+        Rect rect;
+        /// Offset from the origin of the glyph to its top left corner.
+        Point offset;
+    };
+
+    /// Get the face, matrix and options of the font.
+    void init_font();
+
+    /// Create a context on a surface, with the font of the atlas.
+    shared_cairo_t context(cairo_surface_t* surface) const;
+
+    /// Add a glyph in the atlas.
+    void add(unsigned long index, uint32_t code_point, const Rect& rect, const Point& offset);
+
+    /// Font of the glyphs.
+    Font m_font;
+
+    /// Font face of the glyphs.
+    std::shared_ptr<cairo_font_face_t> m_face;
+
+    /// Font matrix of the glyphs.
+    cairo_matrix_t m_font_matrix{};
+
+    /// Font options of the glyphs.
+    std::shared_ptr<cairo_font_options_t> m_font_options;
+
+    /// The whole atlas, in CAIRO_FORMAT_A8.
+    Image m_atlas;
+
+    /// Glyphs by glyph index.
+    std::unordered_map<unsigned long, Glyph> m_glyphs;
+};
+
+/**
+ * Use an atlas to draw the text laid out by widgets with its font.
+ *
+ * Adding another atlas for the same font replaces it.  Atlases are meant to
+ * be added before drawing starts: each thread drawing text keeps the atlases
+ * it used last, until it draws again after they changed.
+ */
+EGT_API void add_glyph_atlas(const GlyphAtlas& atlas);
+
+/**
+ * Remove the atlas added with add_glyph_atlas() for a font.
+ */
+EGT_API void remove_glyph_atlas(const Font& font);
+
+namespace detail
+{
+
+/**
+ * Draw glyphs like cairo_show_glyphs(), through the glyph atlas of the current
+ * font if one was added with add_glyph_atlas().
+ */
+EGT_API void show_glyphs(cairo_t* cr, const cairo_glyph_t* glyphs, size_t count);
+
+}
+
+}
+}
+
+#endif
@@ -16,7 +16,9 @@
 #include <egt/geometry.h>
 #include <egt/painter.h>
 #include <egt/serialize.h>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
 namespace egt
@@ -26,6 +28,11 @@ inline namespace v1
 
 class SvgImage;
 
+namespace detail
+{
+struct AsyncImageLoad;
+}
+
 /**
  * Raster image resource used for drawing or displaying.
  *
@@ -80,6 +87,65 @@ public:
      */
     void load(const std::string& uri, float hscale = 1.0, float vscale = 1.0, bool approx = false);
 
+    /// Callback invoked with the result of load_async().
+    using LoadCallback = std::function<void(const Image&)>;
+
+    /**
+     * Handle of an image being loaded with load_async().
+     *
+     * Destroying the handle, or calling cancel(), cancels the load so the
+     * callback is never invoked.
+     */
+    class EGT_API AsyncLoad
+    {
+    public:
+
+        AsyncLoad() noexcept = default;
+        AsyncLoad(const AsyncLoad&) = delete;
+        AsyncLoad& operator=(const AsyncLoad&) = delete;
+        AsyncLoad(AsyncLoad&&) noexcept = default;
+        AsyncLoad& operator=(AsyncLoad&& rhs) noexcept;
+
+        /**
+         * Cancel the load, if it is still pending.
+         */
+        void cancel() noexcept;
+
+        /**
+         * Returns true if the load is not finished or cancelled yet.
+         */
+        EGT_NODISCARD bool pending() const;
+
+        ~AsyncLoad() noexcept;
+
+    private:
+
+        explicit AsyncLoad(std::shared_ptr<detail::AsyncImageLoad> state) noexcept;
+
+        std::shared_ptr<detail::AsyncImageLoad> m_state;
+
+        friend class Image;
+    };
+
+    /**
+     * Load an image in the background.
+     *
+     * Images from the filesystem and from resources are decoded, and scaled,
+     * on a pool of worker threads so the event loop keeps running.  Once done,
+     * @p callback is invoked from the event loop with the image, which is also
+     * added to the image cache.  If the image could not be loaded, the callback
+     * gets an empty image.  Other images are loaded from the event loop.
+     *
+     * @param uri Resource path. @see @ref resources
+     * @param callback Invoked with the loaded image.
+     * @param hscale Horizontal scale of the image, with 1.0 being 100%.
+     * @param vscale Vertical scale of the image, with 1.0 being 100%.
+     * @return Handle that must be kept for as long as the result is wanted.
+     */
+    EGT_NODISCARD static AsyncLoad load_async(const std::string& uri,
+            LoadCallback callback,
+            float hscale = 1.0, float vscale = 1.0);
+
     /**
      * @param surface A pre-existing surface.
      *
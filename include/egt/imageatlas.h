@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_IMAGEATLAS_H
+#define EGT_IMAGEATLAS_H
+
+/**
+ * @file
+ * @brief Packing many small images into one.
+ */
+
+#include <egt/detail/meta.h>
+#include <egt/geometry.h>
+#include <egt/image.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+
+/**
+ * A single image holding many smaller named images.
+ *
+ * Loading hundreds of small icons as separate images costs a surface, and a
+ * heap allocation for its pixels, per icon and scatters the pixels around
+ * memory.  An atlas loads them as one surface.  The Image returned by
+ * image() is a surface of its own, but its pixels are the ones of the atlas,
+ * so nothing is copied and drawing it reads straight from the atlas.
+ *
+ * The index of an atlas is a text file with one line per image:
+ *
+ *     x y width height name
+ *
+ * Empty lines and lines starting with '#' are ignored.  The gfx-convert tool
+ * packs a set of PNG files into an atlas image and its index.
+ *
+ * @b Example
+ * @code{.cpp}
+ * ImageAtlas icons("file:icons.eraw", "file:icons.atlas");
+ * ImageButton button(icons.image("calculator.png"));
+ *
+ * // or make the images available with the atlas: scheme
+ * add_image_atlas("icons", icons);
+ * ImageButton button2(Image("atlas:icons/calculator.png"));
+ * @endcode
+ *
+ * @ingroup media
+ */
+class EGT_API ImageAtlas
+{
+public:
+
+    ImageAtlas() = default;
+
+    /**
+     * Load an atlas.
+     *
+     * @param uri Resource path of the atlas image. @see @ref resources
+     * @param index Resource path of the atlas index.
+     */
+    ImageAtlas(const std::string& uri, const std::string& index);
+
+    /**
+     * Use an existing image as an atlas.
+     *
+     * Images are then added with add().
+     */
+    explicit ImageAtlas(const Image& image);
+
+    /**
+     * Load an atlas, replacing the current one.
+     *
+     * @param uri Resource path of the atlas image. @see @ref resources
+     * @param index Resource path of the atlas index.
+     * @throws std::runtime_error if the image or index cannot be read.
+     */
+    void load(const std::string& uri, const std::string& index);
+
+    /**
+     * Add a named image.
+     *
+     * @param name Name of the image.
+     * @param rect Position and size of the image in the atlas.
+     * @throws std::out_of_range if @p rect is not inside the atlas.
+     */
+    void add(const std::string& name, const Rect& rect);
+
+    /**
+     * Returns true if there is an image named @p name.
+     */
+    EGT_NODISCARD bool contains(const std::string& name) const
+    {
+        return m_rects.find(name) != m_rects.end();
+    }
+
+    /**
+     * Get the position and size of an image in the atlas.
+     *
+     * Returns an empty Rect if there is no image named @p name.
+     */
+    EGT_NODISCARD Rect rect(const std::string& name) const;
+
+    /**
+     * Get an image.
+     *
+     * The image shares the pixels of the atlas.  Returns an empty Image if
+     * there is no image named @p name.
+     */
+    EGT_NODISCARD Image image(const std::string& name) const;
+
+    /**
+     * Get the names of all images.
+     */
+    EGT_NODISCARD std::vector<std::string> names() const;
+
+    /**
+     * Get the number of images.
+     */
+    EGT_NODISCARD size_t size() const { return m_rects.size(); }
+
+    /**
+     * Get the atlas image itself.
+     */
+    EGT_NODISCARD const Image& atlas() const { return m_atlas; }
+
+protected:
+
+    /// The whole atlas.
+    Image m_atlas;
+
+    /// Named images in the atlas.
+    std::unordered_map<std::string, Rect> m_rects;
+};
+
+/**
+ * Make the images of an atlas available with the atlas: URI scheme.
+ *
+ * An image is then loaded, and cached, with "atlas:<name>/<image>".
+ * Registering another atlas with the same name replaces it.  Atlases may be
+ * registered while images are loaded on other threads.
+ *
+ * @param name Name of the atlas in URIs.
+ * @param atlas The atlas.
+ */
+EGT_API void add_image_atlas(const std::string& name, const ImageAtlas& atlas);
+
+/**
+ * Remove an atlas registered with add_image_atlas().
+ *
+ * Images already loaded from the atlas keep its pixels alive.
+ */
+EGT_API void remove_image_atlas(const std::string& name);
+
+namespace detail
+{
+
+/**
+ * Read the text index of an atlas.
+ *
+ * @param index Resource path of the index.
+ * @throws std::runtime_error if the index cannot be read.
+ */
+EGT_API std::string read_atlas_index(const std::string& index);
+
+/**
+ * Create a surface for part of an atlas that uses the pixels of the atlas in
+ * place, when they are aligned for pixman, or a copy of them.
+ *
+ * The new surface holds a reference to the atlas.
+ */
+EGT_API shared_cairo_surface_t alias_surface(const shared_cairo_surface_t& atlas,
+        const Rect& rect);
+
+/**
+ * Load an image from an atlas registered with add_image_atlas().
+ *
+ * @param path Atlas name and image name, separated with a '/'.
+ */
+EGT_API shared_cairo_surface_t load_image_from_atlas(const std::string& path);
+
+}
+
+}
+}
+
+#endif
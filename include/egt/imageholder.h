@@ -143,15 +143,37 @@ public:
      */
     void uri(const std::string& uri)
     {
+        m_async_load.cancel();
         m_image.uri(uri);
         refresh();
     }
 
+    /**
+     * Load a new Image from an uri in the background.
+     *
+     * The current image stays displayed until the new one is loaded, then it
+     * is replaced.  Setting another image, or destroying the widget, cancels
+     * the load.
+     *
+     * @param[in] uri The URI of the image to load.
+     *
+     * @see Image::load_async().
+     */
+    void uri_async(const std::string& uri)
+    {
+        m_async_load = Image::load_async(uri, [this](const Image & image)
+        {
+            if (!image.empty())
+                do_set_image(image);
+        }, m_image.hscale(), m_image.vscale());
+    }
+
     /**
      * Reset the URI, therefore clear the current image, if any.
      */
     void reset_uri()
     {
+        m_async_load.cancel();
         m_image.reset_uri();
         refresh();
     }
@@ -214,6 +236,7 @@ public:
      */
     void image(const Image& image)
     {
+        m_async_load.cancel();
         do_set_image(image);
     }
 
@@ -345,6 +368,19 @@ public:
         Drawer<ImageHolder>::draw(*this, painter, rect);
     }
 
+    void prepare_draw(Painter& painter) override
+    {
+        if (show_label())
+        {
+            if (!image().empty())
+                this->layout_text(painter, image_align(), image().size());
+            else
+                this->layout_text(painter);
+        }
+
+        Widget::prepare_draw(painter);
+    }
+
     /// Default draw method for the widget.
     static void default_draw(ImageHolder& widget, Painter& painter, const Rect& rect)
     {
@@ -359,6 +395,7 @@ public:
             if (!widget.image().empty())
             {
                 detail::draw_text(painter,
+                                  widget.text_layout(),
                                   widget.content_area(),
                                   text,
                                   widget.font(),
@@ -372,6 +409,7 @@ public:
             else
             {
                 detail::draw_text(painter,
+                                  widget.text_layout(),
                                   widget.content_area(),
                                   text,
                                   widget.font(),
@@ -498,6 +536,9 @@ protected:
 
     /// Alignment of the image relative to the text.
     AlignFlags m_image_align{AlignFlag::left | AlignFlag::expand};
+
+    /// Image being loaded by uri_async().
+    Image::AsyncLoad m_async_load;
 };
 
 }
@@ -105,6 +105,8 @@ public:
 
     void draw(Painter& painter, const Rect& rect) override;
 
+    void prepare_draw(Painter& painter) override;
+
     /// Default draw method for the widget.
     static void default_draw(const Label& widget, Painter& painter, const Rect& rect);
 
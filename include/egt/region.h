@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_REGION_H
+#define EGT_REGION_H
+
+/**
+ * @file
+ * @brief Working with regions.
+ */
+
+#include <egt/detail/meta.h>
+#include <egt/geometry.h>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+
+/**
+ * A set of non-overlapping rectangles describing an arbitrary area.
+ *
+ * The rectangles are stored in y-x banded form: the region is split into
+ * horizontal bands, every rectangle in a band has the same top and height,
+ * rectangles inside a band are sorted by x and never touch, and consecutive
+ * bands with identical horizontal spans are coalesced.  This is the same
+ * representation used by pixman and X11 regions, and it means the union of
+ * two rectangles never covers more pixels than the rectangles themselves.
+ *
+ * @ingroup geometry
+ */
+class EGT_API Region
+{
+public:
+
+    /// Type used for the array of rectangles.
+    using RectArray = std::vector<Rect>;
+
+    /// Iterator over the rectangles of the region.
+    using const_iterator = RectArray::const_iterator;
+
+    Region() noexcept = default;
+
+    /**
+     * @param[in] rect Initial rectangle of the region.
+     */
+    explicit Region(const Rect& rect);
+
+    /**
+     * @param[in] rects Rectangles to union into the region.  They may overlap.
+     */
+    explicit Region(const RectArray& rects);
+
+    /**
+     * Union a rectangle into the region.
+     */
+    void add(const Rect& rect);
+
+    /**
+     * Union another region into this region.
+     */
+    void add(const Region& region);
+
+    /**
+     * Remove a rectangle from the region.
+     */
+    void subtract(const Rect& rect);
+
+    /**
+     * Remove another region from this region.
+     */
+    void subtract(const Region& region);
+
+    /**
+     * Clip the region to a rectangle.
+     */
+    void intersect(const Rect& rect);
+
+    /**
+     * Move every rectangle in the region by the specified offset.
+     */
+    void translate(const Point& offset);
+
+    /**
+     * Returns true if any part of the rectangle is inside the region.
+     */
+    EGT_NODISCARD bool intersects(const Rect& rect) const;
+
+    /**
+     * Returns true if the rectangle is completely inside the region.
+     */
+    EGT_NODISCARD bool contains(const Rect& rect) const;
+
+    /**
+     * Union a rectangle into the region, growing it to cover neighbours.
+     *
+     * The rectangle is replaced by its bounding box with a rectangle of a
+     * band it overlaps or touches when the area of the bounding box not
+     * already covered is at most @p max_waste of the bounding box area.
+     * This is repeated until no more neighbours can be merged.  Only the
+     * bands around the rectangle are looked at, so the cost does not depend
+     * on the size of the rest of the region.
+     *
+     * @param[in] rect Rectangle to union into the region.
+     * @param[in] max_waste Fraction, from 0 to 1, of wasted area allowed.
+     */
+    void merge(const Rect& rect, float max_waste);
+
+    /**
+     * Merge rectangles whose bounding box wastes little area.
+     *
+     * The region is rebuilt by merging its rectangles one at a time with
+     * merge().
+     *
+     * @param[in] max_waste Fraction, from 0 to 1, of wasted area allowed.
+     */
+    void simplify(float max_waste);
+
+    /**
+     * Get the bounding box of the region.
+     */
+    EGT_NODISCARD const Rect& extents() const { return m_extents; }
+
+    /**
+     * Get the total area covered by the region.
+     */
+    EGT_NODISCARD DefaultDim area() const;
+
+    /**
+     * Returns true if the region covers no area.
+     */
+    EGT_NODISCARD bool empty() const { return m_rects.empty(); }
+
+    /**
+     * Get the number of rectangles in the region.
+     */
+    EGT_NODISCARD size_t size() const { return m_rects.size(); }
+
+    /**
+     * Remove all rectangles from the region.
+     */
+    void clear()
+    {
+        m_rects.clear();
+        m_extents.clear();
+    }
+
+    /**
+     * Reserve storage for a number of rectangles.
+     */
+    void reserve(size_t count)
+    {
+        m_rects.reserve(count);
+    }
+
+    /// Get the first rectangle.
+    EGT_NODISCARD const Rect& front() const { return m_rects.front(); }
+
+    /// Get the array of rectangles.
+    EGT_NODISCARD const RectArray& rects() const { return m_rects; }
+
+    /// Iterator to the first rectangle.
+    EGT_NODISCARD const_iterator begin() const { return m_rects.begin(); }
+
+    /// Iterator past the last rectangle.
+    EGT_NODISCARD const_iterator end() const { return m_rects.end(); }
+
+protected:
+
+    /// Recompute m_extents from m_rects.
+    void update_extents();
+
+    /// Index range of the rectangles in the bands overlapping [y1, y2).
+    EGT_NODISCARD std::pair<size_t, size_t> bands(DefaultDim y1, DefaultDim y2) const;
+
+    /// Area of the rectangle covered by the region.
+    EGT_NODISCARD DefaultDim covered(const Rect& rect) const;
+
+    /// Banded array of rectangles.
+    RectArray m_rects;
+
+    /// Bounding box of all rectangles.
+    Rect m_extents;
+};
+
+/// Region operator
+inline bool operator==(const Region& lhs, const Region& rhs)
+{
+    return lhs.rects() == rhs.rects();
+}
+
+/// Region operator
+inline bool operator!=(const Region& lhs, const Region& rhs)
+{
+    return !(lhs == rhs);
+}
+
+/// Overloaded std::ostream insertion operator
+EGT_API std::ostream& operator<<(std::ostream& os, const Region& region);
+
+}
+}
+
+#endif
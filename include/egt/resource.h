@@ -15,6 +15,9 @@
 #include <cstdint>
 #include <egt/detail/meta.h>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -23,6 +26,11 @@ namespace egt
 inline namespace v1
 {
 
+namespace detail
+{
+class ResourceBundle;
+}
+
 /**
  * Manages EGT resource data blobs.
  *
@@ -31,6 +39,10 @@ inline namespace v1
  * prefix the name in the URI with scheme 'res' to make EGT read the resource
  * from ResourceManager.
  *
+ * Resources compressed with gzip are inflated when their data is first used.
+ * The inflated data is kept until trim() is called, and streaming reads with
+ * stream_read() inflate as they go without keeping the inflated data at all.
+ *
  * @see @ref resources
  */
 class EGT_API ResourceManager
@@ -81,9 +93,35 @@ public:
 
     /**
      * Get a pointer to the in-memory resource data.
+     *
+     * For a compressed resource, the pointer is valid until trim() is called.
      */
     const unsigned char* data(const char* name);
 
+    /// Shared pointer to resource data.
+    using SharedData = std::shared_ptr<const unsigned char>;
+
+    /**
+     * Get the in-memory resource data and its length.
+     *
+     * Unlike data(), the returned pointer keeps the inflated data of a
+     * compressed resource alive, even if trim() is called or the resource is
+     * removed.
+     *
+     * @param[in] name Name of the resource.
+     * @param[out] len Length of the data.
+     * @return nullptr if the resource does not exist.
+     */
+    SharedData share(const char* name, size_t& len);
+
+    /**
+     * Release the inflated data of compressed resources.
+     *
+     * Data still in use through share() is released once it is no longer
+     * used.  Resources are inflated again the next time they are used.
+     */
+    void trim();
+
     /**
      * Read data from a resource.
      */
@@ -98,6 +136,58 @@ public:
      */
     EGT_NODISCARD ItemArray list() const;
 
+    /**
+     * Get the names of the pre-scaled variants of a resource.
+     *
+     * Variants are named "<name>@<tag>", like the ones mresg generates with
+     * --scale.  They are indexed as resources are added, and the resources of
+     * a bundle the first time variants are looked up after it is added.
+     *
+     * @param name Name of the original resource.
+     */
+    ItemArray variants(const char* name);
+
+    /**
+     * Add a resource bundle file.
+     *
+     * The bundle is memory mapped, and a resource in it is looked up with its
+     * index the first time it is used, so adding a bundle costs the same no
+     * matter how many resources it holds.  A name is looked up among the
+     * resources added with add() first, and then in the bundles, the most
+     * recently added first.  Removing a resource that comes from a bundle only
+     * releases what was loaded from it.
+     *
+     * @param path Path of the bundle.
+     * @throws std::runtime_error if the bundle cannot be opened.
+     */
+    void add_bundle(const std::string& path);
+
+    /**
+     * Add a resource bundle already in memory.
+     *
+     * @warning This does not copy the data, so it must remain available.
+     *
+     * @param data The bundle.
+     * @param len Length of the bundle.
+     * @throws std::runtime_error if the bundle is invalid.
+     */
+    void add_bundle(const unsigned char* data, size_t len);
+
+    /**
+     * Write registered resources to a bundle file.
+     *
+     * Compressed resources are written compressed, and are flagged so in the
+     * bundle.
+     *
+     * @param path Path of the bundle.
+     * @param names Names of the resources, or all resources if empty.
+     * @param alignment Alignment of each resource in the file.  Page aligned
+     *            resources can be used straight from the mapped bundle.
+     * @throws std::runtime_error on failure.
+     */
+    void save_bundle(const std::string& path, const ItemArray& names = {},
+                     size_t alignment = 4096);
+
     /**
      * Reset internal read stream offset.
      *
@@ -107,6 +197,9 @@ public:
 
     /**
      * Read starting from internal stream offset.
+     *
+     * A compressed resource is inflated directly into @p data, so it is never
+     * held in memory inflated as a whole.
      */
     bool stream_read(const char* name, unsigned char* data, size_t length);
 
@@ -118,7 +211,28 @@ private:
 
     using ResourceMap = std::map<std::string, ResourceItem>;
 
+    /// Find a resource, resolving it from the bundles the first time.
+    ResourceMap::iterator lookup(const char* name);
+
+    /// Add a name to m_variants if it is the name of a variant.
+    void index_variant(const std::string& name);
+
+    /// Remove a name from m_variants.
+    void unindex_variant(const std::string& name);
+
     ResourceMap m_resources;
+
+    /// Bundles, most recently added last.
+    std::vector<std::shared_ptr<detail::ResourceBundle>> m_bundles;
+
+    /// Names of variants, by the name of their original.
+    std::map<std::string, std::set<std::string>> m_variants;
+
+    /// Number of bundles, from the first one, in m_variants.
+    size_t m_indexed_bundles{0};
+
+    /// Protects all of the above, which image loading threads also use.
+    mutable std::mutex m_mutex;
 };
 
 namespace detail
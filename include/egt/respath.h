@@ -53,6 +53,7 @@ enum class SchemeType
     resource,
     filesystem,
     network,
+    atlas,
 };
 
 /**
@@ -12,8 +12,10 @@
  */
 
 #include <cairo.h>
+#include <chrono>
 #include <egt/detail/meta.h>
 #include <egt/geometry.h>
+#include <egt/region.h>
 #include <egt/types.h>
 #include <iosfwd>
 #include <memory>
@@ -39,6 +41,21 @@ public:
      */
     using DamageArray = std::vector<Rect>;
 
+    /**
+     * Policy used to merge damage rectangles.
+     *
+     * @see damage_policy()
+     */
+    enum class DamagePolicy
+    {
+        /// Keep exactly the damaged pixels, never merge rectangles.
+        exact,
+        /// Merge rectangles only if the wasted area is below a threshold.
+        cost,
+        /// Always merge all damage into one bounding box.
+        bounding_box,
+    };
+
     Screen() noexcept;
     Screen(const Screen&) = default;
     Screen& operator=(const Screen&) = default;
@@ -53,7 +70,38 @@ public:
      *
      * @note This will call schedule_flip() automatically.
      */
-    virtual void flip(const DamageArray& damage);
+    virtual void flip(const Region& damage);
+
+    /// @copydoc flip(const Region&)
+    void flip(const DamageArray& damage)
+    {
+        flip(Region(damage));
+    }
+
+    /**
+     * Get the region to draw for a frame with the specified damage.
+     *
+     * When the screen renders directly into its buffers, the buffer that is
+     * about to be drawn still holds the content of an older frame.  In that
+     * case this returns the union of the damage of this frame and of every
+     * frame since the buffer was last drawn, or the whole screen if that is
+     * unknown.  Otherwise, this returns @p damage.
+     *
+     * @see direct_render()
+     */
+    EGT_NODISCARD Region frame_damage(const Region& damage);
+
+    /**
+     * Returns true if drawing happens directly into the screen buffers,
+     * without a composition buffer.
+     *
+     * This is enabled with the EGT_DIRECT_RENDER environment variable for
+     * screens with more than one buffer.
+     *
+     * @see direct_render_requested()  It removes the copy from the
+     * composition buffer on every flip.
+     */
+    EGT_NODISCARD bool direct_render() const { return m_direct; }
 
     /**
      * Schedule a flip to occur later.
@@ -69,6 +117,17 @@ public:
      */
     virtual uint32_t index() { return 0; }
 
+    /**
+     * Get the time the display last presented a new buffer.
+     *
+     * This is used to align frames to the display refresh.  A default
+     * constructed time_point means the screen does not know.
+     */
+    EGT_NODISCARD virtual std::chrono::steady_clock::time_point presentation_time() const
+    {
+        return {};
+    }
+
     /**
      * Size of the screen.
      */
@@ -88,15 +147,46 @@ public:
 
     /**
      * This function implements the algorithm for adding damage rectangles
-     * to a list.
+     * to a region.
      *
-     * @param[in,out] damage The starting and ending damage array.
+     * The rectangle is added to the region and then rectangles are merged
+     * according to the current damage_policy().
+     *
+     * @param[in,out] damage The starting and ending damage region.
      * @param[in] rect The new rectangle to add.
+     */
+    static void damage_algorithm(Region& damage, const Rect& rect);
+
+    /**
+     * @copybrief damage_algorithm(Region&, const Rect&)
      *
-     * @note This function may be implemented to be recursive.
+     * @param[in,out] damage The starting and ending damage array.
+     * @param[in] rect The new rectangle to add.
      */
     static void damage_algorithm(Screen::DamageArray& damage, Rect rect);
 
+    /**
+     * Set the policy used to merge damage rectangles.
+     *
+     * With DamagePolicy::cost, two rectangles are merged into their bounding
+     * box only if the area of the bounding box not actually damaged is at
+     * most @p max_waste of the bounding box.  A new rectangle is only
+     * merged with the rectangles of the bands around it, and once the
+     * damage holds too many rectangles it is replaced by its bounding box.
+     *
+     * The default can be changed with the EGT_DAMAGE_POLICY environment
+     * variable.
+     *
+     * @param[in] policy The merge policy.
+     * @param[in] max_waste Fraction, from 0 to 1, of wasted area allowed.
+     */
+    static void damage_policy(DamagePolicy policy, float max_waste = 0.25f);
+
+    /**
+     * Get the policy used to merge damage rectangles.
+     */
+    static DamagePolicy damage_policy();
+
     /**
      * Set if asynchronous buffer flips are used.
      */
@@ -105,6 +195,28 @@ public:
         m_async = async;
     }
 
+    /**
+     * Enable tiled damage tracking for screen buffers.
+     *
+     * Instead of remembering damage rectangles for each screen buffer, the
+     * screen is divided into square tiles and the frame that last damaged
+     * each tile is recorded.  On flip, only the tiles touched since the
+     * current buffer was last updated are copied, coalesced into runs of
+     * tiles per row.  This bounds the bytes copied per frame when there are
+     * more than two buffers.
+     *
+     * The default can be changed with the EGT_SCREEN_TILE_SIZE environment
+     * variable.
+     *
+     * @param[in] size Width and height of a tile in pixels, or 0 to disable.
+     */
+    void tile_size(DefaultDim size);
+
+    /**
+     * Get the size of damage tiles, or 0 if tiled damage tracking is disabled.
+     */
+    EGT_NODISCARD DefaultDim tile_size() const { return m_tile_size; }
+
     /**
      * Get the max brightness of the screen.
      *
@@ -179,6 +291,15 @@ protected:
         init(nullptr, 0, size, format);
     }
 
+    /**
+     * Returns true if init() should draw directly into the buffers when
+     * there is more than one.
+     *
+     * By default, this is enabled with the EGT_DIRECT_RENDER environment
+     * variable.
+     */
+    EGT_NODISCARD virtual bool direct_render_requested() const;
+
     /// @private
     struct ScreenBuffer
     {
@@ -191,9 +312,15 @@ protected:
         unique_cairo_surface_t surface;
 
         /**
-         * Each rect that needs to be copied from the back buffer.
+         * Region that needs to be copied from the back buffer.
          */
-        DamageArray damage;
+        Region damage;
+
+        /**
+         * Frame number of the last copy to this buffer, when tiled damage
+         * tracking is enabled.
+         */
+        uint32_t frame{0};
 
         void add_damage(const Rect& rect)
         {
@@ -207,6 +334,15 @@ protected:
     /// Copy the framebuffer to the current composition buffer.
     void copy_to_buffer_software(ScreenBuffer& buffer);
 
+    /// Record damage in the tile map for the current frame.
+    void damage_tiles(const Region& damage);
+
+    /// Get the runs of tiles damaged after the specified frame.
+    EGT_NODISCARD Region tile_damage(uint32_t frame) const;
+
+    /// Point the composition surface and context at the current buffer.
+    void select_direct_buffer();
+
     /// Composition surface.
     shared_cairo_surface_t m_surface;
 
@@ -227,6 +363,30 @@ protected:
 
     /// Format of the screen.
     PixelFormat m_format{};
+
+    /// Size of damage tiles, or 0 if tiled damage tracking is disabled.
+    DefaultDim m_tile_size{0};
+
+    /// Number of tile columns.
+    DefaultDim m_tile_columns{0};
+
+    /// Number of tile rows.
+    DefaultDim m_tile_rows{0};
+
+    /// Frame number that last damaged each tile.
+    std::vector<uint32_t> m_tiles;
+
+    /// Current frame number.
+    uint32_t m_frame{0};
+
+    /// Drawing happens directly into the screen buffers.
+    bool m_direct{false};
+
+    /// Damage of the last frames when drawing directly into screen buffers.
+    std::vector<Region> m_history;
+
+    /// Bounding box of the damage in the buffer passed to schedule_flip().
+    Rect m_flip_damage;
 };
 
 }
@@ -49,6 +49,14 @@ inline namespace v1
  * auto img_box = custom1svg.id_box("#right_blink");
  * @endcode
  *
+ * Rendered images are kept in the image cache, keyed by URI, element id,
+ * size and clip rect, so rendering the same element again, even from another
+ * SvgImage instance, does not call librsvg.  The parsed SVG of the most
+ * recently loaded URIs is also shared by instances.  Both are also keyed by
+ * the modification time of a file, or the content of a resource, so a
+ * changed SVG is never drawn from a stale cache.  Images needed at startup
+ * can be rendered ahead of time on another thread with prerender().
+ *
  * @note Some standard effects in SVG files are expensive to render. For
  * example, some patterns and gradients.  In those cases, you can convert
  * elements in the SVG itself to raster images to speed up rendering here.
@@ -89,6 +97,9 @@ public:
      * @note If no rect is specified or an empty rect is specified, the raster
      * Image returned will be the same size as the entire SVG.
      *
+     * @note The returned Image has its own copy of the cached rendering, so
+     * drawing into it does not change what other callers get.
+     *
      * @param[in] id Optional id of the SVG element to render.  If no id is
      *               specified, all elements in the SVG will be rendered. \n
      *               Element IDs must follow the syntax of an URL fragment
@@ -117,6 +128,31 @@ public:
         return this->render(id, id_box(id));
     }
 
+    /**
+     * Render an image in the background.
+     *
+     * The image is rendered on another thread and added to the image cache,
+     * so that a later call to render() with the same arguments, and the same
+     * size, returns it without waiting for librsvg.  This is meant to be
+     * called at startup for the images of the first frame.
+     *
+     * If there is no Application, the image is rendered right away.
+     *
+     * @param[in] id Optional id of the SVG element to render.
+     * @param[in] rect Optional rect to clip to.
+     *
+     * @see render()
+     */
+    void prerender(const std::string& id = {}, const RectF& rect = {}) const;
+
+    /**
+     * Forget the parsed SVG files shared by SvgImage instances.
+     *
+     * Rendered images are in the image cache, and
+     * are released by detail::ImageCache::clear().
+     */
+    static void clear_cache();
+
     /**
      * Get the position and size of an element in the SVG.
      *
@@ -254,6 +254,8 @@ public:
 
     void clear() override;
 
+    EGT_NODISCARD size_t len() const override;
+
     using TextWidget::min_size_hint;
 
     EGT_NODISCARD Size min_size_hint() const override;
@@ -542,9 +544,30 @@ protected:
     /// Split the text into atomic tokens that fill the TextRects parameter.
     void tokenize(TextRects& rects);
 
+    /**
+     * Split part of the text into atomic tokens that fill the TextRects
+     * parameter.
+     *
+     * @param[out] rects The tokens.
+     * @param[in] begin Beginning of the part of the text.
+     * @param[in] end End of the part of the text.
+     * @param[in] line_break The part of the text follows a line break.
+     */
+    void tokenize(TextRects& rects,
+                  std::string::const_iterator begin,
+                  std::string::const_iterator end,
+                  bool line_break);
+
     /// Compute the text layout from the tokens contained in the TextRects.
     void compute_layout(TextRects& rects);
 
+    /**
+     * Compute the text layout from the tokens contained in the TextRects,
+     * with the first line at @p top instead of the top of the text
+     * boundaries.
+     */
+    void compute_layout(TextRects& rects, DefaultDim top);
+
     /// Merge adjacent TextRect items, when possible.
     void consolidate(TextRects& rects);
 
@@ -618,6 +641,26 @@ protected:
     /// Tokenize and compute the layout of a text; fill TextRects accordingly.
     void prepare_text(TextRects& rects);
 
+    /**
+     * Lay out again only the paragraphs of m_rects changed by an edit of the
+     * text, and damage what changed.
+     *
+     * The edit replaced the text at @p pos with @p inserted code points, and
+     * m_breaks were already updated.  Paragraphs after the edited ones are
+     * moved if the number of lines changed, but not laid out again.
+     *
+     * @return false if the whole text has to be laid out with prepare_text().
+     */
+    bool relayout_text(size_t pos, size_t inserted);
+
+    /**
+     * Move m_rects along with the text boundaries, when the layout is
+     * otherwise unchanged, as it is when scrolling.
+     *
+     * @return false if the text has to be laid out with prepare_text().
+     */
+    bool move_text();
+
     /// Update m_cursor_rect based on the current position of the cursor.
     void get_cursor_rect();
 
@@ -724,6 +767,51 @@ protected:
     TextRects m_rects;
     Rect m_cursor_rect;
 
+    /// Text boundaries m_rects were laid out in.
+    Rect m_layout_boundaries;
+    /// Reference to the scaled font m_rects were laid out with, empty if out of date.
+    shared_cairo_scaled_font_t m_layout_font;
+    /// Text alignment m_rects were laid out with.
+    AlignFlags m_layout_align;
+    /// Text flags m_rects were laid out with.
+    TextFlags m_layout_flags{};
+
+    /// A "\n" of the text.
+    struct LineBreak
+    {
+        /// Offset of the "\n" in code points.
+        size_t pos;
+        /// Offset of the "\n" in bytes.
+        size_t byte;
+        /// The "\n" TextRect in m_rects, if m_breaks_laid_out.
+        TextRects::iterator rect;
+    };
+
+    /// Length of the text in code points.
+    size_t m_length{0};
+    /// The line breaks of the text, in order.
+    std::vector<LineBreak> m_breaks;
+    /// Whether the rect of every item of m_breaks is in m_rects.
+    bool m_breaks_laid_out{false};
+
+    /// Compute m_length and m_breaks from the whole text.
+    void index_text();
+
+    /// Update m_length and m_breaks after inserting text at @p pos, @p byte.
+    void index_insert(size_t pos, size_t byte, size_t len, size_t bytes);
+
+    /// Update m_length and m_breaks after erasing text at @p pos.
+    void index_erase(size_t pos, size_t len, size_t bytes);
+
+    /// Find the "\n" TextRects of m_breaks in m_rects.
+    void index_break_rects();
+
+    /// Get the first item of m_breaks at or after @p pos.
+    EGT_NODISCARD std::vector<LineBreak>::iterator break_at(size_t pos);
+
+    /// Get the offset in bytes of the code point at @p pos.
+    EGT_NODISCARD size_t byte_offset(size_t pos) const;
+
     /**
      * Given text, return the number of UTF8 characters that will fit on a
      * single line inside of the widget.
@@ -821,6 +909,8 @@ private:
 
 namespace detail
 {
+class TextLayout;
+
 /// Internal draw text function.
 EGT_API void draw_text(Painter& painter,
                        const Rect& b,
@@ -852,6 +942,45 @@ EGT_API void draw_text(Painter& painter,
                        const Pattern& highlight_color = {},
                        size_t select_start = 0,
                        size_t select_len = 0);
+
+/**
+ * Internal draw text function with a layout kept between draws.
+ *
+ * The text is only laid out again if it, or anything its layout depends on,
+ * changed since the last draw with @p layout.
+ */
+EGT_API void draw_text(Painter& painter,
+                       TextLayout& layout,
+                       const Rect& b,
+                       const std::string& text,
+                       const Font& font,
+                       const TextBox::TextFlags& flags,
+                       const AlignFlags& text_align,
+                       Justification justify,
+                       const Pattern& text_color,
+                       const std::function<void(const Point& offset, size_t height)>& draw_cursor = nullptr,
+                       size_t cursor_pos = 0,
+                       const Pattern& highlight_color = {},
+                       size_t select_start = 0,
+                       size_t select_len = 0);
+
+/// Internal draw text function with associated image and a kept layout.
+EGT_API void draw_text(Painter& painter,
+                       TextLayout& layout,
+                       const Rect& b,
+                       const std::string& text,
+                       const Font& font,
+                       const TextBox::TextFlags& flags,
+                       const AlignFlags& text_align,
+                       Justification justify,
+                       const Pattern& text_color,
+                       const AlignFlags& image_align,
+                       const Image& image,
+                       const std::function<void(const Point& offset, size_t height)>& draw_cursor = nullptr,
+                       size_t cursor_pos = 0,
+                       const Pattern& highlight_color = {},
+                       size_t select_start = 0,
+                       size_t select_len = 0);
 }
 
 }
@@ -22,6 +22,10 @@ namespace egt
 {
 inline namespace v1
 {
+namespace detail
+{
+class TextLayout;
+}
 
 /**
  * A widget with text and text related properties.
@@ -112,11 +116,34 @@ public:
 
     void serialize(Serializer& serializer) const override;
 
+    /**
+     * Get the layout of the text, kept between draws.
+     *
+     * This is meant to be passed to detail::draw_text() by draw functions, so
+     * text that did not change is not laid out again on every draw.
+     */
+    EGT_NODISCARD detail::TextLayout& text_layout() const;
+
 protected:
 
     /// Get the size of the text.
     EGT_NODISCARD Size text_size(const std::string& text) const;
 
+    /**
+     * Lay out the text in text_layout() like the default draw functions do,
+     * multiline and word wrapped in the content area.
+     *
+     * This is meant to be called by prepare_draw(), so drawing the text in
+     * parallel only reads the layout.
+     *
+     * @param[in] painter Painter used to measure the text.
+     * @param[in] image_align Alignment of the image relative to the text.
+     * @param[in] image_size Size of the image, or empty if there is none.
+     */
+    void layout_text(Painter& painter,
+                     const AlignFlags& image_align = {},
+                     const Size& image_size = {}) const;
+
     /// Alignment of the text.
     AlignFlags m_text_align{AlignFlag::center};
 
@@ -125,6 +152,9 @@ protected:
 
 private:
 
+    /// Layout of the text, created on the first draw.
+    mutable std::shared_ptr<detail::TextLayout> m_text_layout;
+
     void deserialize(Serializer::Properties& props);
 };
 
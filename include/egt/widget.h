@@ -151,6 +151,37 @@ public:
          * cross the widget boundaries.
          */
         user_track_drag = detail::bit(14),
+
+        /**
+         * The widget only paints with the Painter given to draw() and does not
+         * change any state while drawing, so it can be drawn by another thread
+         * at the same time as other widgets.
+         *
+         * State that draw() reads, and that is only brought up to date when
+         * needed, has to be updated by prepare_draw() instead.
+         */
+        parallel_paint = detail::bit(15),
+
+        /**
+         * Keep a retained rendering of the widget and its children in an
+         * offscreen surface, which is copied to the screen instead of drawing
+         * the widget again until the widget or one of its children is
+         * damaged.
+         */
+        cached = detail::bit(16),
+
+        /**
+         * The widget covers every pixel of its box when drawn, so anything
+         * behind it does not have to be drawn.
+         *
+         * Only set this on a widget that draws its box with the default box
+         * drawing of the Theme.  A widget that draws something else, for
+         * example with its own draw() or a custom Drawer, leaves stale pixels
+         * where it does not paint.
+         *
+         * @see Widget::opaque()
+         */
+        occlude = detail::bit(17),
     };
 
     /// Widget flags
@@ -237,6 +268,32 @@ public:
      */
     virtual void draw(Painter& painter, const Rect& rect);
 
+    /**
+     * Bring state that draw() reads up to date, before the widget is drawn.
+     *
+     * This is called on the UI thread before a window is drawn by multiple
+     * threads, so that draw() only reads that state.  The default calls
+     * prepare_draw() on every visible subordinate.
+     *
+     * @param[in] painter Instance of the Painter for the Screen.
+     *
+     * @see Widget::Flag::parallel_paint
+     */
+    virtual void prepare_draw(Painter& painter);
+
+    /**
+     * Returns true if drawing the widget covers every pixel of its box().
+     *
+     * This is used to skip drawing anything that is hidden behind the widget.
+     * By default, a widget is opaque only when Widget::Flag::occlude is set,
+     * it is visible, has no alpha, and draw_box() fills the whole box: no
+     * margin, no rounded corners, and a solid fill or an opaque background
+     * color.
+     *
+     * @see Widget::Flag::occlude
+     */
+    EGT_NODISCARD virtual bool opaque() const;
+
     /**
      * Handle an event.
      *
@@ -577,6 +634,58 @@ public:
         }
     }
 
+    EGT_NODISCARD bool parallel_paint() const
+    {
+        return flags().is_set(Widget::Flag::parallel_paint);
+    }
+
+    void parallel_paint(bool value)
+    {
+        if (flags().is_set(Widget::Flag::parallel_paint) != value)
+        {
+            if (value)
+                flags().set(Widget::Flag::parallel_paint);
+            else
+                flags().clear(Widget::Flag::parallel_paint);
+        }
+    }
+
+    EGT_NODISCARD bool occlude() const
+    {
+        return flags().is_set(Widget::Flag::occlude);
+    }
+
+    void occlude(bool value)
+    {
+        if (flags().is_set(Widget::Flag::occlude) != value)
+        {
+            if (value)
+                flags().set(Widget::Flag::occlude);
+            else
+                flags().clear(Widget::Flag::occlude);
+        }
+    }
+
+    EGT_NODISCARD bool cached() const
+    {
+        return flags().is_set(Widget::Flag::cached);
+    }
+
+    /**
+     * Enable or disable the retained rendering of the widget.
+     *
+     * @see Widget::Flag::cached
+     */
+    void cached(bool value);
+
+    /**
+     * Returns true if this widget and all of its visible subordinates can be
+     * drawn in parallel.
+     *
+     * @see Widget::Flag::parallel_paint
+     */
+    EGT_NODISCARD bool parallel_paint_tree() const;
+
     /**
      * Returns true if the widget is capable of handling an event.
      */
@@ -1631,6 +1740,15 @@ protected:
      */
     void add_damage(const Rect& rect);
 
+    /**
+     * Pass damage on to the parent, or to the damage array of the widget with
+     * the screen, without invalidating any retained rendering of this widget.
+     *
+     * This is used for changes that only affect how the widget is blended,
+     * like its alpha.
+     */
+    void propagate_damage(const Rect& rect);
+
     /**
      * Helper type that defines the special draw child callback.
      */
@@ -1834,6 +1952,26 @@ protected:
     /// @private
     void draw_subordinate(Painter& painter, const Rect& crect, Widget* child);
 
+    /**
+     * Find the part of the damage each subordinate has to draw.
+     *
+     * Subordinates are walked front to back, and the box of every opaque()
+     * subordinate is removed from the damage left for the subordinates and
+     * box behind it.
+     *
+     * @param[in] crect Damage in subordinate coordinates.
+     * @param[out] visible Damage to draw for each subordinate.  Only the
+     *             first entries, one per subordinate, are used.
+     * @param[out] covered Part of @p crect covered by opaque subordinates.
+     * @param[out] remaining Part of @p crect not covered.
+     * @return false if no subordinate is opaque, or culling is not possible.
+     */
+    bool occlusion_cull(const Rect& crect, std::vector<Region>& visible,
+                        Region& covered, Region& remaining) const;
+
+    /// Draw the box of the widget, except for the @p covered region.
+    void draw_own_box(Painter& painter, const Rect& rect, const Region* covered);
+
     /// Used internally for calling the special child draw function.
     ChildDrawCallback m_special_child_draw_callback;
 
@@ -1918,8 +2056,8 @@ protected:
      */
     SubordinatesArray::iterator m_components_begin;
 
-    /// The damage array for this widget.
-    Screen::DamageArray m_damage;
+    /// The damaged region of this widget.
+    Region m_damage;
 
     /// Status for whether this widget is currently drawing.
     bool m_in_draw{false};
@@ -2035,7 +2173,7 @@ private:
 
 /// Enum string conversion map
 template<>
-EGT_API const std::pair<Widget::Flag, char const*> detail::EnumStrings<Widget::Flag>::data[15];
+EGT_API const std::pair<Widget::Flag, char const*> detail::EnumStrings<Widget::Flag>::data[18];
 
 /// Overloaded std::ostream insertion operator
 EGT_API std::ostream& operator<<(std::ostream& os, const Widget::Flag& flag);
@@ -28,6 +28,7 @@ namespace detail
 {
 class WindowImpl;
 class PlaneWindow;
+class RenderPool;
 }
 
 /**
@@ -221,6 +222,15 @@ protected:
      */
     virtual void do_draw();
 
+    /**
+     * Draw the damage on multiple threads.
+     *
+     * Each thread draws a different part of the damage with its own context,
+     * after prepare_draw() is called on this thread.  This is only used when
+     * EGT_PARALLEL_RENDER is set and parallel_paint_tree() is true.
+     */
+    void parallel_draw(detail::RenderPool& pool, const Region& damage);
+
     /// @private
     virtual void allocate_screen();
 
@@ -297,6 +307,9 @@ protected:
     /// @private
     WindowHint m_hint;
 
+    /// Rectangles of the damage drawn by each thread of parallel_draw().
+    Region::RectArray m_parallel_tasks;
+
     friend class detail::WindowImpl;
     friend class detail::PlaneWindow;
 };
@@ -7,6 +7,8 @@
 #include "egt/animation.h"
 #include "egt/app.h"
 #include "egt/detail/math.h"
+#include "egt/eventloop.h"
+#include "egt/frameclock.h"
 #include "egt/widget.h"
 #include <cassert>
 #include <cmath>
@@ -124,24 +126,71 @@ AutoAnimation::AutoAnimation(std::chrono::milliseconds duration,
 void AutoAnimation::start()
 {
     Animation::start();
-    m_timer.start();
+    schedule();
 }
 
 void AutoAnimation::stop()
 {
     m_timer.cancel();
+    remove_frame_handler();
     Animation::stop();
 }
 
 void AutoAnimation::resume()
 {
     Animation::resume();
-    m_timer.start();
+    if (running())
+        schedule();
 }
 
 void AutoAnimation::interval(std::chrono::milliseconds duration)
 {
     m_timer.change_duration(duration);
+
+    if (!m_use_timer)
+    {
+        m_use_timer = true;
+        if (m_frame_handle)
+        {
+            remove_frame_handler();
+            m_timer.start();
+        }
+    }
+}
+
+void AutoAnimation::schedule()
+{
+    if (m_use_timer)
+    {
+        m_timer.start();
+        return;
+    }
+
+    auto& clock = Application::instance().event().frame_clock();
+    if (!m_frame_handle)
+    {
+        m_frame_handle = clock.on_frame([this, &clock](FrameClock::clock::time_point)
+        {
+            if (!next())
+                stop();
+            else
+                clock.request_frame();
+        });
+    }
+
+    clock.request_frame();
+}
+
+void AutoAnimation::remove_frame_handler()
+{
+    if (m_frame_handle && Application::check_instance())
+        Application::instance().event().frame_clock().remove_handler(m_frame_handle);
+    m_frame_handle = 0;
+}
+
+AutoAnimation::~AutoAnimation() noexcept
+{
+    remove_frame_handler();
 }
 
 }
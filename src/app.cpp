@@ -10,6 +10,7 @@
 #include "detail/egtlog.h"
 #include "egt/app.h"
 #include "egt/detail/filesystem.h"
+#include "egt/detail/imagecache.h"
 #include "egt/detail/screen/composerscreen.h"
 #include "egt/detail/screen/kmsscreen.h"
 #include "egt/detail/screen/memoryscreen.h"
@@ -255,6 +256,8 @@ void Application::setup_backend(bool primary, const std::string& name)
             if (backend.empty() || b.first == backend)
             {
                 m_screen = b.second();
+                // keep opaque images in the format of the screen
+                detail::image_cache().native_format(detail::cairo_format(m_screen->format()));
                 return;
             }
         }
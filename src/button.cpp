@@ -149,11 +149,18 @@ void Button::draw(Painter& painter, const Rect& rect)
     Drawer<Button>::draw(*this, painter, rect);
 }
 
+void Button::prepare_draw(Painter& painter)
+{
+    layout_text(painter);
+    TextWidget::prepare_draw(painter);
+}
+
 void Button::default_draw(const Button& widget, Painter& painter, const Rect& /*rect*/)
 {
     widget.draw_box(painter, Palette::ColorId::button_bg, Palette::ColorId::border);
 
     detail::draw_text(painter,
+                      widget.text_layout(),
                       widget.content_area(),
                       widget.text(),
                       widget.font(),
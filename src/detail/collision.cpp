@@ -13,13 +13,27 @@ inline namespace v1
 namespace detail
 {
 
+/*
+ * Images without alpha, like opaque images converted to the format of the
+ * screen by the image cache, collide with every pixel.
+ */
+static inline bool opaque(cairo_surface_t* image)
+{
+    return cairo_surface_get_content(image) == CAIRO_CONTENT_COLOR;
+}
+
 bool alpha_collision(const Rect& lhs, cairo_surface_t* limage,
                      const Rect& rhs, cairo_surface_t* rimage)
 {
     if (lhs.intersect(rhs))
     {
-        assert(cairo_image_surface_get_format(limage) == CAIRO_FORMAT_ARGB32);
-        assert(cairo_image_surface_get_format(rimage) == CAIRO_FORMAT_ARGB32);
+        const auto lopaque = opaque(limage);
+        const auto ropaque = opaque(rimage);
+        if (lopaque && ropaque)
+            return true;
+
+        assert(lopaque || cairo_image_surface_get_format(limage) == CAIRO_FORMAT_ARGB32);
+        assert(ropaque || cairo_image_surface_get_format(rimage) == CAIRO_FORMAT_ARGB32);
 
         const auto ldata = reinterpret_cast<unsigned int*>(cairo_image_surface_get_data(limage));
         const auto rdata = reinterpret_cast<unsigned int*>(cairo_image_surface_get_data(rimage));
@@ -31,10 +45,12 @@ bool alpha_collision(const Rect& lhs, cairo_surface_t* limage,
         {
             for (auto x = i.left(); x < i.right(); x++)
             {
-                const auto l = ldata[static_cast<uint32_t>((x - lhs.left()) + (y - lhs.top()) * lpitch)];
-                const auto r = rdata[static_cast<uint32_t>((x - rhs.left()) + (y - rhs.top()) * rpitch)];
+                const auto l = lopaque ||
+                               ((ldata[static_cast<uint32_t>((x - lhs.left()) + (y - lhs.top()) * lpitch)] >> 24u) & 0xffu);
+                const auto r = ropaque ||
+                               ((rdata[static_cast<uint32_t>((x - rhs.left()) + (y - rhs.top()) * rpitch)] >> 24u) & 0xffu);
 
-                if (((l >> 24u) & 0xff) && ((r >> 24u) & 0xffu))
+                if (l && r)
                 {
                     return true;
                 }
@@ -50,6 +66,9 @@ bool alpha_collision(const Rect& lhs, cairo_surface_t* limage,
 {
     if (lhs.intersect(rhs))
     {
+        if (opaque(limage))
+            return true;
+
         assert(cairo_image_surface_get_format(limage) == CAIRO_FORMAT_ARGB32);
 
         const auto ldata = reinterpret_cast<unsigned int*>(cairo_image_surface_get_data(limage));
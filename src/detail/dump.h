@@ -11,9 +11,16 @@
  * @brief Debug dump tools.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "detail/fmt.h"
+#include "egt/detail/meta.h"
 #include <chrono>
+#include <cstdlib>
 #include <iomanip>
+#include <utility>
 #include <vector>
 
 namespace egt
@@ -44,6 +51,45 @@ inline void code_timer(bool enable, const Prefix& prefix, T&& callback)
     }
 }
 
+#ifdef ENABLE_DRAW_TIMING
+/**
+ * Returns true if the EGT_TIME_DRAW environment variable asks for drawing to
+ * be timed.
+ */
+inline bool draw_timing_enabled()
+{
+    static const bool enabled = std::getenv("EGT_TIME_DRAW") != nullptr;
+    return enabled;
+}
+#else
+constexpr bool draw_timing_enabled()
+{
+    return false;
+}
+#endif
+
+/**
+ * Variant of code_timer() for the draw path.
+ *
+ * The prefix is only built, by calling @p prefix, when drawing is timed.  When
+ * EGT is built without draw timing this is just a call to @p callback.
+ */
+template<class PrefixFunc, class T>
+inline void draw_timer(PrefixFunc&& prefix, T&& callback)
+{
+#ifdef ENABLE_DRAW_TIMING
+    if (egt_unlikely(draw_timing_enabled()))
+    {
+        code_timer(true, prefix(), std::forward<T>(callback));
+        return;
+    }
+#else
+    detail::ignoreparam(prefix);
+#endif
+
+    callback();
+}
+
 /**
  * Utility to print a somewhat standard hex display.
  */
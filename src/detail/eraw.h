@@ -20,7 +20,10 @@ namespace detail
 /**
  * Load an ERAW file into a surface.
  *
- * @param[in] filename The path of the SVG file.
+ * An uncompressed version 2 file is memory mapped and used in place by the
+ * surface without being decoded.
+ *
+ * @param[in] filename The path of the ERAW file.
  */
 shared_cairo_surface_t load_eraw(const std::string& filename);
 
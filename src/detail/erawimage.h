@@ -6,12 +6,28 @@
 #ifndef EGT_SRC_DETAIL_ERAWIMAGE_H
 #define EGT_SRC_DETAIL_ERAWIMAGE_H
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
 #include <cairo.h>
 #include <cstring>
 #include <egt/geometry.h>
 #include <egt/types.h>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_SIMD
+#include "Simd/SimdLib.hpp"
+#endif
 
 extern "C" {
     extern void* arm_memset32(uint32_t*, uint32_t, size_t);
@@ -44,7 +60,26 @@ class ErawImage
 {
 private:
 
-#ifdef __arm__
+    /// Runs shorter than this are not worth a call to a vectorized fill.
+    static constexpr size_t SHORT_RUN = 16;
+
+#if defined(HAVE_SIMD) && (!defined(__arm__) || defined(__ARM_NEON))
+    static void memset32(uint32_t* data, uint32_t value, size_t count)
+    {
+        if (count < SHORT_RUN)
+        {
+            while (count--)
+                *data++ = value;
+            return;
+        }
+
+        // little endian ARGB32 is BGRA in memory
+        SimdFillBgra(reinterpret_cast<uint8_t*>(data), count * sizeof(uint32_t),
+                     count, 1,
+                     value & 0xff, (value >> 8) & 0xff,
+                     (value >> 16) & 0xff, (value >> 24) & 0xff);
+    }
+#elif defined(__arm__)
     static inline void memset32(uint32_t* data, uint32_t value, size_t count)
     {
         arm_memset32(data, value, count);
@@ -64,11 +99,24 @@ private:
         {
             memset(data, u.c[0], count * sizeof(uint32_t));
         }
-        else
+        else if (count < SHORT_RUN)
         {
             while (count--)
                 *data++ = value;
         }
+        else
+        {
+            // keep doubling what is already written so that the bulk of the
+            // run goes through the vectorized memcpy() of the C library
+            *data = value;
+            size_t done = 1;
+            while (done < count)
+            {
+                const auto n = std::min(done, count - done);
+                memcpy(data + done, data, n * sizeof(uint32_t));
+                done += n;
+            }
+        }
     }
 #endif
 
@@ -82,63 +130,356 @@ private:
         return data + sizeof(T);
     }
 
-public:
+    static void fill(uint32_t* data, uint32_t value, size_t count)
+    {
+        memset32(data, value, count);
+    }
 
-    static constexpr uint32_t egt_magic()
+    static void fill(uint16_t* data, uint16_t value, size_t count)
     {
-        return 0x50502AA2;
+        if (count < SHORT_RUN)
+        {
+            std::fill_n(data, count, value);
+            return;
+        }
+
+        // fill two pixels at a time
+        if (reinterpret_cast<uintptr_t>(data) & 2)
+        {
+            *data++ = value;
+            --count;
+        }
+        memset32(reinterpret_cast<uint32_t*>(data),
+                 value | (static_cast<uint32_t>(value) << 16), count / 2);
+        if (count & 1)
+            data[count - 1] = value;
     }
 
-    static shared_cairo_surface_t load(const std::string& filename)
+    static void fill(uint8_t* data, uint8_t value, size_t count)
     {
-        std::ifstream i(filename, std::ios_base::binary);
-        if (!i)
+        memset(data, value, count);
+    }
+
+    /// A whole file mapped copy-on-write into memory.
+    struct Mapping
+    {
+        void* addr{nullptr};
+        size_t len{0};
+
+        Mapping() = default;
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        ~Mapping()
+        {
+#ifndef WIN32
+            if (addr)
+                munmap(addr, len);
+#else
+            delete [] static_cast<unsigned char*>(addr);
+#endif
+        }
+
+        const unsigned char* data() const
+        {
+            return static_cast<const unsigned char*>(addr);
+        }
+    };
+
+    static std::unique_ptr<Mapping> map(const std::string& filename)
+    {
+        auto mapping = std::make_unique<Mapping>();
+#ifndef WIN32
+        const auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
             return nullptr;
-        alignas(4) uint32_t magic = 0;
-        alignas(4) uint32_t width = 0;
-        alignas(4) uint32_t height = 0;
-        alignas(4) uint32_t reserved = 0;
-        i.read(reinterpret_cast<char*>(&magic), sizeof(magic));
-        if (magic != egt_magic())
+        struct stat st {};
+        if (fstat(fd, &st) < 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+        // private and writable so that drawing on the surface only copies the
+        // touched pages instead of faulting or writing back to the file
+        auto addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return nullptr;
+        mapping->addr = addr;
+        mapping->len = st.st_size;
+#else
+        std::ifstream i(filename, std::ios_base::binary | std::ios_base::ate);
+        if (!i)
             return nullptr;
-        if (!i.read(reinterpret_cast<char*>(&width), sizeof(width)) ||
-            !i.read(reinterpret_cast<char*>(&height), sizeof(height)) ||
-            !i.read(reinterpret_cast<char*>(&reserved), sizeof(reserved)) ||
-            !i.read(reinterpret_cast<char*>(&reserved), sizeof(reserved)) ||
-            !i.read(reinterpret_cast<char*>(&reserved), sizeof(reserved)) ||
-            !i.read(reinterpret_cast<char*>(&reserved), sizeof(reserved)))
+        const auto len = static_cast<size_t>(i.tellg());
+        auto addr = new unsigned char[len];
+        mapping->addr = addr;
+        mapping->len = len;
+        i.seekg(0);
+        if (!i.read(reinterpret_cast<char*>(addr), len))
             return nullptr;
+#endif
+        return mapping;
+    }
 
-        auto surface =
-            shared_cairo_surface_t(cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                   width, height),
-                                   cairo_surface_destroy);
-        auto data =
-            reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(surface.get()));
-        auto end = data + (width * height);
+    static cairo_user_data_key_t* mapping_key()
+    {
+        static cairo_user_data_key_t key;
+        return &key;
+    }
 
+    template <class T>
+    static const unsigned char* read_blocks(const unsigned char* buf, const unsigned char* buf_end,
+                                            T* data, const T* end)
+    {
         while (data < end)
         {
             alignas(4) uint16_t block = 0;
-            if (!i.read(reinterpret_cast<char*>(&block), sizeof(block)))
+            buf = readw(buf, block, buf_end);
+            if (!buf)
                 return nullptr;
             if (block & 0x8000)
             {
                 block &= 0x7fff;
-                alignas(4) uint32_t value = 0;
-                if (!i.read(reinterpret_cast<char*>(&value), sizeof(value)))
+                if (!block || block > end - data)
                     return nullptr;
-                memset32(data, value, block);
+                alignas(4) T value = 0;
+                buf = readw(buf, value, buf_end);
+                if (!buf)
+                    return nullptr;
+                fill(data, value, block);
             }
-            else if (block)
+            else
             {
-                if (!i.read(reinterpret_cast<char*>(data), block * sizeof(uint32_t)))
+                if (!block || block > end - data)
                     return nullptr;
+                if (buf + block * sizeof(T) > buf_end)
+                    return nullptr;
+
+                memcpy(data, buf, block * sizeof(T));
+                buf += (block * sizeof(T));
             }
             data += block;
         }
 
-        i.close();
+        return buf;
+    }
+
+    template <class T>
+    static uint32_t write_blocks(std::ostream& o, const T* offset, const T* end)
+    {
+        uint32_t length = 0;
+        while (offset < end)
+        {
+            T value = 0;
+            auto same = next_same_block(offset, end, value);
+            if (same)
+            {
+                offset += same;
+                same |= 0x8000;
+                o.write(reinterpret_cast<const char*>(&same), sizeof(same));
+                length += sizeof(same);
+                o.write(reinterpret_cast<const char*>(&value), sizeof(value));
+                length += sizeof(value);
+            }
+            else
+            {
+                auto diff = next_diff_block(offset, end);
+                if (diff)
+                {
+                    o.write(reinterpret_cast<const char*>(&diff), sizeof(diff));
+                    length += sizeof(diff);
+                    o.write(reinterpret_cast<const char*>(offset), diff * sizeof(T));
+                    length += diff * sizeof(T);
+                    offset += diff;
+                }
+            }
+        }
+        return length;
+    }
+
+public:
+
+    /// Pixel format of a version 2 image.
+    enum class Format : uint32_t
+    {
+        /// 32 bit pre-multiplied ARGB, CAIRO_FORMAT_ARGB32.
+        argb32 = 0,
+        /// 16 bit opaque RGB, CAIRO_FORMAT_RGB16_565.
+        rgb565 = 1,
+        /// 8 bit alpha only, CAIRO_FORMAT_A8.
+        a8 = 2,
+    };
+
+    /// Pixel data encoding of a version 2 image.
+    enum class Compression : uint32_t
+    {
+        /// Raw rows, ready to be used in place.
+        none = 0,
+        /// Run length encoded blocks of pixels.
+        rle = 1,
+    };
+
+    /// Header of a version 2 image, all fields are 32 bit little endian.
+    struct HeaderV2
+    {
+        uint32_t magic{0};
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t format{0};
+        /// Bytes between the start of two rows.
+        uint32_t stride{0};
+        uint32_t compression{0};
+        /// Offset of the pixel data from the start of the file.
+        uint32_t offset{0};
+        /// Size of the pixel data.
+        uint32_t size{0};
+    };
+
+    static_assert(sizeof(HeaderV2) == 32, "unexpected eraw v2 header size");
+
+    static constexpr uint32_t egt_magic()
+    {
+        return 0x50502AA2;
+    }
+
+    static constexpr uint32_t egt_magic_v2()
+    {
+        return 0x50502AA3;
+    }
+
+    /// Default alignment of the pixel data of a version 2 image.
+    static constexpr uint32_t default_alignment()
+    {
+        return 64;
+    }
+
+    static cairo_format_t cairo_format(Format format)
+    {
+        switch (format)
+        {
+        case Format::rgb565:
+            return CAIRO_FORMAT_RGB16_565;
+        case Format::a8:
+            return CAIRO_FORMAT_A8;
+        case Format::argb32:
+            break;
+        }
+        return CAIRO_FORMAT_ARGB32;
+    }
+
+    static size_t bytes_per_pixel(Format format)
+    {
+        switch (format)
+        {
+        case Format::rgb565:
+            return 2;
+        case Format::a8:
+            return 1;
+        case Format::argb32:
+            break;
+        }
+        return 4;
+    }
+
+    /**
+     * Read and validate the header of a version 2 image.
+     *
+     * Returns false if the header is malformed or does not fit in @p len.
+     */
+    static bool read_header(const unsigned char* buf, size_t len, HeaderV2& header)
+    {
+        if (len < sizeof(header))
+            return false;
+        memcpy(&header, buf, sizeof(header));
+
+        if (header.magic != egt_magic_v2())
+            return false;
+        if (header.format > static_cast<uint32_t>(Format::a8) ||
+            header.compression > static_cast<uint32_t>(Compression::rle))
+            return false;
+        if (!header.width || !header.height ||
+            header.width > 0x7fff || header.height > 0x7fff)
+            return false;
+
+        const auto format = static_cast<Format>(header.format);
+        const auto min_stride =
+            cairo_format_stride_for_width(cairo_format(format), header.width);
+        if (header.stride < static_cast<uint32_t>(min_stride) || header.stride % 4)
+            return false;
+        if (header.offset < sizeof(header) ||
+            header.offset > len ||
+            header.size > len - header.offset)
+            return false;
+        if (header.compression == static_cast<uint32_t>(Compression::none) &&
+            header.size < static_cast<size_t>(header.stride) * header.height)
+            return false;
+
+        return true;
+    }
+
+    /**
+     * Decode the pixel data of a version 2 image into a new surface.
+     */
+    static shared_cairo_surface_t read_surface_data(const unsigned char* buf, const HeaderV2& header)
+    {
+        const auto format = static_cast<Format>(header.format);
+        auto surface =
+            shared_cairo_surface_t(cairo_image_surface_create(cairo_format(format),
+                                   header.width, header.height),
+                                   cairo_surface_destroy);
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+            return nullptr;
+
+        auto data = cairo_image_surface_get_data(surface.get());
+        const auto stride = static_cast<uint32_t>(cairo_image_surface_get_stride(surface.get()));
+        const auto src = buf + header.offset;
+
+        if (header.compression == static_cast<uint32_t>(Compression::none))
+        {
+            if (stride == header.stride)
+            {
+                memcpy(data, src, static_cast<size_t>(stride) * header.height);
+            }
+            else
+            {
+                const auto row = std::min(stride, header.stride);
+                for (uint32_t y = 0; y < header.height; ++y)
+                    memcpy(data + y * stride, src + y * header.stride, row);
+            }
+        }
+        else
+        {
+            // runs are encoded over whole rows, so the strides have to agree
+            if (stride != header.stride)
+                return nullptr;
+
+            const auto src_end = src + header.size;
+            const auto bytes = static_cast<size_t>(stride) * header.height;
+            const unsigned char* result = nullptr;
+            switch (format)
+            {
+            case Format::argb32:
+            {
+                auto p = reinterpret_cast<uint32_t*>(data);
+                result = read_blocks(src, src_end, p, p + bytes / sizeof(uint32_t));
+                break;
+            }
+            case Format::rgb565:
+            {
+                auto p = reinterpret_cast<uint16_t*>(data);
+                result = read_blocks(src, src_end, p, p + bytes / sizeof(uint16_t));
+                break;
+            }
+            case Format::a8:
+                result = read_blocks(src, src_end, data, data + bytes);
+                break;
+            }
+
+            if (!result)
+                return nullptr;
+        }
 
         // must mark surface dirty once we manually fill it in
         cairo_surface_mark_dirty(surface.get());
@@ -146,41 +487,65 @@ public:
         return surface;
     }
 
+    /**
+     * Load an image from a file.
+     *
+     * The file is mapped into memory.  An uncompressed version 2 image is used
+     * in place by the returned surface, which keeps the mapping alive, so no
+     * decode or copy of the pixel data happens.  Anything else is decoded from
+     * the mapping, which is released before returning.
+     */
+    static shared_cairo_surface_t load(const std::string& filename)
+    {
+        auto mapping = map(filename);
+        if (!mapping)
+            return nullptr;
+
+        HeaderV2 header;
+        if (!read_header(mapping->data(), mapping->len, header) ||
+            header.compression != static_cast<uint32_t>(Compression::none))
+            return load(mapping->data(), mapping->len);
+
+#ifndef WIN32
+        auto data = static_cast<unsigned char*>(mapping->addr) + header.offset;
+        // cairo and pixman want at least 32 bit aligned rows
+        if (reinterpret_cast<uintptr_t>(data) % 4)
+            return read_surface_data(mapping->data(), header);
+
+        auto surface =
+            shared_cairo_surface_t(cairo_image_surface_create_for_data(data,
+                                   cairo_format(static_cast<Format>(header.format)),
+                                   header.width, header.height, header.stride),
+                                   cairo_surface_destroy);
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+            return nullptr;
+
+        if (cairo_surface_set_user_data(surface.get(), mapping_key(), mapping.get(),
+                                        [](void* m) { delete static_cast<Mapping*>(m); })
+            != CAIRO_STATUS_SUCCESS)
+            return read_surface_data(mapping->data(), header);
+
+        mapping.release();
+        return surface;
+#else
+        return read_surface_data(mapping->data(), header);
+#endif
+    }
+
     static shared_cairo_surface_t read_surface_data(const unsigned char* buf, const unsigned char* buf_end, uint32_t width, uint32_t height)
     {
         auto surface =
             shared_cairo_surface_t(cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
                                    width, height),
                                    cairo_surface_destroy);
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+            return nullptr;
         auto data =
             reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(surface.get()));
         auto end = data + (width * height);
 
-        while (data < end)
-        {
-            alignas(4) uint16_t block = 0;
-            buf = readw(buf, block, buf_end);
-            if (!buf)
-                return nullptr;
-            if (block & 0x8000)
-            {
-                block &= 0x7fff;
-                alignas(4) uint32_t value = 0;
-                buf = readw(buf, value, buf_end);
-                if (!buf)
-                    return nullptr;
-                memset32(data, value, block);
-            }
-            else if (block)
-            {
-                if (buf + block * sizeof(uint32_t) > buf_end)
-                    return nullptr;
-
-                memcpy(data, buf, block * sizeof(uint32_t));
-                buf += (block * sizeof(uint32_t));
-            }
-            data += block;
-        }
+        if (!read_blocks(buf, buf_end, data, end))
+            return nullptr;
 
         // must mark surface dirty once we manually fill it in
         cairo_surface_mark_dirty(surface.get());
@@ -188,8 +553,15 @@ public:
         return surface;
     }
 
+    /**
+     * Decode an image, version 1 or 2, from memory.
+     */
     static shared_cairo_surface_t load(const unsigned char* buf, size_t len)
     {
+        HeaderV2 header;
+        if (read_header(buf, len, header))
+            return read_surface_data(buf, header);
+
         const auto buf_end = buf + len;
         alignas(4) uint32_t magic = 0;
         alignas(4) uint32_t width = 0;
@@ -247,7 +619,8 @@ public:
         return read_surface_data(buf, buf_end, width, height);
     }
 
-    static uint16_t next_diff_block(uint32_t* data, const uint32_t* end)
+    template <class T>
+    static uint16_t next_diff_block(const T* data, const T* end)
     {
         if (end - data > 0x7fff)
             end = data + 0x7fff;
@@ -263,7 +636,8 @@ public:
         return ptr - data;
     }
 
-    static uint16_t next_same_block(uint32_t* data, const uint32_t* end, uint32_t& value)
+    template <class T>
+    static uint16_t next_same_block(const T* data, const T* end, T& value)
     {
         if (end - data > 0x7fff)
             end = data + 0x7fff;
@@ -291,31 +665,7 @@ public:
         o.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
 
         const auto start = reinterpret_cast<uint32_t*>(data);
-        auto offset = reinterpret_cast<uint32_t*>(data);
-        const auto end = reinterpret_cast<uint32_t*>(start + (width * height));
-
-        while (offset < end)
-        {
-            uint32_t value = 0;
-            auto same = next_same_block(offset, end, value);
-            if (same)
-            {
-                offset += same;
-                same |= 0x8000;
-                o.write(reinterpret_cast<const char*>(&same), sizeof(same));
-                o.write(reinterpret_cast<const char*>(&value), sizeof(value));
-            }
-            else
-            {
-                auto diff = next_diff_block(offset, end);
-                if (diff)
-                {
-                    o.write(reinterpret_cast<const char*>(&diff), sizeof(diff));
-                    o.write(reinterpret_cast<const char*>(offset), diff * sizeof(uint32_t));
-                    offset += diff;
-                }
-            }
-        }
+        write_blocks(o, start, start + (width * height));
         o.close();
     }
 
@@ -343,38 +693,84 @@ public:
         length += (2 * sizeof(reserved));
 
         const auto start = reinterpret_cast<uint32_t*>(data);
-        auto offset = reinterpret_cast<uint32_t*>(data);
-        const auto end = reinterpret_cast<uint32_t*>(start + (width * height));
+        length += write_blocks(o, start, start + (width * height));
+        o.close();
 
-        while (offset < end)
+        *len = length;
+    }
+
+    /**
+     * Save a version 2 image.
+     *
+     * @param[in] path Path of the file to write.
+     * @param[in] data Pixel data, in the layout of a cairo image surface.
+     * @param[in] format Pixel format of @p data.
+     * @param[in] width Width in pixels.
+     * @param[in] height Height in pixels.
+     * @param[in] stride Bytes between the start of two rows of @p data.
+     * @param[in] compression Encoding of the pixel data in the file.
+     * @param[in] alignment Alignment, a power of two of at least 4, of the
+     *            pixel data in the file.
+     */
+    static bool save_v2(const std::string& path, const unsigned char* data,
+                        Format format, uint32_t width, uint32_t height,
+                        uint32_t stride, Compression compression = Compression::none,
+                        uint32_t alignment = default_alignment())
+    {
+        if (alignment < 4 || (alignment & (alignment - 1)))
+            return false;
+
+        std::ofstream o(path, std::ios_base::binary);
+        if (!o)
+            return false;
+
+        HeaderV2 header;
+        header.magic = egt_magic_v2();
+        header.width = width;
+        header.height = height;
+        header.format = static_cast<uint32_t>(format);
+        header.stride = stride;
+        header.compression = static_cast<uint32_t>(compression);
+        header.offset = (sizeof(header) + alignment - 1) & ~(alignment - 1);
+
+        const std::vector<char> padding(header.offset - sizeof(header), 0);
+        o.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        o.write(padding.data(), padding.size());
+
+        const auto bytes = static_cast<size_t>(stride) * height;
+        if (compression == Compression::none)
         {
-            uint32_t value = 0;
-            auto same = next_same_block(offset, end, value);
-            if (same)
+            o.write(reinterpret_cast<const char*>(data), bytes);
+            header.size = bytes;
+        }
+        else
+        {
+            switch (format)
             {
-                offset += same;
-                same |= 0x8000;
-                o.write(reinterpret_cast<const char*>(&same), sizeof(same));
-                length += sizeof(same);
-                o.write(reinterpret_cast<const char*>(&value), sizeof(value));
-                length += sizeof(value);
+            case Format::argb32:
+            {
+                auto p = reinterpret_cast<const uint32_t*>(data);
+                header.size = write_blocks(o, p, p + bytes / sizeof(uint32_t));
+                break;
             }
-            else
+            case Format::rgb565:
             {
-                auto diff = next_diff_block(offset, end);
-                if (diff)
-                {
-                    o.write(reinterpret_cast<const char*>(&diff), sizeof(diff));
-                    length += sizeof(diff);
-                    o.write(reinterpret_cast<const char*>(offset), diff * sizeof(uint32_t));
-                    length += diff * sizeof(uint32_t);
-                    offset += diff;
-                }
+                auto p = reinterpret_cast<const uint16_t*>(data);
+                header.size = write_blocks(o, p, p + bytes / sizeof(uint16_t));
+                break;
+            }
+            case Format::a8:
+                header.size = write_blocks(o, data, data + bytes);
+                break;
             }
         }
+
+        // now that the size of the pixel data is known
+        o.seekp(0);
+        o.write(reinterpret_cast<const char*>(&header), sizeof(header));
         o.close();
 
-        *len = length;
+        return !o.fail();
     }
 
 };
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "detail/utf8text.h"
+#include "egt/detail/glyphcache.h"
+#include <algorithm>
+#include <limits>
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+static const cairo_user_data_key_t glyph_cache_key{};
+
+static void destroy_glyph_cache(void* data)
+{
+    delete static_cast<GlyphCache*>(data);
+}
+
+GlyphCache::GlyphCache(cairo_scaled_font_t* font) noexcept
+    : m_font(font)
+{}
+
+GlyphCache& GlyphCache::get(cairo_scaled_font_t* font)
+{
+    // cairo does not guard user data, and fonts are shared between threads
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto cache = static_cast<GlyphCache*>(cairo_scaled_font_get_user_data(font, &glyph_cache_key));
+    if (cache)
+        return *cache;
+
+    cache = new GlyphCache(font);
+    if (cairo_scaled_font_set_user_data(font, &glyph_cache_key, cache,
+                                        destroy_glyph_cache) != CAIRO_STATUS_SUCCESS)
+    {
+        delete cache;
+
+        // a font in an error state measures nothing, neither does this
+        static GlyphCache nil(nullptr);
+        return nil;
+    }
+
+    return *cache;
+}
+
+void GlyphCache::measure(uint32_t code_point, cairo_text_extents_t& te) const
+{
+    te = {};
+    if (!m_font)
+        return;
+
+    char text[8] = {};
+    utf8::unchecked::append(code_point, text);
+    cairo_scaled_font_text_extents(m_font, text, &te);
+}
+
+const cairo_text_extents_t& GlyphCache::extents(uint32_t code_point)
+{
+    if (code_point < DENSE_SIZE)
+    {
+        if (m_dense_valid[code_point].load(std::memory_order_acquire))
+            return m_dense[code_point];
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dense_valid[code_point].load(std::memory_order_relaxed))
+        {
+            measure(code_point, m_dense[code_point]);
+            m_dense_valid[code_point].store(true, std::memory_order_release);
+        }
+
+        return m_dense[code_point];
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto i = m_sparse.find(code_point);
+    if (i == m_sparse.end())
+    {
+        cairo_text_extents_t te;
+        measure(code_point, te);
+        i = m_sparse.emplace(code_point, te).first;
+    }
+
+    return i->second;
+}
+
+void GlyphCache::extents(const char* begin, const char* end, cairo_text_extents_t& te)
+{
+    te = {};
+
+    /*
+     * The same as cairo_scaled_font_glyph_extents(): the ink of glyphs that
+     * have any, placed one after the other, and the sum of the advances.
+     */
+    auto min_x = std::numeric_limits<double>::max();
+    auto min_y = std::numeric_limits<double>::max();
+    auto max_x = std::numeric_limits<double>::lowest();
+    auto max_y = std::numeric_limits<double>::lowest();
+    bool visible = false;
+    double x = 0;
+    double y = 0;
+
+    try
+    {
+        for (auto i = begin; i != end;)
+        {
+            const auto& glyph = extents(utf8::next(i, end));
+
+            if (glyph.width > 0 && glyph.height > 0)
+            {
+                min_x = std::min(min_x, x + glyph.x_bearing);
+                min_y = std::min(min_y, y + glyph.y_bearing);
+                max_x = std::max(max_x, x + glyph.x_bearing + glyph.width);
+                max_y = std::max(max_y, y + glyph.y_bearing + glyph.height);
+                visible = true;
+            }
+
+            x += glyph.x_advance;
+            y += glyph.y_advance;
+        }
+    }
+    catch (const utf8::exception&)
+    {
+        te = {};
+        return;
+    }
+
+    if (visible)
+    {
+        te.x_bearing = min_x;
+        te.y_bearing = min_y;
+        te.width = max_x - min_x;
+        te.height = max_y - min_y;
+    }
+
+    te.x_advance = x;
+    te.y_advance = y;
+}
+
+double GlyphCache::advance(const char* begin, const char* end)
+{
+    double x = 0;
+
+    try
+    {
+        for (auto i = begin; i != end;)
+            x += extents(utf8::next(i, end)).x_advance;
+    }
+    catch (const utf8::exception&)
+    {
+        return 0;
+    }
+
+    return x;
+}
+
+size_t GlyphCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sparse.size() +
+           std::count_if(m_dense_valid.begin(), m_dense_valid.end(),
+                         [](const std::atomic<bool>& valid) { return valid.load(); });
+}
+
+}
+}
+}
@@ -142,14 +142,13 @@ EGT_API shared_cairo_surface_t load_image_from_memory(const unsigned char* data,
 
 shared_cairo_surface_t load_image_from_resource(const std::string& name)
 {
-    if (!ResourceManager::instance().exists(name.c_str()))
+    // keep the data alive while decoding, even if trimmed meanwhile
+    size_t len = 0;
+    const auto data = ResourceManager::instance().share(name.c_str(), len);
+    if (!data)
         throw std::runtime_error("resource not found: " + name);
 
-    ResourceManager::instance().stream_reset(name.c_str());
-
-    return load_image_from_memory(ResourceManager::instance().data(name.c_str()),
-                                  ResourceManager::instance().size(name.c_str()),
-                                  name);
+    return load_image_from_memory(data.get(), len, name);
 }
 
 shared_cairo_surface_t load_image_from_filesystem(const std::string& path)
@@ -314,6 +313,7 @@ private:
         case 0x504B0304:
             return MIME_ZIP;
         case 0xA22A5050:
+        case 0xA32A5050:
             return MIME_ERAW;
         default:
             break;
@@ -12,7 +12,15 @@
 #include "egt/detail/image.h"
 #include "egt/detail/imagecache.h"
 #include "egt/detail/math.h"
+#include "egt/imageatlas.h"
+#include "egt/resource.h"
 #include "egt/respath.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
 
 #ifdef HAVE_SIMD
 #include "Simd/SimdLib.hpp"
@@ -25,6 +33,150 @@ inline namespace v1
 namespace detail
 {
 
+static size_t default_budget()
+{
+    // kilobytes
+    long size = 16384;
+
+    const auto* value = std::getenv("EGT_IMAGE_CACHE_SIZE");
+    if (value && strlen(value))
+    {
+        const auto s = std::strtol(value, nullptr, 10);
+        if (s >= 0)
+            size = s;
+        else
+            detail::warn("invalid EGT_IMAGE_CACHE_SIZE: {}", value);
+    }
+
+    return static_cast<size_t>(size) * 1024;
+}
+
+static size_t surface_bytes(cairo_surface_t* surface)
+{
+    return static_cast<size_t>(cairo_image_surface_get_stride(surface)) *
+           cairo_image_surface_get_height(surface);
+}
+
+size_t ImageCache::KeyHash::operator()(const Key& key) const noexcept
+{
+    auto h = std::hash<std::string>()(key.uri);
+    h ^= (static_cast<size_t>(key.hscale) + 0x9e3779b9 + (h << 6) + (h >> 2));
+    h ^= (static_cast<size_t>(key.vscale) + 0x9e3779b9 + (h << 6) + (h >> 2));
+    return h;
+}
+
+ImageCache::ImageCache()
+    : m_budget(default_budget())
+{}
+
+shared_cairo_surface_t ImageCache::find(const std::string& uri,
+                                        float hscale, float vscale, bool approximate)
+{
+    auto i = m_entries.find(key(uri, hscale, vscale, approximate));
+    if (i == m_entries.end())
+        return nullptr;
+
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, i->second.lru);
+    return i->second.surface;
+}
+
+void ImageCache::add(const std::string& uri, const shared_cairo_surface_t& surface,
+                     float hscale, float vscale, bool approximate)
+{
+    ++m_stats.misses;
+    insert(key(uri, hscale, vscale, approximate), surface);
+}
+
+shared_cairo_surface_t ImageCache::load(SchemeType type, const std::string& path)
+{
+    switch (type)
+    {
+    case detail::SchemeType::resource:
+        return detail::load_image_from_resource(path);
+    case detail::SchemeType::filesystem:
+        return detail::load_image_from_filesystem(path);
+    case detail::SchemeType::network:
+        return detail::load_image_from_network(path);
+    case detail::SchemeType::atlas:
+        return detail::load_image_from_atlas(path);
+    default:
+        break;
+    }
+
+    throw std::runtime_error("unsupported uri: " + path);
+}
+
+/*
+ * Find the pre-scaled variant of a resource that is closest to a scale.
+ * Upscaling loses detail, so smaller variants count as further away.
+ */
+static std::string find_variant(const std::string& name, float hscale, float vscale,
+                                float& variant_hscale, float& variant_vscale)
+{
+    const auto distance = [hscale, vscale](float h, float v)
+    {
+        auto d = std::fabs(h - hscale) + std::fabs(v - vscale);
+        if (h < hscale || v < vscale)
+            d *= 2;
+        return d;
+    };
+
+    // the original is a candidate too
+    auto best = distance(1.0, 1.0);
+    std::string result;
+
+    const auto prefix = name + "@";
+    for (const auto& item : ResourceManager::instance().variants(name.c_str()))
+    {
+        const auto tag = item.c_str() + prefix.size();
+        char* end = nullptr;
+        const auto h = std::strtof(tag, &end);
+        auto v = h;
+        if (end != tag && *end == 'x')
+            v = std::strtof(end + 1, &end);
+        if (end == tag || *end || h <= 0 || v <= 0)
+            continue;
+
+        const auto d = distance(h, v);
+        if (d < best)
+        {
+            best = d;
+            result = item;
+            variant_hscale = h;
+            variant_vscale = v;
+        }
+    }
+
+    return result;
+}
+
+shared_cairo_surface_t ImageCache::load_variant(const std::string& name,
+        float hscale, float vscale)
+{
+    float variant_hscale = 1.0;
+    float variant_vscale = 1.0;
+    const auto variant = find_variant(name, hscale, vscale, variant_hscale, variant_vscale);
+    if (variant.empty())
+        return nullptr;
+
+    auto surface = detail::load_image_from_resource(variant);
+    if (!surface || cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+        return nullptr;
+
+    EGTLOG_DEBUG("image variant {} for {} hscale:{} vscale:{}", variant, name, hscale, vscale);
+
+    if (std::fabs(variant_hscale - hscale) < 0.001f &&
+        std::fabs(variant_vscale - vscale) < 0.001f)
+        return surface;
+
+    const auto width = cairo_image_surface_get_width(surface.get());
+    const auto height = cairo_image_surface_get_height(surface.get());
+    return scale_surface(surface, width, height,
+                         width / variant_hscale * hscale,
+                         height / variant_vscale * vscale);
+}
+
 shared_cairo_surface_t ImageCache::get(const std::string& uri,
                                        float hscale, float vscale, bool approximate)
 {
@@ -34,59 +186,53 @@ shared_cairo_surface_t ImageCache::get(const std::string& uri,
         vscale = ImageCache::round(vscale, 0.01);
     }
 
-    const auto nameid = id(uri, hscale, vscale);
+    auto k = key(uri, hscale, vscale, false);
 
-    auto i = m_cache.find(nameid);
-    if (i != m_cache.end())
-        return i->second;
+    auto i = m_entries.find(k);
+    if (i != m_entries.end())
+    {
+        ++m_stats.hits;
+        m_lru.splice(m_lru.begin(), m_lru, i->second.lru);
+        return i->second.surface;
+    }
+
+    ++m_stats.misses;
 
     EGTLOG_DEBUG("image cache miss {} hscale:{} vscale:{}", uri, hscale, vscale);
 
     shared_cairo_surface_t image;
 
+    std::string path;
+    const auto type = detail::resolve_path(uri, path);
+
     if (detail::float_equal(hscale, 1.0f) &&
         detail::float_equal(vscale, 1.0f))
     {
-        std::string path;
-        auto type = detail::resolve_path(uri, path);
-
-        switch (type)
-        {
-        case detail::SchemeType::resource:
-        {
-            image = detail::load_image_from_resource(path);
-            break;
-        }
-        case detail::SchemeType::filesystem:
-        {
-            image = detail::load_image_from_filesystem(path);
-            break;
-        }
-        case detail::SchemeType::network:
-        {
-            image = detail::load_image_from_network(path);
-            break;
-        }
-        default:
-        {
+        if (type == detail::SchemeType::unknown)
             throw std::runtime_error("unsupported uri: " + uri);
-        }
-        }
+
+        image = load(type, path);
     }
     else
     {
-        shared_cairo_surface_t back = get(uri, 1.0);
+        if (type == detail::SchemeType::resource)
+            image = load_variant(path, hscale, vscale);
 
-        auto width = cairo_image_surface_get_width(back.get());
-        auto height = cairo_image_surface_get_height(back.get());
-
-        detail::code_timer(false, "scale: ", [&]()
+        if (!image)
         {
-            image = scale_surface(back,
-                                  width, height,
-                                  width * hscale,
-                                  height * vscale);
-        });
+            shared_cairo_surface_t back = get(uri, 1.0);
+
+            auto width = cairo_image_surface_get_width(back.get());
+            auto height = cairo_image_surface_get_height(back.get());
+
+            detail::code_timer(false, "scale: ", [&]()
+            {
+                image = scale_surface(back,
+                                      width, height,
+                                      width * hscale,
+                                      height * vscale);
+            });
+        }
     }
 
     if (!image)
@@ -100,14 +246,66 @@ shared_cairo_surface_t ImageCache::get(const std::string& uri,
                                      "cairo: {}: {}", cairo_status_to_string(cairo_surface_status(image.get())), uri));
     }
 
-    m_cache.insert(std::make_pair(nameid, image));
+    image = convert_opaque(image, m_native_format);
+
+    insert(std::move(k), image);
 
     return image;
 }
 
+void ImageCache::insert(Key key, const shared_cairo_surface_t& surface)
+{
+    const auto bytes = surface_bytes(surface.get());
+
+    evict(bytes);
+
+    auto result = m_entries.emplace(std::move(key), Entry{surface, bytes, {}});
+    if (!result.second)
+        return;
+
+    m_lru.push_front(&result.first->first);
+    result.first->second.lru = m_lru.begin();
+    m_used += bytes;
+}
+
 void ImageCache::clear()
 {
-    m_cache.clear();
+    m_entries.clear();
+    m_lru.clear();
+    m_used = 0;
+}
+
+void ImageCache::budget(size_t bytes)
+{
+    m_budget = bytes;
+    evict(0);
+}
+
+void ImageCache::evict(size_t bytes)
+{
+    if (!m_budget)
+        return;
+
+    auto i = m_lru.end();
+    while (i != m_lru.begin() && m_used + bytes > m_budget)
+    {
+        --i;
+
+        auto entry = m_entries.find(**i);
+        assert(entry != m_entries.end());
+
+        // still in use outside of the cache, releasing it would not free
+        // anything
+        if (entry->second.surface.use_count() > 1)
+            continue;
+
+        EGTLOG_DEBUG("image cache evict {}", entry->first.uri);
+
+        m_used -= entry->second.bytes;
+        i = m_lru.erase(i);
+        m_entries.erase(entry);
+        ++m_stats.evictions;
+    }
 }
 
 float ImageCache::round(float v, float fraction)
@@ -115,49 +313,96 @@ float ImageCache::round(float v, float fraction)
     return floorf(v) + floorf((v - floorf(v)) / fraction) * fraction;
 }
 
-std::string ImageCache::id(const std::string& name, float hscale, float vscale)
+ImageCache::Key ImageCache::key(const std::string& name, float hscale, float vscale,
+                                bool approximate)
 {
-    return fmt::format("{}-{}-{}", name, hscale * 100, vscale * 100);
+    static_assert(sizeof(float) == sizeof(uint32_t), "unexpected float size");
+
+    if (approximate)
+    {
+        hscale = ImageCache::round(hscale, 0.01);
+        vscale = ImageCache::round(vscale, 0.01);
+    }
+
+    Key k{name, 0, 0};
+    std::memcpy(&k.hscale, &hscale, sizeof(hscale));
+    std::memcpy(&k.vscale, &vscale, sizeof(vscale));
+    return k;
 }
 
-#ifdef HAVE_SIMD
-shared_cairo_surface_t
-ImageCache::scale_surface(const shared_cairo_surface_t& old_surface,
-                          float old_width, float old_height,
-                          float new_width, float new_height)
+/*
+ * Returns true if a surface has no transparent pixels.  Formats without alpha
+ * are opaque by definition, ARGB32 has to be looked at.
+ */
+static bool opaque(cairo_surface_t* surface)
 {
-    cairo_surface_flush(old_surface.get());
+    switch (cairo_image_surface_get_format(surface))
+    {
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_RGB16_565:
+    case CAIRO_FORMAT_RGB30:
+        return true;
+    case CAIRO_FORMAT_ARGB32:
+        break;
+    default:
+        return false;
+    }
 
-    auto new_surface = shared_cairo_surface_t(
-                           cairo_surface_create_similar(old_surface.get(),
-                                   CAIRO_CONTENT_COLOR_ALPHA,
-                                   new_width,
-                                   new_height),
-                           cairo_surface_destroy);
+    cairo_surface_flush(surface);
 
-    auto src = cairo_image_surface_get_data(old_surface.get());
-    auto dst = cairo_image_surface_get_data(new_surface.get());
+    const auto data = cairo_image_surface_get_data(surface);
+    const auto width = cairo_image_surface_get_width(surface);
+    const auto height = cairo_image_surface_get_height(surface);
+    const auto stride = cairo_image_surface_get_stride(surface);
 
-    SimdResizeBilinear(src,
-                       old_width, old_height,
-                       cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, old_width),
-                       dst, new_width, new_height,
-                       cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, new_width),
-                       4);
+    for (auto y = 0; y < height; ++y)
+    {
+        const auto row = reinterpret_cast<const uint32_t*>(data + y * stride);
+        for (auto x = 0; x < width; ++x)
+            if ((row[x] >> 24) != 0xff)
+                return false;
+    }
 
-    cairo_surface_mark_dirty(new_surface.get());
+    return true;
+}
 
-    return new_surface;
+shared_cairo_surface_t ImageCache::convert_opaque(const shared_cairo_surface_t& surface,
+        cairo_format_t format)
+{
+    if (format != CAIRO_FORMAT_RGB16_565 && format != CAIRO_FORMAT_RGB24)
+        return surface;
+
+    if (cairo_image_surface_get_format(surface.get()) == format ||
+        !opaque(surface.get()))
+        return surface;
+
+    auto result = shared_cairo_surface_t(
+                      cairo_image_surface_create(format,
+                              cairo_image_surface_get_width(surface.get()),
+                              cairo_image_surface_get_height(surface.get())),
+                      cairo_surface_destroy);
+    if (cairo_surface_status(result.get()) != CAIRO_STATUS_SUCCESS)
+        return surface;
+
+    auto cr = shared_cairo_t(cairo_create(result.get()), cairo_destroy);
+    cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr.get(), surface.get(), 0, 0);
+    cairo_paint(cr.get());
+
+    return result;
 }
-#else
-shared_cairo_surface_t
-ImageCache::scale_surface(const shared_cairo_surface_t& old_surface,
-                          float old_width, float old_height,
-                          float new_width, float new_height)
+
+static shared_cairo_surface_t paint_scaled(const shared_cairo_surface_t& old_surface,
+        float old_width, float old_height,
+        float new_width, float new_height)
 {
+    // keep opaque surfaces in their format, the edges are padded below
+    auto format = cairo_image_surface_get_format(old_surface.get());
+    if (format != CAIRO_FORMAT_RGB16_565 && format != CAIRO_FORMAT_RGB24)
+        format = CAIRO_FORMAT_ARGB32;
+
     auto new_surface = shared_cairo_surface_t(
-                           cairo_surface_create_similar(old_surface.get(),
-                                   CAIRO_CONTENT_COLOR_ALPHA,
+                           cairo_image_surface_create(format,
                                    new_width,
                                    new_height),
                            cairo_surface_destroy);
@@ -183,8 +428,44 @@ ImageCache::scale_surface(const shared_cairo_surface_t& old_surface,
 
     return new_surface;
 }
+
+shared_cairo_surface_t
+ImageCache::scale_surface(const shared_cairo_surface_t& old_surface,
+                          float old_width, float old_height,
+                          float new_width, float new_height)
+{
+#ifdef HAVE_SIMD
+    // SimdResizeBilinear only handles 32 bit pixels
+    if (cairo_image_surface_get_format(old_surface.get()) == CAIRO_FORMAT_ARGB32)
+    {
+        cairo_surface_flush(old_surface.get());
+
+        auto new_surface = shared_cairo_surface_t(
+                               cairo_surface_create_similar(old_surface.get(),
+                                       CAIRO_CONTENT_COLOR_ALPHA,
+                                       new_width,
+                                       new_height),
+                               cairo_surface_destroy);
+
+        auto src = cairo_image_surface_get_data(old_surface.get());
+        auto dst = cairo_image_surface_get_data(new_surface.get());
+
+        SimdResizeBilinear(src,
+                           old_width, old_height,
+                           cairo_image_surface_get_stride(old_surface.get()),
+                           dst, new_width, new_height,
+                           cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, new_width),
+                           4);
+
+        cairo_surface_mark_dirty(new_surface.get());
+
+        return new_surface;
+    }
 #endif
 
+    return paint_scaled(old_surface, old_width, old_height, new_width, new_height);
+}
+
 ImageCache& image_cache()
 {
     static ImageCache cache;
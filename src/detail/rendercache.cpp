@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "detail/egtlog.h"
+#include "egt/detail/rendercache.h"
+#include <cairo.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+static size_t default_budget()
+{
+    // kilobytes
+    long size = 4096;
+
+    const auto* value = std::getenv("EGT_RENDER_CACHE_SIZE");
+    if (value && strlen(value))
+    {
+        const auto s = std::strtol(value, nullptr, 10);
+        if (s >= 0)
+            size = s;
+        else
+            detail::warn("invalid EGT_RENDER_CACHE_SIZE: {}", value);
+    }
+
+    return static_cast<size_t>(size) * 1024;
+}
+
+RenderCache::RenderCache()
+    : m_budget(default_budget())
+{}
+
+RenderCache::Entry* RenderCache::get(const Widget* widget, const Size& size)
+{
+    auto i = m_entries.find(widget);
+    if (i != m_entries.end())
+    {
+        if (i->second.size == size)
+        {
+            m_lru.splice(m_lru.begin(), m_lru, i->second.lru);
+            return &i->second;
+        }
+
+        remove(widget);
+    }
+
+    if (size.empty())
+        return nullptr;
+
+    const auto stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, size.width());
+    const auto bytes = static_cast<size_t>(stride) * size.height();
+    if (bytes > m_budget)
+        return nullptr;
+
+    evict(bytes);
+
+    shared_cairo_surface_t surface(
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size.width(), size.height()),
+        cairo_surface_destroy);
+    if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+        return nullptr;
+
+    m_lru.push_front(widget);
+
+    auto& entry = m_entries[widget];
+    entry.surface = std::move(surface);
+    entry.size = size;
+    entry.bytes = bytes;
+    entry.valid = false;
+    entry.lru = m_lru.begin();
+    m_used += bytes;
+
+    return &entry;
+}
+
+void RenderCache::validate(const Widget* widget)
+{
+    auto i = m_entries.find(widget);
+    if (i != m_entries.end())
+        i->second.valid = true;
+}
+
+void RenderCache::invalidate(const Widget* widget)
+{
+    auto i = m_entries.find(widget);
+    if (i != m_entries.end())
+        i->second.valid = false;
+}
+
+void RenderCache::remove(const Widget* widget)
+{
+    auto i = m_entries.find(widget);
+    if (i == m_entries.end())
+        return;
+
+    m_used -= i->second.bytes;
+    m_lru.erase(i->second.lru);
+    m_entries.erase(i);
+}
+
+void RenderCache::clear()
+{
+    m_entries.clear();
+    m_lru.clear();
+    m_used = 0;
+}
+
+void RenderCache::budget(size_t bytes)
+{
+    m_budget = bytes;
+    evict(0);
+}
+
+void RenderCache::evict(size_t bytes)
+{
+    while (!m_lru.empty() && m_used + bytes > m_budget)
+    {
+        EGTLOG_DEBUG("render cache evict");
+        remove(m_lru.back());
+        ++m_stats.evictions;
+    }
+}
+
+RenderCache& render_cache()
+{
+    static RenderCache cache;
+    return cache;
+}
+
+}
+}
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_SRC_DETAIL_RENDERPOOL_H
+#define EGT_SRC_DETAIL_RENDERPOOL_H
+
+#include "egt/detail/meta.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+/**
+ * Fixed pool of threads that run the jobs of a parallel loop.
+ *
+ * run() hands out the indexes of the loop to the workers and the calling
+ * thread, and returns once all of them are done.  Only one thread may call
+ * run() at a time.
+ */
+class RenderPool : private NonCopyable<RenderPool>
+{
+public:
+
+    /// Job invoked with the index of the item to process.
+    using Job = std::function<void(size_t)>;
+
+    /**
+     * @param[in] threads Total number of threads, including the caller of run().
+     */
+    explicit RenderPool(size_t threads)
+    {
+        for (size_t i = 1; i < threads; ++i)
+            m_workers.emplace_back(&RenderPool::worker, this);
+    }
+
+    /// Number of threads running jobs, including the caller of run().
+    EGT_NODISCARD size_t threads() const { return m_workers.size() + 1; }
+
+    /**
+     * Call @p job for every index in [0, count) and wait for all calls to
+     * return.
+     *
+     * If any call throws, the first exception is rethrown here.
+     */
+    void run(size_t count, const Job& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_count = count;
+            m_next = 0;
+            m_active = m_workers.size();
+            m_error = nullptr;
+            ++m_generation;
+        }
+        m_start.notify_all();
+
+        work();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_active == 0; });
+        m_job = nullptr;
+
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+    ~RenderPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+
+        for (auto& t : m_workers)
+            t.join();
+    }
+
+private:
+
+    void work()
+    {
+        try
+        {
+            size_t i;
+            while ((i = m_next.fetch_add(1)) < m_count)
+                (*m_job)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+                m_error = std::current_exception();
+            // let the other threads finish early
+            m_next = m_count;
+        }
+    }
+
+    void worker()
+    {
+        uint64_t generation = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [this, generation]()
+                {
+                    return m_stop || m_generation != generation;
+                });
+
+                if (m_stop)
+                    return;
+
+                generation = m_generation;
+            }
+
+            work();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_active == 0)
+                m_done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const Job* m_job{nullptr};
+    size_t m_count{0};
+    std::atomic<size_t> m_next{0};
+    size_t m_active{0};
+    uint64_t m_generation{0};
+    std::exception_ptr m_error;
+    bool m_stop{false};
+};
+
+}
+}
+}
+
+#endif
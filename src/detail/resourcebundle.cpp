@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "detail/resourcebundle.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_set>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+#ifndef WIN32
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "resource bundles are only implemented for little endian");
+#endif
+
+static constexpr size_t align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+ResourceBundle::ResourceBundle(const unsigned char* data, size_t len)
+    : m_data(data),
+      m_len(len)
+{
+    if (len < sizeof(Header))
+        throw std::runtime_error("resource bundle too small");
+
+    const auto& h = header();
+    if (h.magic != MAGIC || h.version != VERSION)
+        throw std::runtime_error("not a resource bundle");
+
+    if ((h.count && !h.buckets) ||
+        sizeof(Header) + static_cast<uint64_t>(h.buckets) * sizeof(uint32_t) > h.entries ||
+        h.entries % alignof(Entry) || h.entries > len ||
+        h.entries + static_cast<uint64_t>(h.count) * sizeof(Entry) > h.names ||
+        h.names > len)
+        throw std::runtime_error("invalid resource bundle index");
+}
+
+uint32_t ResourceBundle::hash(const char* name, size_t len, uint32_t seed)
+{
+    // FNV-1a, seeded, with the murmur3 finalizer so seeds spread well
+    uint32_t h = 0x811c9dc5u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(name[i]);
+        h *= 0x01000193u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+const ResourceBundle::Entry* ResourceBundle::find(const std::string& name) const
+{
+    const auto& h = header();
+    if (!h.count)
+        return nullptr;
+
+    const auto d = displacements()[hash(name.data(), name.size(), 0) % h.buckets];
+    const auto& entry = entries()[hash(name.data(), name.size(), d) % h.count];
+
+    // entries are checked as they are used, so opening a bundle is free
+    if (entry.name_size != name.size() ||
+        h.names + entry.name + entry.name_size > m_len ||
+        entry.offset + entry.size > m_len ||
+        entry.offset + entry.size < entry.offset)
+        return nullptr;
+
+    if (std::memcmp(m_data + h.names + entry.name, name.data(), name.size()) != 0)
+        return nullptr;
+
+    return &entry;
+}
+
+std::string ResourceBundle::name(const Entry& entry) const
+{
+    const auto& h = header();
+    if (h.names + entry.name + entry.name_size > m_len)
+        return {};
+
+    return {reinterpret_cast<const char*>(m_data + h.names + entry.name), entry.name_size};
+}
+
+namespace
+{
+
+/// A bundle file mapped read only.
+struct Mapping
+{
+    void* addr{nullptr};
+    size_t len{0};
+
+    Mapping() = default;
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    ~Mapping()
+    {
+#ifndef WIN32
+        if (addr)
+            munmap(addr, len);
+#else
+        delete [] static_cast<unsigned char*>(addr);
+#endif
+    }
+};
+
+struct MappedBundle : public ResourceBundle
+{
+    explicit MappedBundle(std::unique_ptr<Mapping> mapping)
+        : ResourceBundle(static_cast<const unsigned char*>(mapping->addr), mapping->len),
+          m_mapping(std::move(mapping))
+    {}
+
+    std::unique_ptr<Mapping> m_mapping;
+};
+
+}
+
+std::shared_ptr<ResourceBundle> ResourceBundle::map(const std::string& path)
+{
+    auto mapping = std::make_unique<Mapping>();
+#ifndef WIN32
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("unable to open resource bundle: " + path);
+    struct stat st {};
+    if (fstat(fd, &st) < 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("unable to open resource bundle: " + path);
+    }
+    auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error("unable to map resource bundle: " + path);
+    mapping->addr = addr;
+    mapping->len = st.st_size;
+#else
+    std::ifstream i(path, std::ios_base::binary | std::ios_base::ate);
+    if (!i)
+        throw std::runtime_error("unable to open resource bundle: " + path);
+    const auto len = static_cast<size_t>(i.tellg());
+    mapping->addr = new unsigned char[len];
+    mapping->len = len;
+    i.seekg(0);
+    if (!i.read(static_cast<char*>(mapping->addr), len))
+        throw std::runtime_error("unable to read resource bundle: " + path);
+#endif
+
+    return std::make_shared<MappedBundle>(std::move(mapping));
+}
+
+void ResourceBundle::write(const std::string& path, const std::vector<Item>& items,
+                           size_t alignment)
+{
+    if (!alignment)
+        alignment = 1;
+
+    const auto count = static_cast<uint32_t>(items.size());
+
+    std::unordered_set<std::string> names;
+    for (const auto& item : items)
+        if (!names.insert(item.name).second)
+            throw std::runtime_error("duplicate resource in bundle: " + item.name);
+
+    /*
+     * Hash and displace: names are spread over buckets, and the buckets are
+     * placed from the largest to the smallest by looking for a displacement
+     * that sends all of their names to free slots.
+     */
+    const uint32_t buckets = count ? (count + 3) / 4 : 0;
+    std::vector<std::vector<uint32_t>> bucket_items(buckets);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const auto& name = items[i].name;
+        bucket_items[hash(name.data(), name.size(), 0) % buckets].push_back(i);
+    }
+
+    std::vector<uint32_t> order(buckets);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&bucket_items](uint32_t a, uint32_t b)
+    {
+        return bucket_items[a].size() > bucket_items[b].size();
+    });
+
+    constexpr uint32_t max_displacement = 1u << 24;
+    std::vector<uint32_t> displacements(buckets);
+    std::vector<int64_t> slots(count, -1);
+    std::vector<uint32_t> candidate;
+    for (const auto b : order)
+    {
+        const auto& bucket = bucket_items[b];
+        if (bucket.empty())
+            break;
+
+        uint32_t d = 1;
+        for (; d < max_displacement; ++d)
+        {
+            candidate.clear();
+            for (const auto i : bucket)
+            {
+                const auto& name = items[i].name;
+                const auto slot = hash(name.data(), name.size(), d) % count;
+                if (slots[slot] >= 0 ||
+                    std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+                    break;
+                candidate.push_back(slot);
+            }
+
+            if (candidate.size() == bucket.size())
+                break;
+        }
+
+        if (d == max_displacement)
+            throw std::runtime_error("unable to build resource bundle index");
+
+        displacements[b] = d;
+        for (size_t i = 0; i < bucket.size(); ++i)
+            slots[candidate[i]] = bucket[i];
+    }
+
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.count = count;
+    header.buckets = buckets;
+    header.entries = align(sizeof(Header) + buckets * sizeof(uint32_t), alignof(Entry));
+    header.names = header.entries + count * sizeof(Entry);
+
+    std::vector<Entry> entries(count);
+    std::string name_data;
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        const auto& item = items[slots[slot]];
+        auto& entry = entries[slot];
+        entry.name = name_data.size();
+        entry.name_size = item.name.size();
+        entry.flags = item.flags;
+        name_data += item.name;
+    }
+
+    auto offset = align(header.names + name_data.size(), alignment);
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        auto& entry = entries[slot];
+        entry.offset = offset;
+        entry.size = items[slots[slot]].size;
+        offset = align(offset + entry.size, alignment);
+    }
+
+    std::ofstream out(path, std::ios_base::binary | std::ios_base::trunc);
+    if (!out)
+        throw std::runtime_error("unable to create resource bundle: " + path);
+
+    auto pad = [&out](size_t to)
+    {
+        static const char zeros[64] = {};
+        auto position = static_cast<size_t>(out.tellp());
+        while (position < to)
+        {
+            const auto n = std::min(sizeof(zeros), to - position);
+            out.write(zeros, n);
+            position += n;
+        }
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(displacements.data()),
+              displacements.size() * sizeof(uint32_t));
+    pad(header.entries);
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    out.write(name_data.data(), name_data.size());
+
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        pad(entries[slot].offset);
+        const auto& item = items[slots[slot]];
+        out.write(reinterpret_cast<const char*>(item.data), item.size);
+    }
+
+    if (!out)
+        throw std::runtime_error("unable to write resource bundle: " + path);
+}
+
+}
+}
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef EGT_SRC_DETAIL_RESOURCEBUNDLE_H
+#define EGT_SRC_DETAIL_RESOURCEBUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+/**
+ * Many resources packed in one file meant to be memory mapped.
+ *
+ * The layout of a bundle is:
+ *
+ *     [header]
+ *     [displacement...]    one per bucket
+ *     [entry...]           one per resource, at its hash slot
+ *     [name...]
+ *     [payload...]         each aligned to the alignment of the bundle
+ *
+ * A resource is found with a perfect hash: the name hashed with seed 0
+ * selects a bucket, and the name hashed with the displacement of that bucket
+ * as seed selects the entry.  The name of the entry is then compared, to tell
+ * resources that are not in the bundle apart.  Nothing is read from the
+ * bundle until a resource is looked up, and payloads are only paged in when
+ * they are used.
+ *
+ * All values are little endian.
+ */
+class ResourceBundle
+{
+public:
+
+    /// Bundle header.
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        /// Number of entries.
+        uint32_t count;
+        /// Number of buckets, and displacements.
+        uint32_t buckets;
+        /// Offset of the entries.
+        uint64_t entries;
+        /// Offset of the names.
+        uint64_t names;
+    };
+
+    /// Entry flags.
+    enum Flags : uint32_t
+    {
+        /// The payload is compressed with gzip.
+        compressed = 1u << 0,
+    };
+
+    /// One resource.
+    struct Entry
+    {
+        /// Offset of the payload.
+        uint64_t offset;
+        /// Size of the payload.
+        uint64_t size;
+        /// Offset of the name in the names.
+        uint32_t name;
+        /// Length of the name.
+        uint32_t name_size;
+        /// Flags.
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 32, "bundle header must be packed");
+    static_assert(sizeof(Entry) == 32, "bundle entry must be packed");
+
+    /// "EGTB"
+    static constexpr uint32_t MAGIC = 0x42544745;
+    static constexpr uint32_t VERSION = 1;
+
+    /**
+     * Open a bundle in memory.
+     *
+     * @param data The bundle, which must stay available.
+     * @param len Length of the bundle.
+     * @throws std::runtime_error if the bundle is invalid.
+     */
+    ResourceBundle(const unsigned char* data, size_t len);
+
+    /**
+     * Map a bundle file.
+     *
+     * @throws std::runtime_error if the file cannot be mapped or the bundle
+     *         is invalid.
+     */
+    static std::shared_ptr<ResourceBundle> map(const std::string& path);
+
+    /**
+     * Find a resource.
+     *
+     * @return nullptr if there is no resource named @p name.
+     */
+    const Entry* find(const std::string& name) const;
+
+    /// Get the payload of an entry.
+    const unsigned char* data(const Entry& entry) const { return m_data + entry.offset; }
+
+    /// Get the name of an entry.
+    std::string name(const Entry& entry) const;
+
+    /// Get the number of entries.
+    uint32_t count() const { return header().count; }
+
+    /// Get all entries.
+    const Entry* entries() const
+    {
+        return reinterpret_cast<const Entry*>(m_data + header().entries);
+    }
+
+    /// A resource to write.
+    struct Item
+    {
+        std::string name;
+        const unsigned char* data;
+        size_t size;
+        uint32_t flags;
+    };
+
+    /**
+     * Write a bundle.
+     *
+     * @param path Path of the file to write.
+     * @param items The resources, with unique names.
+     * @param alignment Alignment of payloads, normally the page size.
+     * @throws std::runtime_error on failure.
+     */
+    static void write(const std::string& path, const std::vector<Item>& items,
+                      size_t alignment = 4096);
+
+    /**
+     * Hash used for names.
+     */
+    static uint32_t hash(const char* name, size_t len, uint32_t seed);
+
+    virtual ~ResourceBundle() = default;
+
+protected:
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(m_data); }
+
+    const uint32_t* displacements() const
+    {
+        return reinterpret_cast<const uint32_t*>(m_data + sizeof(Header));
+    }
+
+    const unsigned char* m_data;
+    size_t m_len;
+};
+
+}
+}
+}
+
+#endif
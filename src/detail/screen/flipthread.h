@@ -3,14 +3,19 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
-#include "detail/egtlog.h"
 #include "egt/detail/meta.h"
+#include "egt/detail/screen/kmstype.h"
+#include "egt/geometry.h"
 #include <atomic>
-#include <condition_variable>
-#include <deque>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
-#include <mutex>
+#include <stdexcept>
+#include <sys/eventfd.h>
 #include <thread>
+#include <unistd.h>
 
 namespace egt
 {
@@ -19,71 +24,229 @@ inline namespace v1
 namespace detail
 {
 
+/**
+ * Flip descriptor.
+ *
+ * Everything needed to present a buffer of a plane, copied by value into the
+ * flip queue.
+ */
+struct FlipRequest
+{
+    /// Plane to flip.
+    plane_data* plane{nullptr};
+    /// Buffer index to present.
+    uint32_t index{0};
+    /// Use plane_flip_async() instead of plane_flip().
+    bool async{false};
+    /// Bounding box of the damage in the buffer.
+    Rect damage;
+    /// When the request was queued.
+    std::chrono::steady_clock::time_point queued;
+};
+
+/// Function that presents a FlipRequest, called on the flip thread.
+using FlipFunction = std::function<void(const FlipRequest&)>;
+
+/// Present a FlipRequest with plane_flip() or plane_flip_async().
+void flip_plane(const FlipRequest& request);
+
 /**
  * Flip thread queue.
  *
  * This creates a flip queue used for queuing up flip calls when using more
  * than one buffer.
+ *
+ * The queue is a fixed size single-producer single-consumer ring of
+ * FlipRequest descriptors, so queuing a flip never allocates or takes a lock.
+ * The producer is the thread calling enqueue(), the consumer is the internal
+ * flip thread.  Either side only enters the kernel, through an eventfd, when
+ * it has to sleep or wake the other side up.
+ *
+ * Requests are presented by calling a FlipFunction on the flip thread, which
+ * is normally flip_plane().
  */
 struct FlipThread : private NonCopyable<FlipThread>
 {
-    explicit FlipThread(uint32_t max_queue = 0)
-        : m_max_queue(max_queue)
+    FlipThread(uint32_t max_queue, FlipFunction flip)
+        : m_capacity(max_queue ? max_queue : 1),
+          m_flip(std::move(flip)),
+          m_ring(new FlipRequest[m_capacity]),
+          m_ready(eventfd(0, EFD_CLOEXEC)),
+          m_space(eventfd(0, EFD_CLOEXEC))
     {
+        if (m_ready < 0 || m_space < 0)
+        {
+            close_fds();
+            throw std::runtime_error("failed to create flip queue eventfd");
+        }
+
         m_thread = std::thread(&FlipThread::run, this);
     }
 
     void run()
     {
-        std::function<void()> task;
         while (true)
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
+            const auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                // announce that we are about to sleep, then check again so a
+                // request queued in between is not missed
+                m_consumer_waiting.store(true, std::memory_order_seq_cst);
+                if (!m_stop.load() && head == m_tail.load(std::memory_order_seq_cst))
+                    wait(m_ready);
+                m_consumer_waiting.store(false, std::memory_order_relaxed);
+
+                if (m_stop.load())
+                    return;
+                continue;
+            }
+
+            const auto& request = m_ring[head % m_capacity];
 
-            while (!m_stop && m_queue.empty())
-                m_condition.wait(lock);
+            m_flip(request);
 
-            if (m_stop)
-                return;
+            const auto now = std::chrono::steady_clock::now();
 
-            task = m_queue.front();
-            m_queue.pop_front();
-            m_condition.notify_one();
-            lock.unlock();
+            // plane_flip() returns once the page flip event arrived
+            if (!request.async)
+                m_presented.store(now.time_since_epoch().count(), std::memory_order_relaxed);
 
-            task();
+            const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     now - request.queued).count();
+            m_flips.fetch_add(1, std::memory_order_relaxed);
+            m_damage_area.fetch_add(request.damage.area(), std::memory_order_relaxed);
+            m_latency.store(latency, std::memory_order_relaxed);
+            m_total_latency.fetch_add(latency, std::memory_order_relaxed);
+            if (latency > m_max_latency.load(std::memory_order_relaxed))
+                m_max_latency.store(latency, std::memory_order_relaxed);
+
+            m_head.store(head + 1, std::memory_order_seq_cst);
+
+            if (m_producer_waiting.exchange(false))
+                signal(m_space);
         }
     }
 
-    void enqueue(std::function<void()> job)
+    void enqueue(plane_data* plane, uint32_t index, bool async, const Rect& damage = {})
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto tail = m_tail.load(std::memory_order_relaxed);
 
-        while (m_max_queue && m_queue.size() >= m_max_queue)
+        if (tail - m_head.load(std::memory_order_acquire) >= m_capacity)
         {
-            EGTLOG_DEBUG("flip thread blocked");
-            m_condition.wait(lock);
+            const auto start = std::chrono::steady_clock::now();
+            while (true)
+            {
+                m_producer_waiting.store(true, std::memory_order_seq_cst);
+                if (tail - m_head.load(std::memory_order_seq_cst) < m_capacity)
+                    break;
+                wait(m_space);
+            }
+            m_producer_waiting.store(false, std::memory_order_relaxed);
+
+            m_blocked.fetch_add(1, std::memory_order_relaxed);
+            m_blocked_time.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now() - start).count(),
+                                     std::memory_order_relaxed);
         }
 
-        m_queue.emplace_back(std::move(job));
-        m_condition.notify_one();
+        auto& request = m_ring[tail % m_capacity];
+        request.plane = plane;
+        request.index = index;
+        request.async = async;
+        request.damage = damage;
+        request.queued = std::chrono::steady_clock::now();
+
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+
+        const auto depth = tail + 1 - m_head.load(std::memory_order_relaxed);
+        if (depth > m_max_depth.load(std::memory_order_relaxed))
+            m_max_depth.store(depth, std::memory_order_relaxed);
+
+        if (m_consumer_waiting.exchange(false))
+            signal(m_ready);
+    }
+
+    /// Get a snapshot of the queue statistics.
+    EGT_NODISCARD FlipStats stats() const
+    {
+        FlipStats s;
+        s.capacity = m_capacity;
+        s.depth = m_tail.load() - m_head.load();
+        s.max_depth = m_max_depth.load();
+        s.flips = m_flips.load();
+        s.blocked = m_blocked.load();
+        s.blocked_time = std::chrono::microseconds(m_blocked_time.load());
+        s.latency = std::chrono::microseconds(m_latency.load());
+        s.max_latency = std::chrono::microseconds(m_max_latency.load());
+        if (s.flips)
+            s.average_latency = std::chrono::microseconds(m_total_latency.load() / s.flips);
+        s.damage_area = m_damage_area.load();
+        return s;
+    }
+
+    /// Get the time the last synchronous flip completed.
+    EGT_NODISCARD std::chrono::steady_clock::time_point presented() const
+    {
+        return std::chrono::steady_clock::time_point(
+                   std::chrono::steady_clock::duration(m_presented.load(std::memory_order_relaxed)));
     }
 
     ~FlipThread()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
         m_stop = true;
-        m_condition.notify_all();
-        lock.unlock();
+        signal(m_ready);
         m_thread.join();
+        close_fds();
     }
 
-    std::thread m_thread;
-    std::deque<std::function<void()>> m_queue;
-    std::mutex m_mutex;
-    std::condition_variable m_condition;
+private:
+
+    static void wait(int fd)
+    {
+        uint64_t value;
+        while (read(fd, &value, sizeof(value)) < 0 && errno == EINTR)
+        {}
+    }
+
+    static void signal(int fd)
+    {
+        uint64_t value = 1;
+        while (write(fd, &value, sizeof(value)) < 0 && errno == EINTR)
+        {}
+    }
+
+    void close_fds()
+    {
+        if (m_ready >= 0)
+            ::close(m_ready);
+        if (m_space >= 0)
+            ::close(m_space);
+    }
+
+    const uint64_t m_capacity;
+    FlipFunction m_flip;
+    std::unique_ptr<FlipRequest[]> m_ring;
+    /// Index of the next request to flip, only written by the flip thread.
+    std::atomic<uint64_t> m_head{0};
+    /// Index of the next free slot, only written by enqueue().
+    std::atomic<uint64_t> m_tail{0};
+    int m_ready{-1};
+    int m_space{-1};
+    std::atomic<bool> m_consumer_waiting{false};
+    std::atomic<bool> m_producer_waiting{false};
     std::atomic<bool> m_stop{false};
-    uint32_t m_max_queue{0};
+    std::thread m_thread;
+
+    std::atomic<uint64_t> m_max_depth{0};
+    std::atomic<uint64_t> m_flips{0};
+    std::atomic<uint64_t> m_blocked{0};
+    std::atomic<int64_t> m_blocked_time{0};
+    std::atomic<int64_t> m_latency{0};
+    std::atomic<int64_t> m_max_latency{0};
+    std::atomic<int64_t> m_total_latency{0};
+    std::atomic<uint64_t> m_damage_area{0};
+    std::atomic<std::chrono::steady_clock::rep> m_presented{0};
 };
 
 }
@@ -17,25 +17,6 @@ inline namespace v1
 namespace detail
 {
 
-struct FlipJob
-{
-    constexpr explicit FlipJob(plane_data* plane, uint32_t index, bool async = false) noexcept
-        : m_plane(plane), m_index(index), m_async(async)
-    {}
-
-    void operator()()
-    {
-        if (m_async)
-            plane_flip_async(m_plane, m_index);
-        else
-            plane_flip(m_plane, m_index);
-    }
-
-    plane_data* m_plane {nullptr};
-    uint32_t m_index{};
-    bool m_async{false};
-};
-
 KMSOverlay::KMSOverlay(const Size& size, PixelFormat format, WindowHint hint)
     : m_plane(KMSScreen::instance()->allocate_overlay(size, format, hint))
 {
@@ -46,7 +27,7 @@ KMSOverlay::KMSOverlay(const Size& size, PixelFormat format, WindowHint hint)
          Size(plane_width(m_plane.get()), plane_height(m_plane.get())),
          detail::egt_format(plane_format(m_plane.get())));
 
-    m_pool = std::make_unique<FlipThread>(m_plane->buffer_count - 1);
+    m_pool = std::make_unique<FlipThread>(m_plane->buffer_count - 1, flip_plane);
 }
 
 void KMSOverlay::resize(const Size& size)
@@ -83,7 +64,8 @@ void KMSOverlay::schedule_flip()
 {
     if (m_plane->buffer_count > 1)
     {
-        m_pool->enqueue(FlipJob(m_plane.get(), m_index, m_async));
+        m_pool->enqueue(m_plane.get(), m_index, m_async, m_flip_damage);
+        m_flip_damage.clear();
 
         if (++m_index >= m_plane->buffer_count)
             m_index = 0;
@@ -95,6 +77,13 @@ uint32_t KMSOverlay::index()
     return m_index;
 }
 
+FlipStats KMSOverlay::flip_stats() const
+{
+    if (m_pool)
+        return m_pool->stats();
+    return {};
+}
+
 void KMSOverlay::position(const DisplayPoint& point)
 {
     /*
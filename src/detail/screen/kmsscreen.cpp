@@ -45,26 +45,13 @@ void plane_t_deleter::operator()(plane_data* plane)
     plane_free(plane);
 }
 
-struct FlipJob
+void flip_plane(const FlipRequest& request)
 {
-    constexpr explicit FlipJob(struct plane_data* plane,
-                               uint32_t index,
-                               bool async = false) noexcept
-        : m_plane(plane), m_index(index), m_async(async)
-    {}
-
-    void operator()()
-    {
-        if (m_async)
-            plane_flip_async(m_plane, m_index);
-        else
-            plane_flip(m_plane, m_index);
-    }
-
-    plane_data* m_plane {nullptr};
-    uint32_t m_index{};
-    bool m_async{false};
-};
+    if (request.async)
+        plane_flip_async(request.plane, request.index);
+    else
+        plane_flip(request.plane, request.index);
+}
 
 static KMSScreen* the_kms = nullptr;
 
@@ -134,7 +121,7 @@ KMSScreen::KMSScreen(bool allocate_primary_plane,
                         f,
                         m_size.width(), m_size.height()));
 
-                m_buffers.back().damage.emplace_back(Point(), m_size);
+                m_buffers.back().damage.add(Rect(Point(), m_size));
             }
 
             m_surface = shared_cairo_surface_t(
@@ -147,7 +134,7 @@ KMSScreen::KMSScreen(bool allocate_primary_plane,
         }
 #endif
 
-        m_pool = std::make_unique<FlipThread>(m_plane->buffer_count - 1);
+        m_pool = std::make_unique<FlipThread>(m_plane->buffer_count - 1, flip_plane);
     }
     else
     {
@@ -177,7 +164,8 @@ void KMSScreen::schedule_flip()
 {
     if (m_plane->buffer_count > 1)
     {
-        m_pool->enqueue(FlipJob(m_plane.get(), m_index, m_async));
+        m_pool->enqueue(m_plane.get(), m_index, m_async, m_flip_damage);
+        m_flip_damage.clear();
 
         if (++m_index >= m_plane->buffer_count)
             m_index = 0;
@@ -189,6 +177,20 @@ uint32_t KMSScreen::index()
     return m_index;
 }
 
+FlipStats KMSScreen::flip_stats() const
+{
+    if (m_pool)
+        return m_pool->stats();
+    return {};
+}
+
+std::chrono::steady_clock::time_point KMSScreen::presentation_time() const
+{
+    if (m_pool)
+        return m_pool->presented();
+    return {};
+}
+
 KMSScreen* KMSScreen::instance()
 {
     return the_kms;
@@ -182,12 +182,12 @@ void SDLScreen::key_event(EventId e, const Key& key)
     m_in.dispatch(event);
 }
 
-void SDLScreen::flip(const DamageArray& damage)
+void SDLScreen::flip(const Region& damage)
 {
     asio::post(m_io, std::bind(&SDLScreen::sdl_draw, this, damage));
 }
 
-void SDLScreen::sdl_draw(const DamageArray& damage)
+void SDLScreen::sdl_draw(const Region& damage)
 {
     void* pixels{};
     int pitch{};
@@ -93,7 +93,7 @@ X11Screen::X11Screen(Application& app, const Size& size, const std::string& name
                                   size.width(), size.height()));
     cairo_xlib_surface_set_size(m_buffers.back().surface.get(), size.width(), size.height());
 
-    m_buffers.back().damage.emplace_back(0, 0, size.width(), size.height());
+    m_buffers.back().damage.add(Rect(0, 0, size.width(), size.height()));
 
     // remove window decorations
     if (std::getenv("EGT_X11_NODECORATION"))
@@ -135,7 +135,7 @@ void X11Screen::disable_window_decorations()
                     reinterpret_cast<unsigned char*>(&hints), 5);
 }
 
-void X11Screen::flip(const DamageArray& damage)
+void X11Screen::flip(const Region& damage)
 {
     Screen::flip(damage);
     XFlush(m_priv->display);
@@ -169,10 +169,8 @@ void X11Screen::handle_read(const asio::error_code& error)
             break;
         case Expose:
         {
-            DamageArray damage;
-            damage.emplace_back(e.xexpose.x, e.xexpose.y,
-                                e.xexpose.width, e.xexpose.height);
-            flip(damage);
+            flip(Region(Rect(e.xexpose.x, e.xexpose.y,
+                             e.xexpose.width, e.xexpose.height)));
             break;
         }
         case ButtonPress:
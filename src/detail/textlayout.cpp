@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "detail/utf8text.h"
+#include "egt/detail/glyphcache.h"
+#include "egt/detail/layout.h"
+#include "egt/detail/textlayout.h"
+#include "egt/glyphatlas.h"
+#include "egt/image.h"
+#include "egt/painter.h"
+
+namespace egt
+{
+inline namespace v1
+{
+namespace detail
+{
+
+enum
+{
+    // When in a wrapping container, put this element on a new line. Wrapping
+    // layout code auto-inserts LAY_BREAK flags as needed. See GitHub issues for
+    // TODO related to this.
+    //
+    // Drawing routines can read this via item pointers as needed after
+    // performing layout calculations.
+    LAY_BREAK = 0x200
+};
+
+static void draw_text_setup(std::vector<detail::LayoutRect>& rects,
+                            cairo_t* cr,
+                            cairo_font_extents_t& fe,
+                            const std::string& text,
+                            const TextBox::TextFlags& flags)
+{
+    // tokenize based on words or code points
+    static const std::string delimiters = " \t\n\r";
+    std::vector<std::string> tokens;
+    if (flags.is_set(TextBox::TextFlag::multiline) &&
+        flags.is_set(TextBox::TextFlag::word_wrap))
+    {
+        detail::tokenize_with_delimiters(text.cbegin(),
+                                         text.cend(),
+                                         delimiters.cbegin(),
+                                         delimiters.cend(),
+                                         tokens);
+    }
+    else
+    {
+        for (utf8_const_iterator ch(text.begin(), text.begin(), text.end());
+             ch != utf8_const_iterator(text.end(), text.begin(), text.end()); ++ch)
+        {
+            tokens.emplace_back(utf8_char_to_string(ch.base(), text.cend()));
+        }
+    }
+
+    rects.reserve(tokens.size() + 2);
+
+    auto& glyphs = GlyphCache::get(cr);
+
+    uint32_t default_behave = 0;
+    uint32_t behave = default_behave;
+
+    for (auto& t : tokens)
+    {
+        if (t == "\n")
+        {
+            rects.emplace_back(behave, Rect(0, 0, 1, fe.height), std::move(t));
+            behave |= LAY_BREAK;
+        }
+        else
+        {
+            const auto advance = glyphs.advance(t);
+            rects.emplace_back(behave, Rect(0, 0, advance, fe.height), std::move(t));
+            behave = default_behave;
+        }
+    }
+}
+
+#define fl(f) static_cast<float>(f)
+
+bool TextLayout::layout(Painter& painter,
+                        const Size& size,
+                        const std::string& text,
+                        const Font& font,
+                        const TextBox::TextFlags& flags,
+                        const AlignFlags& text_align,
+                        Justification justify,
+                        const AlignFlags& image_align,
+                        const Size& image_size)
+{
+    // only the flags that change the layout
+    TextBox::TextFlags layout_flags;
+    if (flags.is_set(TextBox::TextFlag::multiline))
+        layout_flags.set(TextBox::TextFlag::multiline);
+    if (flags.is_set(TextBox::TextFlag::word_wrap))
+        layout_flags.set(TextBox::TextFlag::word_wrap);
+
+    // a font with the same properties may still be another font in memory
+    if (m_valid &&
+        m_size == size &&
+        m_justify == justify &&
+        m_flags == layout_flags &&
+        m_text_align == text_align &&
+        m_image_size == image_size &&
+        (image_size.empty() || m_image_align == image_align) &&
+        m_font == font &&
+        m_font.scaled_font() == font.scaled_font() &&
+        m_text == text)
+        return false;
+
+    m_text = text;
+    m_font = font;
+    m_size = size;
+    m_flags = layout_flags;
+    m_text_align = text_align;
+    m_justify = justify;
+    m_image_align = image_align;
+    m_image_size = image_size;
+    m_glyphs.clear();
+    m_code_points.clear();
+    m_image_point = {};
+    m_valid = true;
+    ++m_layouts;
+
+    auto cr = painter.context().get();
+
+    painter.set(font);
+    cairo_font_extents_t fe;
+    cairo_font_extents(cr, &fe);
+    m_line_height = fe.height;
+
+    std::vector<detail::LayoutRect> rects;
+
+    draw_text_setup(rects,
+                    cr,
+                    fe,
+                    text,
+                    flags);
+
+    if (!image_size.empty())
+    {
+        if (image_align.is_set(AlignFlag::top))
+        {
+            detail::LayoutRect r(LAY_BREAK, Rect(0, 0, 1, fe.height), "\n");
+            rects.insert(rects.begin(), r);
+
+            detail::LayoutRect r2(0, Rect(Point(), image_size));
+            rects.insert(rects.begin(), r2);
+        }
+        else if (image_align.is_set(AlignFlag::right))
+        {
+            rects.emplace_back(0, Rect(Point(), image_size));
+        }
+        else if (image_align.is_set(AlignFlag::bottom))
+        {
+            rects.emplace_back(LAY_BREAK, Rect(0, 0, 1, fe.height), "\n");
+            rects.emplace_back(0, Rect(Point(), image_size));
+        }
+        else
+        {
+            detail::LayoutRect r(0, Rect(Point(), image_size));
+            rects.insert(rects.begin(), r);
+        }
+    }
+
+    detail::flex_layout(Rect(size), rects, justify, Orientation::flex, text_align);
+
+    auto scaled_font = cairo_get_scaled_font(cr);
+    auto& glyphs = GlyphCache::get(scaled_font);
+    std::string last_char;
+    for (const auto& r : rects)
+    {
+        if (r.str.empty())
+        {
+            m_image_point = r.rect.point();
+            continue;
+        }
+
+        float roff = 0.;
+        for (utf8_const_iterator ch(r.str.begin(), r.str.begin(), r.str.end());
+             ch != utf8_const_iterator(r.str.end(), r.str.begin(), r.str.end()); ++ch)
+        {
+            last_char = utf8_char_to_string(ch.base(), r.str.cend());
+
+            CodePoint code_point{fl(r.rect.x()) + roff, fl(r.rect.y()), 0,
+                                 fl(r.rect.height())};
+
+            if (*ch != '\n')
+            {
+                code_point.width = glyphs.advance(*ch);
+
+                // the origin of the code point is on the baseline
+                cairo_glyph_t* glyphs = nullptr;
+                int count = 0;
+                if (cairo_scaled_font_text_to_glyphs(scaled_font,
+                                                     code_point.x,
+                                                     code_point.y - fe.descent + fe.height,
+                                                     last_char.data(), last_char.size(),
+                                                     &glyphs, &count,
+                                                     nullptr, nullptr, nullptr) == CAIRO_STATUS_SUCCESS)
+                {
+                    m_glyphs.insert(m_glyphs.end(), glyphs, glyphs + count);
+                }
+                cairo_glyph_free(glyphs);
+
+                roff += code_point.width;
+            }
+            else
+            {
+                if (!m_flags.is_set(TextBox::TextFlag::multiline))
+                    break;
+            }
+
+            m_code_points.push_back(code_point);
+        }
+    }
+
+    // cursor after the last code point
+    m_end = {};
+    if (!rects.empty())
+    {
+        m_end = rects.back().rect.point() + Point(rects.back().rect.width(), 0);
+        if (last_char == "\n")
+        {
+            m_end.x(0);
+            m_end.y(m_end.y() + fe.height);
+        }
+    }
+
+    return true;
+}
+
+void TextLayout::draw(Painter& painter,
+                      const Point& point,
+                      const Pattern& text_color,
+                      const Image* image,
+                      const std::function<void(const Point& offset, size_t height)>& draw_cursor,
+                      size_t cursor_pos,
+                      const Pattern* highlight_color,
+                      size_t select_start,
+                      size_t select_len) const
+{
+    auto cr = painter.context().get();
+
+    if (image && !image->empty() && !m_image_size.empty())
+    {
+        painter.draw(point + m_image_point);
+        painter.draw(*image);
+    }
+
+    if (highlight_color && select_len)
+    {
+        const auto end = std::min(select_start + select_len, m_code_points.size());
+        for (auto pos = select_start; pos < end; ++pos)
+        {
+            const auto& code_point = m_code_points[pos];
+            auto rect = RectF(fl(point.x()) + code_point.x,
+                              fl(point.y()) + code_point.y,
+                              code_point.width, code_point.height);
+            if (!rect.empty())
+            {
+                painter.set(*highlight_color);
+                painter.draw(rect);
+                painter.fill();
+            }
+        }
+    }
+
+    painter.set(m_font);
+    painter.set(text_color);
+
+    if (!m_glyphs.empty())
+    {
+        Painter::AutoSaveRestore sr(painter);
+
+        // the glyphs are relative to the box
+        cairo_translate(cr, point.x(), point.y());
+        detail::show_glyphs(cr, m_glyphs.data(), m_glyphs.size());
+    }
+
+    if (!draw_cursor)
+        return;
+
+    if (cursor_pos < m_code_points.size())
+    {
+        const auto& code_point = m_code_points[cursor_pos];
+        draw_cursor(Point(point.x() + code_point.x, point.y() + code_point.y),
+                    m_line_height);
+    }
+    else if (cursor_pos == m_code_points.size())
+    {
+        draw_cursor(point + m_end, m_line_height);
+    }
+}
+
+void TextLayout::clear()
+{
+    m_valid = false;
+    m_text.clear();
+    m_glyphs.clear();
+    m_code_points.clear();
+}
+
+}
+}
+}
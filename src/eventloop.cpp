@@ -8,12 +8,17 @@
 #include "detail/priorityqueue.h"
 #include "egt/app.h"
 #include "egt/eventloop.h"
+#include "egt/frameclock.h"
+#include "egt/screen.h"
 #include "egt/tools.h"
 #include "egt/widget.h"
 #include "egt/window.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <egt/asio.hpp>
 #include <numeric>
+#include <thread>
 
 namespace egt
 {
@@ -25,13 +30,73 @@ struct EventLoop::EventLoopImpl
     asio::io_context m_io;
     asio::executor_work_guard<asio::io_context::executor_type> m_work{egt::asio::make_work_guard(m_io)};
     detail::PriorityQueue m_queue;
+    FrameClock m_clock{m_io};
+    experimental::FramesPerSecond m_fps;
+    /// Created on first use by async_work().
+    std::unique_ptr<asio::thread_pool> m_workers;
 };
 
+static inline bool show_fps_enabled()
+{
+    static int value = 0;
+    if (value == 0)
+    {
+        if (std::getenv("EGT_SHOW_FPS"))
+            value += 1;
+        else
+            value -= 1;
+    }
+    return value == 1;
+}
+
+static std::chrono::microseconds frame_interval()
+{
+    static long rate = 0;
+    if (rate == 0)
+    {
+        rate = 60;
+        const auto* value = std::getenv("EGT_FRAME_RATE");
+        if (value && strlen(value))
+        {
+            const auto r = std::strtol(value, nullptr, 10);
+            if (r > 0 && r <= 1000)
+                rate = r;
+            else
+                detail::warn("invalid EGT_FRAME_RATE: {}", value);
+        }
+    }
+    return std::chrono::microseconds(1000000 / rate);
+}
+
 EventLoop::EventLoop(const Application& app) noexcept
     : m_impl(std::make_unique<EventLoopImpl>()),
       m_app(app)
 {
     m_exit_value = -1;
+
+    m_impl->m_clock.interval(frame_interval());
+
+    // align frames to buffer flips when the screen knows about them
+    m_impl->m_clock.presentation_source([this]()
+    {
+        if (m_app.screen())
+            return m_app.screen()->presentation_time();
+        return FrameClock::clock::time_point();
+    });
+
+    m_impl->m_clock.on_frame([this](FrameClock::clock::time_point)
+    {
+        // draw anything that's changed
+        draw();
+
+        if (show_fps_enabled())
+        {
+            m_impl->m_fps.end_frame();
+
+            if (m_impl->m_fps.ready())
+                fmt::print("fps: {}\n", std::round(m_impl->m_fps.fps()));
+        }
+    }, FrameClock::Phase::paint);
 }
 
 asio::io_context& EventLoop::io()
@@ -39,6 +104,11 @@ asio::io_context& EventLoop::io()
     return m_impl->m_io;
 }
 
+FrameClock& EventLoop::frame_clock()
+{
+    return m_impl->m_clock;
+}
+
 static inline bool time_event_loop_enabled()
 {
     static int value = 0;
@@ -133,23 +203,8 @@ int EventLoop::step()
     return ret;
 }
 
-static inline bool show_fps_enabled()
-{
-    static int value = 0;
-    if (value == 0)
-    {
-        if (std::getenv("EGT_SHOW_FPS"))
-            value += 1;
-        else
-            value -= 1;
-    }
-    return value == 1;
-}
-
 int EventLoop::run()
 {
-    experimental::FramesPerSecond fps;
-
     // initial draw
     draw();
 
@@ -157,20 +212,8 @@ int EventLoop::run()
     m_impl->m_io.restart();
     while (!m_do_quit)
     {
-        // process events
-        if (wait())
-        {
-            // draw anything that's changed
-            draw();
-
-            if (show_fps_enabled())
-            {
-                fps.end_frame();
-
-                if (fps.ready())
-                    fmt::print("fps: {}\n", std::round(fps.fps()));
-            }
-        }
+        // process events, anything damaged is drawn by the frame clock
+        wait();
     }
 
     EGTLOG_TRACE("EventLoop::run() exiting");
@@ -189,12 +232,41 @@ void EventLoop::invoke_idle_callbacks()
         i();
 }
 
+void EventLoop::async_work(std::function<bool ()> work, std::function<void ()> done)
+{
+    /*
+     * Work is mostly limited by storage and memory bandwidth, like decoding
+     * images, so a couple of threads are enough.
+     */
+    if (!m_impl->m_workers)
+    {
+        m_impl->m_workers = std::make_unique<asio::thread_pool>(
+                                std::max(1U, std::min(2U, std::thread::hardware_concurrency())));
+    }
+
+    // the workers are joined before m_io is destroyed
+    asio::post(*m_impl->m_workers, [&io = m_impl->m_io, work = std::move(work),
+                                    done = std::move(done)]() mutable
+    {
+        if (work() && done)
+            asio::post(io, std::move(done));
+    });
+}
+
 detail::PriorityQueue& EventLoop::queue()
 {
     return m_impl->m_queue;
 }
 
-EventLoop::~EventLoop() noexcept = default;
+EventLoop::~EventLoop() noexcept
+{
+    // workers post to m_io, so they must be done before it goes away
+    if (m_impl->m_workers)
+    {
+        m_impl->m_workers->stop();
+        m_impl->m_workers->join();
+    }
+}
 
 }
 }
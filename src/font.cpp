@@ -9,15 +9,17 @@
 
 #include "detail/egtlog.h"
 #include "egt/app.h"
-#include "egt/canvas.h"
 #include "egt/detail/enum.h"
+#include "egt/detail/glyphcache.h"
 #include "egt/font.h"
 #include "egt/respath.h"
 #include "egt/screen.h"
 #include "egt/serialize.h"
 #include <cairo-ft.h>
-#include <map>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <unordered_map>
 
 namespace egt
 {
@@ -67,46 +69,27 @@ static void ft_done_face_uncached(void* closure)
     FT_Done_Face(face);
 }
 
-static shared_cairo_scaled_font_t create_ft_font(cairo_t* cr,
-        FT_Face& face,
-        const Font& font)
+using shared_cairo_font_face_t = std::shared_ptr<cairo_font_face_t>;
+
+static shared_cairo_font_face_t create_ft_font_face(FT_Face face)
 {
-    std::unique_ptr<cairo_font_face_t, decltype(cairo_font_face_destroy)*>
-    font_face(cairo_ft_font_face_create_for_ft_face(face, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP),
-              cairo_font_face_destroy);
+    shared_cairo_font_face_t font_face(cairo_ft_font_face_create_for_ft_face(face, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP),
+                                       cairo_font_face_destroy);
 
+    // the FreeType face is released with the last scaled font using it
     static const cairo_user_data_key_t key{};
     if (cairo_font_face_set_user_data(font_face.get(), &key, face, ft_done_face_uncached))
+    {
+        FT_Done_Face(face);
         return nullptr;
+    }
 
-    std::unique_ptr<cairo_font_options_t, decltype(cairo_font_options_destroy)*>
-    font_options(cairo_font_options_create(), cairo_font_options_destroy);
-    cairo_get_font_options(cr, font_options.get());
-    cairo_font_options_set_hint_style(font_options.get(), CAIRO_HINT_STYLE_NONE);
-    cairo_font_options_set_hint_metrics(font_options.get(), CAIRO_HINT_METRICS_OFF);
-
-    cairo_matrix_t size_matrix{};
-    cairo_matrix_t identity_matrix{};
-    cairo_matrix_init_scale(&size_matrix, font.size(), font.size());
-    cairo_matrix_init_identity(&identity_matrix);
-
-    shared_cairo_scaled_font_t scaled_font(cairo_scaled_font_create(font_face.get(),
-                                           &size_matrix,
-                                           &identity_matrix,
-                                           font_options.get()),
-                                           cairo_scaled_font_destroy);
-
-    if (!scaled_font || cairo_scaled_font_status(scaled_font.get()))
-        return nullptr;
-
-    return scaled_font;
+    return font_face;
 }
 
-static shared_cairo_scaled_font_t create_ft_scaled_font(cairo_t* cr,
-        const char* path,
-        const Font& font)
+static shared_cairo_font_face_t create_ft_font_face(const char* path)
 {
-    EGTLOG_DEBUG("allocating font using FreeType: {}", font.face());
+    EGTLOG_DEBUG("opening font using FreeType: {}", path);
 
     if (!init_freetype())
         return nullptr;
@@ -119,14 +102,12 @@ static shared_cairo_scaled_font_t create_ft_scaled_font(cairo_t* cr,
         return nullptr;
     }
 
-    return create_ft_font(cr, face, font);
+    return create_ft_font_face(face);
 }
 
-static shared_cairo_scaled_font_t create_ft_scaled_font(cairo_t* cr,
-        const unsigned char* data,
-        size_t len, const Font& font)
+static shared_cairo_font_face_t create_ft_font_face(const unsigned char* data, size_t len)
 {
-    EGTLOG_DEBUG("allocating memory font using FreeType: {}", font.face());
+    EGTLOG_DEBUG("opening memory font using FreeType");
 
     if (!init_freetype())
         return nullptr;
@@ -137,17 +118,52 @@ static shared_cairo_scaled_font_t create_ft_scaled_font(cairo_t* cr,
     if (status)
         return nullptr;
 
-    return create_ft_font(cr, face, font);
+    return create_ft_font_face(face);
+}
+
+static shared_cairo_scaled_font_t create_scaled_font(cairo_font_face_t* font_face,
+        double size,
+        const cairo_font_options_t* font_options)
+{
+    cairo_matrix_t size_matrix{};
+    cairo_matrix_t identity_matrix{};
+    cairo_matrix_init_scale(&size_matrix, size, size);
+    cairo_matrix_init_identity(&identity_matrix);
+
+    shared_cairo_scaled_font_t scaled_font(cairo_scaled_font_create(font_face,
+                                           &size_matrix,
+                                           &identity_matrix,
+                                           font_options),
+                                           cairo_scaled_font_destroy);
+
+    if (!scaled_font || cairo_scaled_font_status(scaled_font.get()))
+        return nullptr;
+
+    return scaled_font;
+}
+
+static shared_cairo_scaled_font_t create_ft_scaled_font(cairo_font_face_t* font_face,
+        const Font& font)
+{
+    std::unique_ptr<cairo_font_options_t, decltype(cairo_font_options_destroy)*>
+    font_options(cairo_font_options_create(), cairo_font_options_destroy);
+    cairo_font_options_set_hint_style(font_options.get(), CAIRO_HINT_STYLE_NONE);
+    cairo_font_options_set_hint_metrics(font_options.get(), CAIRO_HINT_METRICS_OFF);
+
+    return create_scaled_font(font_face, font.size(), font_options.get());
 }
 
 #ifdef HAVE_FONTCONFIG
-static shared_cairo_scaled_font_t create_scaled_font(cairo_t* cr, const Font& font)
+/*
+ * Resolve the face of a font with Fontconfig.  Sizes only scale the face, so
+ * the pixel size is returned as a ratio of the size of the font.
+ */
+static shared_cairo_font_face_t create_fc_font_face(const Font& font, double& scale)
 {
-    EGTLOG_DEBUG("allocating font using Fontconfig: {}", font.face());
+    EGTLOG_DEBUG("resolving font using Fontconfig: {}", font.face());
 
     std::unique_ptr<cairo_font_options_t, decltype(cairo_font_options_destroy)*>
     font_options(cairo_font_options_create(), cairo_font_options_destroy);
-    cairo_get_font_options(cr, font_options.get());
 
     std::unique_ptr<FcPattern, decltype(FcPatternDestroy)*>
     pattern(FcPatternCreate(), FcPatternDestroy);
@@ -200,31 +216,16 @@ static shared_cairo_scaled_font_t create_scaled_font(cairo_t* cr, const Font& fo
             EGTLOG_DEBUG("Font \"{}\" not found: using default {} font", font.face(), face);
     }
 
-    double pixel_size;
+    double pixel_size = font.size();
     FcPatternGetDouble(resolved.get(), FC_PIXEL_SIZE, 0, &pixel_size);
+    scale = font.size() > 0 ? pixel_size / font.size() : 1.;
 
-    std::unique_ptr<cairo_font_face_t, decltype(cairo_font_face_destroy)*>
-    font_face(cairo_ft_font_face_create_for_pattern(resolved.get()),
-              cairo_font_face_destroy);
-
-    cairo_matrix_t font_matrix;
-    cairo_matrix_init_identity(&font_matrix);
-
-    cairo_matrix_scale(&font_matrix, pixel_size, pixel_size);
-    cairo_matrix_t ctm;
-    cairo_get_matrix(cr, &ctm);
-
-    shared_cairo_scaled_font_t scaled_font(cairo_scaled_font_create(font_face.get(),
-                                           &font_matrix,
-                                           &ctm,
-                                           font_options.get()),
-                                           cairo_scaled_font_destroy);
-
-    cairo_status_t status = cairo_scaled_font_status(scaled_font.get());
-    if (status)
+    shared_cairo_font_face_t font_face(cairo_ft_font_face_create_for_pattern(resolved.get()),
+                                       cairo_font_face_destroy);
+    if (cairo_font_face_status(font_face.get()))
         return nullptr;
 
-    return scaled_font;
+    return font_face;
 }
 #endif
 
@@ -339,51 +340,102 @@ void Font::deserialize(const std::string& name, const std::string& value,
     }
 }
 
+/*
+ * Scaled fonts by face, size, weight and slant.
+ *
+ * Font faces are kept apart from scaled fonts, so that the scaled fonts of
+ * all the sizes of a font share one face: one FT_Face per font file, and one
+ * Fontconfig match per face name, weight and slant.  In-memory fonts are not
+ * cached here, their face lives with the Font.
+ */
 struct FontCache : private detail::NonCopyable<FontCache>
 {
-    struct FontCompare
+    struct Key
     {
-        bool operator()(const Font& lhs, const Font& rhs) const
+        /// Face name, or path, of the font.
+        std::string face;
+        /// Bit pattern of the size, 0 for the keys of faces.
+        uint32_t size;
+        Font::Weight weight;
+        Font::Slant slant;
+
+        bool operator==(const Key& rhs) const
         {
-            if (lhs.face() != rhs.face())
-                return lhs.face() < rhs.face();
-            if (!detail::float_equal(lhs.size(), rhs.size()))
-                return lhs.size() < rhs.size();
-            if (lhs.weight() != rhs.weight())
-                return lhs.weight() < rhs.weight();
-            return lhs.slant() < rhs.slant();
+            return size == rhs.size &&
+                   weight == rhs.weight && slant == rhs.slant &&
+                   face == rhs.face;
         }
     };
 
-    std::map<Font, shared_cairo_scaled_font_t, FontCompare> cache;
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const noexcept
+        {
+            auto h = std::hash<std::string>()(key.face);
+            h ^= (static_cast<size_t>(key.size) + 0x9e3779b9 + (h << 6) + (h >> 2));
+            h ^= (static_cast<size_t>(key.weight) + 0x9e3779b9 + (h << 6) + (h >> 2));
+            h ^= (static_cast<size_t>(key.slant) + 0x9e3779b9 + (h << 6) + (h >> 2));
+            return h;
+        }
+    };
 
-    shared_cairo_scaled_font_t scaled_font(const Font& font)
+    /// A font face, with the ratio of its pixel size to the size of fonts.
+    struct Face
     {
-        auto i = cache.find(font);
-        if (i != cache.end())
-            return i->second;
+        shared_cairo_font_face_t face;
+        double scale{1.};
+        /// Resolved by Fontconfig, which also chooses the font options.
+        bool fontconfig{false};
+    };
 
-        EGTLOG_TRACE("creating scaled font {}", font);
+    static Key key(const Font& font, bool with_size)
+    {
+        uint32_t size = 0;
+        if (with_size)
+        {
+            static_assert(sizeof(size) == sizeof(Font::Size), "font size is not a float");
+            Font::Size s = font.size();
+            std::memcpy(&size, &s, sizeof(size));
+        }
 
-        Canvas canvas(Size(100, 100));
-        auto cr = canvas.context();
+        return {font.face(), size, font.weight(), font.slant()};
+    }
 
-        shared_cairo_scaled_font_t scaled_font;
+    std::unordered_map<Key, shared_cairo_scaled_font_t, KeyHash> cache;
+    std::unordered_map<Key, Face, KeyHash> faces;
+
+    Face face(const Font& font)
+    {
+        auto k = key(font, false);
 
         std::string path;
         auto type = detail::resolve_path(font.face(), path);
 
+        // weight and slant are in the file, they need no other face
+        if (type == detail::SchemeType::filesystem)
+        {
+            k.face = path;
+            k.weight = Font::DEFAULT_WEIGHT;
+            k.slant = Font::DEFAULT_SLANT;
+        }
+
+        auto i = faces.find(k);
+        if (i != faces.end())
+            return i->second;
+
+        Face result;
         switch (type)
         {
         case detail::SchemeType::filesystem:
         {
-            scaled_font = create_ft_scaled_font(cr.get(), path.c_str(), font);
+            result.face = create_ft_font_face(path.c_str());
             break;
         }
         case detail::SchemeType::unknown:
 #ifdef HAVE_FONTCONFIG
         {
-            scaled_font = create_scaled_font(cr.get(), font);
+            result.face = create_fc_font_face(font, result.scale);
+            result.fontconfig = true;
             break;
         }
 #endif
@@ -393,8 +445,39 @@ struct FontCache : private detail::NonCopyable<FontCache>
             throw std::runtime_error("unable to load font uri: " + font.face());
         }
 
+        if (result.face)
+            faces.emplace(std::move(k), result);
+        return result;
+    }
+
+    shared_cairo_scaled_font_t scaled_font(const Font& font)
+    {
+        auto k = key(font, true);
+        auto i = cache.find(k);
+        if (i != cache.end())
+            return i->second;
+
+        EGTLOG_TRACE("creating scaled font {}", font);
+
+        auto f = face(font);
+        if (!f.face)
+            return nullptr;
+
+        shared_cairo_scaled_font_t scaled_font;
+        if (f.fontconfig)
+        {
+            std::unique_ptr<cairo_font_options_t, decltype(cairo_font_options_destroy)*>
+            font_options(cairo_font_options_create(), cairo_font_options_destroy);
+            scaled_font = create_scaled_font(f.face.get(), font.size() * f.scale,
+                                             font_options.get());
+        }
+        else
+        {
+            scaled_font = create_ft_scaled_font(f.face.get(), font);
+        }
+
         if (scaled_font)
-            cache.insert(std::make_pair(font, scaled_font));
+            cache.emplace(std::move(k), scaled_font);
         return scaled_font;
     }
 };
@@ -405,9 +488,11 @@ cairo_scaled_font_t* Font::scaled_font() const
 {
     if (m_data && m_len && !m_scaled_font)
     {
-        Canvas canvas(egt::Size(100, 100));
-        auto cr = canvas.context().get();
-        m_scaled_font = create_ft_scaled_font(cr, m_data, m_len, *this);
+        // the face is shared by copies of the font, and by all its sizes
+        if (!m_font_face)
+            m_font_face = create_ft_font_face(m_data, m_len);
+        if (m_font_face)
+            m_scaled_font = create_ft_scaled_font(m_font_face.get(), *this);
     }
 
     if (m_scaled_font)
@@ -416,6 +501,33 @@ cairo_scaled_font_t* Font::scaled_font() const
     return font_cache.scaled_font(*this).get();
 }
 
+void Font::preload(const std::vector<Font>& fonts)
+{
+    for (const auto& font : fonts)
+    {
+        cairo_scaled_font_t* scaled_font = nullptr;
+        try
+        {
+            scaled_font = font.scaled_font();
+        }
+        catch (const std::runtime_error& e)
+        {
+            detail::warn("{}", e.what());
+        }
+
+        if (!scaled_font)
+        {
+            detail::warn("unable to preload font {}", font.face());
+            continue;
+        }
+
+        // load the glyphs of printable ASCII, which most text starts with
+        auto& glyphs = detail::GlyphCache::get(scaled_font);
+        for (uint32_t c = 0x20; c < 0x7f; ++c)
+            glyphs.extents(c);
+    }
+}
+
 std::ostream& operator<<(std::ostream& os, const Font& font)
 {
     os << font.face() << ", " << font.size() << ", " <<
@@ -426,6 +538,7 @@ std::ostream& operator<<(std::ostream& os, const Font& font)
 void Font::reset_font_cache()
 {
     font_cache.cache.clear();
+    font_cache.faces.clear();
 }
 
 void Font::shutdown_fonts()
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "detail/asioallocator.h"
+#include "egt/frameclock.h"
+#include <algorithm>
+#include <egt/asio.hpp>
+#include <iterator>
+
+namespace egt
+{
+inline namespace v1
+{
+
+struct FrameClock::FrameClockImpl
+{
+    explicit FrameClockImpl(asio::io_context& io)
+        : timer(io)
+    {}
+
+    asio::steady_timer timer;
+    detail::HandlerAllocator allocator;
+    /// Target time the timer is armed for.
+    clock::time_point target;
+    /// When the last frame was dispatched.
+    clock::time_point last;
+};
+
+FrameClock::FrameClock(asio::io_context& io, std::chrono::microseconds interval)
+    : m_impl(std::make_unique<FrameClockImpl>(io)),
+      m_interval(interval)
+{}
+
+void FrameClock::request_frame()
+{
+    if (m_dispatching)
+    {
+        m_requested = true;
+        return;
+    }
+
+    if (m_pending)
+        return;
+
+    m_pending = true;
+    m_impl->target = next_frame_time(clock::now());
+    m_impl->timer.expires_at(m_impl->target);
+    m_impl->timer.async_wait(detail::make_custom_alloc_handler(m_impl->allocator,
+                             [this](const asio::error_code & error)
+    {
+        if (error || !m_pending)
+            return;
+
+        m_pending = false;
+
+        const auto now = clock::now();
+        if (now > m_impl->target + m_interval)
+            m_stats.missed += (now - m_impl->target) / m_interval;
+
+        run_frame(m_impl->target);
+    }));
+}
+
+FrameClock::clock::time_point FrameClock::next_frame_time(clock::time_point now) const
+{
+    clock::time_point base;
+    if (m_presentation)
+        base = m_presentation();
+
+    if (base == clock::time_point())
+    {
+        // nothing was drawn for a full period, so there is no reason to wait
+        if (m_frame_time == clock::time_point() || now >= m_frame_time + m_interval)
+            return now;
+        base = m_frame_time;
+    }
+
+    auto next = base;
+    if (now > base)
+    {
+        const auto periods = (now - base + m_interval - std::chrono::nanoseconds(1)) / m_interval;
+        next = base + periods * m_interval;
+    }
+
+    // never dispatch twice in the same refresh period
+    while (next < m_frame_time + m_interval)
+        next += m_interval;
+
+    return next;
+}
+
+void FrameClock::dispatch()
+{
+    run_frame(clock::now());
+}
+
+void FrameClock::run_frame(clock::time_point time)
+{
+    const auto start = clock::now();
+
+    if (m_impl->last != clock::time_point())
+    {
+        m_stats.interval = std::chrono::duration_cast<std::chrono::microseconds>(start - m_impl->last);
+        m_stats.max_interval = std::max(m_stats.max_interval, m_stats.interval);
+    }
+    m_impl->last = start;
+    m_frame_time = time;
+
+    invoke_handlers(Phase::update);
+    invoke_handlers(Phase::paint);
+
+    m_stats.dispatch = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+    ++m_stats.frames;
+
+    // requests made by the callbacks are for the frame after this one
+    if (m_requested)
+    {
+        m_requested = false;
+        request_frame();
+    }
+}
+
+FrameClock::RegisterHandle FrameClock::on_frame(FrameCallback callback, Phase phase)
+{
+    if (!callback)
+        return 0;
+
+    auto handle = ++m_handle_counter;
+    if (m_dispatching)
+        m_added.emplace_back(std::move(callback), phase, handle);
+    else
+        m_callbacks.emplace_back(std::move(callback), phase, handle);
+    return handle;
+}
+
+void FrameClock::remove_handler(RegisterHandle handle)
+{
+    if (!handle)
+        return;
+
+    auto match = [handle](const CallbackMeta & meta)
+    {
+        return meta.handle == handle;
+    };
+
+    m_added.erase(std::remove_if(m_added.begin(), m_added.end(), match), m_added.end());
+
+    auto i = std::find_if(m_callbacks.begin(), m_callbacks.end(), match);
+    if (i == m_callbacks.end())
+        return;
+
+    // the callback may be the one running, so only mark it while dispatching
+    if (m_dispatching)
+        i->handle = 0;
+    else
+        m_callbacks.erase(i);
+}
+
+void FrameClock::invoke_handlers(Phase phase)
+{
+    m_dispatching = true;
+    m_phase = phase;
+
+    for (auto& meta : m_callbacks)
+    {
+        if (meta.handle && meta.phase == phase)
+            meta.callback(m_frame_time);
+    }
+
+    m_dispatching = false;
+
+    m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(),
+                                     [](const CallbackMeta & meta) { return !meta.handle; }),
+                      m_callbacks.end());
+
+    if (!m_added.empty())
+    {
+        std::move(m_added.begin(), m_added.end(), std::back_inserter(m_callbacks));
+        m_added.clear();
+    }
+}
+
+void FrameClock::interval(std::chrono::microseconds interval)
+{
+    if (interval.count() > 0)
+        m_interval = interval;
+}
+
+void FrameClock::presentation_source(PresentationSource source)
+{
+    m_presentation = std::move(source);
+}
+
+FrameClock::~FrameClock() noexcept
+{
+    m_pending = false;
+    m_impl->timer.cancel();
+}
+
+}
+}
@@ -0,0 +1,614 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "detail/egtlog.h"
+#include "detail/erawimage.h"
+#include "egt/detail/math.h"
+#include "egt/glyphatlas.h"
+#include "egt/imageatlas.h"
+#include "egt/painter.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utf8.h>
+#include <vector>
+
+namespace egt
+{
+inline namespace v1
+{
+
+/// Maximum width of an atlas rendered at runtime.
+static constexpr DefaultDim MAX_ATLAS_WIDTH = 1024;
+
+/// A8 glyphs start on 32 bit boundaries, so they can share the atlas pixels.
+static constexpr DefaultDim align4(DefaultDim x)
+{
+    return (x + 3) & ~3;
+}
+
+static std::string utf8_code_point(uint32_t code_point)
+{
+    std::string result;
+    utf8::append(code_point, std::back_inserter(result));
+    return result;
+}
+
+/*
+ * Get the index of the glyph of a code point, or false if it does not map to
+ * exactly one glyph.
+ */
+static bool glyph_index(cairo_scaled_font_t* scaled_font, uint32_t code_point,
+                        unsigned long& index)
+{
+    const auto text = utf8_code_point(code_point);
+    cairo_glyph_t* glyphs = nullptr;
+    int count = 0;
+    const auto status = cairo_scaled_font_text_to_glyphs(scaled_font, 0, 0,
+                        text.data(), text.size(),
+                        &glyphs, &count,
+                        nullptr, nullptr, nullptr);
+    const auto found = status == CAIRO_STATUS_SUCCESS && count == 1;
+    if (found)
+        index = glyphs[0].index;
+    cairo_glyph_free(glyphs);
+    return found;
+}
+
+const std::string& GlyphAtlas::default_characters()
+{
+    static const std::string characters = []()
+    {
+        std::string result;
+        for (uint32_t c = 0x20; c < 0x7f; ++c)
+            result += utf8_code_point(c);
+        for (uint32_t c = 0xa0; c <= 0xff; ++c)
+            result += utf8_code_point(c);
+        return result;
+    }();
+
+    return characters;
+}
+
+GlyphAtlas::GlyphAtlas(const Font& font, const std::string& characters)
+    : m_font(font)
+{
+    init_font();
+
+    /*
+     * Glyphs are measured and rendered with the options cairo uses for image
+     * surfaces, so they are the ones cairo would draw.
+     */
+    shared_cairo_surface_t scratch(cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1),
+                                   cairo_surface_destroy);
+    auto cr = context(scratch.get());
+    auto scaled_font = cairo_get_scaled_font(cr.get());
+
+    struct Entry
+    {
+        unsigned long index;
+        uint32_t code_point;
+        Rect rect;
+        Point offset;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_set<unsigned long> indexes;
+    DefaultDim widest = 0;
+    double area = 0;
+
+    auto i = characters.begin();
+    while (i != characters.end())
+    {
+        uint32_t code_point;
+        try
+        {
+            code_point = utf8::next(i, characters.end());
+        }
+        catch (const utf8::exception&)
+        {
+            throw std::runtime_error("invalid UTF-8 in glyph atlas characters");
+        }
+
+        unsigned long index;
+        if (!glyph_index(scaled_font, code_point, index) ||
+            !indexes.insert(index).second)
+            continue;
+
+        Entry entry{index, code_point, {}, {}};
+
+        cairo_glyph_t glyph{index, 0, 0};
+        cairo_text_extents_t te;
+        cairo_scaled_font_glyph_extents(scaled_font, &glyph, 1, &te);
+        if (te.width > 0 && te.height > 0)
+        {
+            // a pixel of margin around the ink, for antialiasing
+            const auto x0 = static_cast<DefaultDim>(std::floor(te.x_bearing)) - 1;
+            const auto y0 = static_cast<DefaultDim>(std::floor(te.y_bearing)) - 1;
+            const auto x1 = static_cast<DefaultDim>(std::ceil(te.x_bearing + te.width)) + 1;
+            const auto y1 = static_cast<DefaultDim>(std::ceil(te.y_bearing + te.height)) + 1;
+            entry.offset = Point(x0, y0);
+            entry.rect.size(Size(x1 - x0, y1 - y0));
+            widest = std::max(widest, align4(entry.rect.width()));
+            area += align4(entry.rect.width()) * entry.rect.height();
+        }
+
+        entries.push_back(entry);
+    }
+
+    // glyphs are placed on shelves, tallest first
+    std::vector<Entry*> order;
+    for (auto& entry : entries)
+        if (!entry.rect.empty())
+            order.push_back(&entry);
+
+    std::stable_sort(order.begin(), order.end(), [](const Entry * a, const Entry * b)
+    {
+        return a->rect.height() > b->rect.height();
+    });
+
+    const auto width = std::max(widest,
+                                std::min(MAX_ATLAS_WIDTH,
+                                         align4(static_cast<DefaultDim>(std::ceil(std::sqrt(area))))));
+    DefaultDim x = 0;
+    DefaultDim y = 0;
+    DefaultDim shelf = 0;
+    for (auto entry : order)
+    {
+        if (x + entry->rect.width() > width)
+        {
+            y += shelf;
+            x = 0;
+            shelf = 0;
+        }
+
+        entry->rect.point(Point(x, y));
+        x = align4(x + entry->rect.width());
+        shelf = std::max(shelf, entry->rect.height());
+    }
+
+    shared_cairo_surface_t atlas(cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                 std::max<DefaultDim>(width, 1),
+                                 std::max<DefaultDim>(y + shelf, 1)),
+                                 cairo_surface_destroy);
+    if (cairo_surface_status(atlas.get()) != CAIRO_STATUS_SUCCESS)
+        throw std::runtime_error("unable to create glyph atlas");
+
+    auto acr = context(atlas.get());
+    for (auto entry : order)
+    {
+        cairo_glyph_t glyph{entry->index,
+                            static_cast<double>(entry->rect.x() - entry->offset.x()),
+                            static_cast<double>(entry->rect.y() - entry->offset.y())};
+        cairo_show_glyphs(acr.get(), &glyph, 1);
+    }
+    cairo_surface_flush(atlas.get());
+
+    m_atlas = Image(atlas);
+
+    for (const auto& entry : entries)
+        add(entry.index, entry.code_point, entry.rect, entry.offset);
+
+    EGTLOG_DEBUG("rendered glyph atlas of {} glyphs in {}x{}", size(),
+                 m_atlas.width(), m_atlas.height());
+}
+
+GlyphAtlas::GlyphAtlas(const Font& font, const std::string& uri, const std::string& index)
+    : m_font(font)
+{
+    init_font();
+
+    const auto text = detail::read_atlas_index(index);
+
+    auto surface = Image(uri).surface();
+    if (!surface)
+        throw std::runtime_error("unable to load glyph atlas: " + uri);
+
+    if (cairo_image_surface_get_format(surface.get()) != CAIRO_FORMAT_A8)
+    {
+        // only the alpha channel of other images is used
+        shared_cairo_surface_t a8(cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                  cairo_image_surface_get_width(surface.get()),
+                                  cairo_image_surface_get_height(surface.get())),
+                                  cairo_surface_destroy);
+        auto cr = shared_cairo_t(cairo_create(a8.get()), cairo_destroy);
+        cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr.get(), surface.get(), 0, 0);
+        cairo_paint(cr.get());
+        cairo_surface_flush(a8.get());
+        surface = a8;
+    }
+    else
+    {
+        // the pixels of the atlas are read directly when drawing
+        cairo_surface_flush(surface.get());
+    }
+
+    m_atlas = Image(surface);
+
+    shared_cairo_surface_t scratch(cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1),
+                                   cairo_surface_destroy);
+    auto cr = context(scratch.get());
+    auto scaled_font = cairo_get_scaled_font(cr.get());
+
+    const auto atlas_size = m_atlas.size();
+    std::istringstream in(text);
+    std::string line;
+    size_t number = 0;
+    while (std::getline(in, line))
+    {
+        ++number;
+
+        const auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        uint32_t code_point = 0;
+        DefaultDim x = 0;
+        DefaultDim y = 0;
+        DefaultDim width = 0;
+        DefaultDim height = 0;
+        DefaultDim x_offset = 0;
+        DefaultDim y_offset = 0;
+        if (!(fields >> code_point >> x >> y >> width >> height >> x_offset >> y_offset))
+            throw std::runtime_error(fmt::format("{}:{}: invalid glyph atlas entry", index, number));
+
+        const Rect rect(x, y, width, height);
+        if (x < 0 || y < 0 || width < 0 || height < 0 ||
+            rect.right() > atlas_size.width() || rect.bottom() > atlas_size.height())
+            throw std::runtime_error(fmt::format("{}:{}: glyph outside of atlas", index, number));
+
+        unsigned long glyph;
+        if (!glyph_index(scaled_font, code_point, glyph))
+        {
+            detail::warn("{}:{}: no glyph for U+{:04X} in {}", index, number, code_point, m_font.face());
+            continue;
+        }
+
+        add(glyph, code_point, rect, Point(x_offset, y_offset));
+    }
+
+    EGTLOG_DEBUG("loaded glyph atlas {} with {} glyphs", uri, size());
+}
+
+void GlyphAtlas::init_font()
+{
+    auto scaled_font = m_font.scaled_font();
+    m_face.reset(cairo_font_face_reference(cairo_scaled_font_get_font_face(scaled_font)),
+                 cairo_font_face_destroy);
+    cairo_scaled_font_get_font_matrix(scaled_font, &m_font_matrix);
+    m_font_options.reset(cairo_font_options_create(), cairo_font_options_destroy);
+    cairo_scaled_font_get_font_options(scaled_font, m_font_options.get());
+}
+
+shared_cairo_t GlyphAtlas::context(cairo_surface_t* surface) const
+{
+    auto cr = shared_cairo_t(cairo_create(surface), cairo_destroy);
+    cairo_set_scaled_font(cr.get(), m_font.scaled_font());
+    return cr;
+}
+
+void GlyphAtlas::add(unsigned long index, uint32_t code_point, const Rect& rect,
+                     const Point& offset)
+{
+    m_glyphs[index] = Glyph{code_point, rect, offset};
+}
+
+void GlyphAtlas::save(const std::string& name) const
+{
+    const auto& surface = m_atlas.surface();
+    if (!surface)
+        throw std::runtime_error("empty glyph atlas");
+
+    cairo_surface_flush(surface.get());
+    if (!detail::ErawImage::save_v2(name + ".eraw",
+                                    cairo_image_surface_get_data(surface.get()),
+                                    detail::ErawImage::Format::a8,
+                                    cairo_image_surface_get_width(surface.get()),
+                                    cairo_image_surface_get_height(surface.get()),
+                                    cairo_image_surface_get_stride(surface.get())))
+        throw std::runtime_error("unable to write glyph atlas: " + name + ".eraw");
+
+    std::vector<const Glyph*> glyphs;
+    glyphs.reserve(m_glyphs.size());
+    for (const auto& glyph : m_glyphs)
+        glyphs.push_back(&glyph.second);
+
+    std::sort(glyphs.begin(), glyphs.end(), [](const Glyph * a, const Glyph * b)
+    {
+        return a->code_point < b->code_point;
+    });
+
+    std::ofstream out(name + ".glyphs");
+    out << "# " << m_font << std::endl;
+    out << "# code_point x y width height x_offset y_offset" << std::endl;
+    for (const auto glyph : glyphs)
+    {
+        out << glyph->code_point << " "
+            << glyph->rect.x() << " " << glyph->rect.y() << " "
+            << glyph->rect.width() << " " << glyph->rect.height() << " "
+            << glyph->offset.x() << " " << glyph->offset.y() << std::endl;
+    }
+
+    if (!out)
+        throw std::runtime_error("unable to write glyph atlas index: " + name + ".glyphs");
+}
+
+static bool unscaled(const cairo_matrix_t& m)
+{
+    return detail::float_equal(m.xx, 1.) && detail::float_equal(m.yy, 1.) &&
+           detail::float_equal(m.xy, 0.) && detail::float_equal(m.yx, 0.);
+}
+
+bool GlyphAtlas::matches(cairo_scaled_font_t* scaled_font) const
+{
+    if (!scaled_font || cairo_scaled_font_get_font_face(scaled_font) != m_face.get())
+        return false;
+
+    cairo_matrix_t m;
+    cairo_scaled_font_get_font_matrix(scaled_font, &m);
+    if (!detail::float_equal(m.xx, m_font_matrix.xx) ||
+        !detail::float_equal(m.yy, m_font_matrix.yy) ||
+        !detail::float_equal(m.xy, m_font_matrix.xy) ||
+        !detail::float_equal(m.yx, m_font_matrix.yx))
+        return false;
+
+    cairo_scaled_font_get_ctm(scaled_font, &m);
+    if (!unscaled(m))
+        return false;
+
+    // antialiasing and hinting change the rendering of the glyphs
+    std::unique_ptr<cairo_font_options_t, decltype(&cairo_font_options_destroy)>
+    options(cairo_font_options_create(), cairo_font_options_destroy);
+    cairo_scaled_font_get_font_options(scaled_font, options.get());
+    return cairo_font_options_equal(options.get(), m_font_options.get());
+}
+
+bool GlyphAtlas::contains(uint32_t code_point) const
+{
+    return std::any_of(m_glyphs.begin(), m_glyphs.end(),
+                       [code_point](const std::pair<const unsigned long, Glyph>& glyph)
+    {
+        return glyph.second.code_point == code_point;
+    });
+}
+
+void GlyphAtlas::draw(cairo_t* cr, const cairo_glyph_t* glyphs, size_t count) const
+{
+    cairo_matrix_t m;
+    cairo_get_matrix(cr, &m);
+    if (!unscaled(m))
+    {
+        cairo_show_glyphs(cr, glyphs, count);
+        return;
+    }
+
+    /*
+     * The glyphs of the atlas are added into a single mask covering the whole
+     * run, which is composited once.  The other glyphs are drawn by cairo.
+     */
+    struct Placed
+    {
+        const Glyph* glyph;
+        Point point;
+    };
+
+    std::vector<Placed> placed;
+    placed.reserve(count);
+    std::vector<cairo_glyph_t> missing;
+    Rect run;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto& g = glyphs[i];
+        const auto it = m_glyphs.find(g.index);
+        if (it == m_glyphs.end())
+        {
+            missing.push_back(g);
+            continue;
+        }
+
+        const auto& glyph = it->second;
+        if (glyph.rect.empty())
+            continue;
+
+        // like cairo, put the origin of glyphs on whole device pixels
+        const Rect r(static_cast<DefaultDim>(std::round(g.x + m.x0)) + glyph.offset.x(),
+                     static_cast<DefaultDim>(std::round(g.y + m.y0)) + glyph.offset.y(),
+                     glyph.rect.width(), glyph.rect.height());
+        run = placed.empty() ? r : Rect::merge(run, r);
+        placed.push_back({&glyph, r.point()});
+    }
+
+    if (!placed.empty())
+    {
+        shared_cairo_surface_t mask(cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                    run.width(), run.height()),
+                                    cairo_surface_destroy);
+        if (cairo_surface_status(mask.get()) != CAIRO_STATUS_SUCCESS)
+        {
+            cairo_show_glyphs(cr, glyphs, count);
+            return;
+        }
+
+        const auto& atlas = m_atlas.surface();
+        const auto src = cairo_image_surface_get_data(atlas.get());
+        const auto src_stride = cairo_image_surface_get_stride(atlas.get());
+        cairo_surface_flush(mask.get());
+        const auto dst = cairo_image_surface_get_data(mask.get());
+        const auto dst_stride = cairo_image_surface_get_stride(mask.get());
+
+        // glyphs overlapping each other add up, as in the masks of cairo
+        for (const auto& p : placed)
+        {
+            const auto& r = p.glyph->rect;
+            for (DefaultDim y = 0; y < r.height(); ++y)
+            {
+                const auto s = src + (r.y() + y) * src_stride + r.x();
+                const auto d = dst + (p.point.y() - run.y() + y) * dst_stride +
+                               (p.point.x() - run.x());
+                for (DefaultDim x = 0; x < r.width(); ++x)
+                    d[x] = static_cast<unsigned char>(std::min(255, d[x] + s[x]));
+            }
+        }
+
+        cairo_surface_mark_dirty(mask.get());
+        cairo_mask_surface(cr, mask.get(), run.x() - m.x0, run.y() - m.y0);
+    }
+
+    if (!missing.empty())
+        cairo_show_glyphs(cr, missing.data(), missing.size());
+}
+
+void GlyphAtlas::draw(Painter& painter, const Point& point, const std::string& text) const
+{
+    auto cr = painter.context().get();
+
+    Painter::AutoSaveRestore sr(painter);
+    painter.set(m_font);
+
+    cairo_glyph_t* glyphs = nullptr;
+    int count = 0;
+    if (cairo_scaled_font_text_to_glyphs(cairo_get_scaled_font(cr),
+                                         point.x(), point.y(),
+                                         text.data(), text.size(),
+                                         &glyphs, &count,
+                                         nullptr, nullptr, nullptr) == CAIRO_STATUS_SUCCESS)
+        draw(cr, glyphs, count);
+    cairo_glyph_free(glyphs);
+}
+
+namespace
+{
+using GlyphAtlasList = std::vector<std::shared_ptr<const GlyphAtlas>>;
+
+struct GlyphAtlases
+{
+    std::mutex mutex;
+    /// Atlases, replaced as a whole so threads drawing can keep them.
+    std::shared_ptr<const GlyphAtlasList> atlases;
+    /// Incremented whenever atlases are replaced, read without the lock.
+    std::atomic<size_t> generation{0};
+};
+}
+
+static GlyphAtlases& glyph_atlases()
+{
+    static GlyphAtlases a;
+    return a;
+}
+
+void add_glyph_atlas(const GlyphAtlas& atlas)
+{
+    auto& a = glyph_atlases();
+    std::lock_guard<std::mutex> lock(a.mutex);
+
+    auto atlases = a.atlases ? std::make_shared<GlyphAtlasList>(*a.atlases) :
+                   std::make_shared<GlyphAtlasList>();
+    auto copy = std::make_shared<const GlyphAtlas>(atlas);
+    auto i = std::find_if(atlases->begin(), atlases->end(),
+                          [&atlas](const std::shared_ptr<const GlyphAtlas>& other)
+    {
+        return other->font() == atlas.font();
+    });
+    if (i != atlases->end())
+        *i = std::move(copy);
+    else
+        atlases->push_back(std::move(copy));
+
+    a.atlases = std::move(atlases);
+    ++a.generation;
+}
+
+void remove_glyph_atlas(const Font& font)
+{
+    auto& a = glyph_atlases();
+    std::lock_guard<std::mutex> lock(a.mutex);
+
+    if (!a.atlases)
+        return;
+
+    auto atlases = std::make_shared<GlyphAtlasList>(*a.atlases);
+    atlases->erase(std::remove_if(atlases->begin(), atlases->end(),
+                                  [&font](const std::shared_ptr<const GlyphAtlas>& atlas)
+    {
+        return atlas->font() == font;
+    }), atlases->end());
+
+    a.atlases = std::move(atlases);
+    ++a.generation;
+}
+
+namespace detail
+{
+
+void show_glyphs(cairo_t* cr, const cairo_glyph_t* glyphs, size_t count)
+{
+    /*
+     * Each thread keeps the atlases, and the one matching the last scaled font
+     * it drew with, and only takes the lock when the atlases change.
+     */
+    struct Cache
+    {
+        size_t generation{0};
+        std::shared_ptr<const GlyphAtlasList> atlases;
+        shared_cairo_scaled_font_t scaled_font;
+        std::shared_ptr<const GlyphAtlas> atlas;
+    };
+    thread_local Cache cache;
+
+    auto& a = glyph_atlases();
+    if (a.generation.load(std::memory_order_acquire) != cache.generation)
+    {
+        std::lock_guard<std::mutex> lock(a.mutex);
+        cache.generation = a.generation.load(std::memory_order_relaxed);
+        cache.atlases = a.atlases;
+        cache.scaled_font.reset();
+        cache.atlas.reset();
+    }
+
+    if (cache.atlases && !cache.atlases->empty())
+    {
+        auto scaled_font = cairo_get_scaled_font(cr);
+        if (cache.scaled_font.get() != scaled_font)
+        {
+            // the reference keeps another font from reusing the address
+            cache.scaled_font.reset(cairo_scaled_font_reference(scaled_font),
+                                    cairo_scaled_font_destroy);
+            cache.atlas.reset();
+            for (const auto& atlas : *cache.atlases)
+            {
+                if (atlas->matches(scaled_font))
+                {
+                    cache.atlas = atlas;
+                    break;
+                }
+            }
+        }
+
+        if (cache.atlas)
+        {
+            cache.atlas->draw(cr, glyphs, count);
+            return;
+        }
+    }
+
+    cairo_show_glyphs(cr, glyphs, count);
+}
+
+}
+
+}
+}
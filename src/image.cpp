@@ -3,18 +3,40 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include "detail/egtlog.h"
+#include "egt/app.h"
 #include "egt/canvas.h"
 #include "egt/detail/alignment.h"
 #include "egt/detail/image.h"
 #include "egt/detail/imagecache.h"
+#include "egt/detail/math.h"
+#include "egt/eventloop.h"
 #include "egt/image.h"
+#include "egt/respath.h"
 #include "egt/serialize.h"
+#include <algorithm>
+#include <atomic>
+#include <egt/asio.hpp>
 
 namespace egt
 {
 inline namespace v1
 {
 
+namespace detail
+{
+
+/// Shared state of an asynchronous image load.
+struct AsyncImageLoad
+{
+    /// Set by the handle, read by the worker.
+    std::atomic<bool> cancelled{false};
+    /// The callback was invoked, only used from the event loop.
+    bool done{false};
+};
+
+}
+
 Image::Image(const std::string& uri, float scale)
     : Image(uri, scale, scale)
 {
@@ -80,6 +102,170 @@ void Image::load(const std::string& uri, float hscale, float vscale, bool approx
     }
 }
 
+Image::AsyncLoad::AsyncLoad(std::shared_ptr<detail::AsyncImageLoad> state) noexcept
+    : m_state(std::move(state))
+{}
+
+Image::AsyncLoad& Image::AsyncLoad::operator=(AsyncLoad&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        cancel();
+        m_state = std::move(rhs.m_state);
+    }
+    return *this;
+}
+
+void Image::AsyncLoad::cancel() noexcept
+{
+    if (m_state)
+    {
+        m_state->cancelled = true;
+        m_state.reset();
+    }
+}
+
+bool Image::AsyncLoad::pending() const
+{
+    return m_state && !m_state->done && !m_state->cancelled;
+}
+
+Image::AsyncLoad::~AsyncLoad() noexcept
+{
+    cancel();
+}
+
+static void finish_async_load(const std::shared_ptr<detail::AsyncImageLoad>& state,
+                              const std::string& uri, float hscale, float vscale,
+                              const Image::LoadCallback& callback,
+                              const std::string& error = {})
+{
+    if (state->cancelled)
+        return;
+
+    state->done = true;
+
+    Image image;
+    if (error.empty())
+    {
+        try
+        {
+            // served by the image cache when decoded by a worker
+            image.load(uri, hscale, vscale);
+        }
+        catch (const std::exception& e)
+        {
+            detail::warn("{}", e.what());
+        }
+    }
+    else
+    {
+        detail::warn("{}", error);
+    }
+
+    if (callback)
+        callback(image);
+}
+
+Image::AsyncLoad Image::load_async(const std::string& uri,
+                                   LoadCallback callback,
+                                   float hscale, float vscale)
+{
+    auto state = std::make_shared<detail::AsyncImageLoad>();
+    auto& io = Application::instance().event().io();
+
+    std::string path;
+    const auto type = detail::resolve_path(uri, path);
+
+    // already loaded, or can only be loaded from the event loop
+    if ((type != detail::SchemeType::resource && type != detail::SchemeType::filesystem) ||
+        detail::image_cache().find(uri, hscale, vscale, false))
+    {
+        asio::post(io, [state, uri, hscale, vscale, callback = std::move(callback)]()
+        {
+            finish_async_load(state, uri, hscale, vscale, callback);
+        });
+
+        return AsyncLoad(state);
+    }
+
+    const auto format = detail::image_cache().native_format();
+
+    // written by the worker, read from the event loop once it is done
+    struct Decoded
+    {
+        shared_cairo_surface_t surface;
+        shared_cairo_surface_t scaled;
+        std::string error;
+    };
+    auto decoded = std::make_shared<Decoded>();
+
+    Application::instance().event().async_work([state, decoded, type, path, uri,
+                                                 hscale, vscale, format]()
+    {
+        if (state->cancelled)
+            return false;
+
+        try
+        {
+            const auto unscaled = detail::float_equal(hscale, 1.0f) &&
+                                  detail::float_equal(vscale, 1.0f);
+            if (!unscaled && type == detail::SchemeType::resource)
+                decoded->scaled = detail::ImageCache::load_variant(path, hscale, vscale);
+
+            if (!decoded->scaled)
+            {
+                auto surface = detail::ImageCache::load(type, path);
+                if (!surface)
+                    decoded->error = "unable to load image: " + uri;
+                else if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+                    decoded->error = std::string("cairo: ") +
+                                     cairo_status_to_string(cairo_surface_status(surface.get())) + ": " + uri;
+                else
+                {
+                    surface = detail::ImageCache::convert_opaque(surface, format);
+                    if (!unscaled)
+                    {
+                        const auto width = cairo_image_surface_get_width(surface.get());
+                        const auto height = cairo_image_surface_get_height(surface.get());
+                        decoded->scaled = detail::ImageCache::scale_surface(surface, width, height,
+                                          width * hscale, height * vscale);
+                    }
+                    decoded->surface = std::move(surface);
+                }
+            }
+            else
+            {
+                decoded->scaled = detail::ImageCache::convert_opaque(decoded->scaled, format);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            decoded->error = e.what();
+        }
+
+        return !state->cancelled;
+    },
+    [state, decoded, uri, hscale, vscale, callback = std::move(callback)]()
+    {
+        if (state->cancelled)
+            return;
+
+        if (decoded->error.empty())
+        {
+            auto& cache = detail::image_cache();
+            if (decoded->surface && !cache.find(uri))
+                cache.add(uri, decoded->surface);
+            if (decoded->scaled && !cache.find(uri, hscale, vscale, false))
+                cache.add(uri, decoded->scaled, hscale, vscale, false);
+        }
+
+        finish_async_load(state, uri, hscale, vscale, callback, decoded->error);
+    });
+
+    return AsyncLoad(state);
+}
+
 void Image::scale(float hscale, float vscale, bool approximate)
 {
     load(m_uri, hscale, vscale, approximate);
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "detail/egtlog.h"
+#include "egt/detail/filesystem.h"
+#include "egt/imageatlas.h"
+#include "egt/resource.h"
+#include "egt/respath.h"
+#include <cctype>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace egt
+{
+inline namespace v1
+{
+
+namespace detail
+{
+
+std::string read_atlas_index(const std::string& index)
+{
+    std::string path;
+    const auto type = detail::resolve_path(index, path);
+
+    switch (type)
+    {
+    case detail::SchemeType::resource:
+    {
+        size_t len = 0;
+        const auto data = ResourceManager::instance().share(path.c_str(), len);
+        if (!data)
+            throw std::runtime_error("resource not found: " + path);
+
+        return {reinterpret_cast<const char*>(data.get()), len};
+    }
+    case detail::SchemeType::filesystem:
+    {
+        if (!detail::exists(path))
+            throw std::runtime_error("file not found: " + path);
+
+        const auto data = detail::read_file(path);
+        return {data.begin(), data.end()};
+    }
+    default:
+        break;
+    }
+
+    throw std::runtime_error("unsupported uri: " + index);
+}
+
+}
+
+static size_t bytes_per_pixel(cairo_format_t format)
+{
+    switch (format)
+    {
+    case CAIRO_FORMAT_RGB16_565:
+        return 2;
+    case CAIRO_FORMAT_A8:
+        return 1;
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB24:
+        return 4;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static cairo_user_data_key_t atlas_key;
+
+namespace detail
+{
+
+shared_cairo_surface_t alias_surface(const shared_cairo_surface_t& atlas,
+                                     const Rect& rect)
+{
+    const auto format = cairo_image_surface_get_format(atlas.get());
+    const auto stride = cairo_image_surface_get_stride(atlas.get());
+    const auto bpp = bytes_per_pixel(format);
+
+    cairo_surface_flush(atlas.get());
+
+    auto data = cairo_image_surface_get_data(atlas.get()) +
+                rect.y() * stride + rect.x() * bpp;
+
+    // pixman needs 32 bit aligned rows, so fall back to copying the pixels
+    if (!bpp || reinterpret_cast<uintptr_t>(data) % 4)
+    {
+        shared_cairo_surface_t surface(cairo_image_surface_create(format,
+                                       rect.width(), rect.height()),
+                                       cairo_surface_destroy);
+        auto cr = shared_cairo_t(cairo_create(surface.get()), cairo_destroy);
+        cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr.get(), atlas.get(), -rect.x(), -rect.y());
+        cairo_paint(cr.get());
+        return surface;
+    }
+
+    shared_cairo_surface_t surface(cairo_image_surface_create_for_data(data,
+                                   format, rect.width(), rect.height(), stride),
+                                   cairo_surface_destroy);
+
+    auto ref = new shared_cairo_surface_t(atlas);
+    if (cairo_surface_set_user_data(surface.get(), &atlas_key, ref,
+                                    [](void* r) { delete static_cast<shared_cairo_surface_t*>(r); })
+        != CAIRO_STATUS_SUCCESS)
+    {
+        delete ref;
+        return nullptr;
+    }
+
+    return surface;
+}
+
+}
+
+ImageAtlas::ImageAtlas(const std::string& uri, const std::string& index)
+{
+    load(uri, index);
+}
+
+ImageAtlas::ImageAtlas(const Image& image)
+    : m_atlas(image)
+{}
+
+void ImageAtlas::load(const std::string& uri, const std::string& index)
+{
+    const auto text = detail::read_atlas_index(index);
+
+    ImageAtlas result{Image(uri)};
+
+    std::istringstream in(text);
+    std::string line;
+    size_t number = 0;
+    while (std::getline(in, line))
+    {
+        ++number;
+
+        const auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        DefaultDim x = 0;
+        DefaultDim y = 0;
+        DefaultDim width = 0;
+        DefaultDim height = 0;
+        std::string name;
+        if (!(fields >> x >> y >> width >> height) ||
+            !std::getline(fields >> std::ws, name))
+            throw std::runtime_error(fmt::format("{}:{}: invalid atlas entry", index, number));
+
+        while (!name.empty() && std::isspace(static_cast<unsigned char>(name.back())))
+            name.pop_back();
+
+        result.add(name, Rect(x, y, width, height));
+    }
+
+    EGTLOG_DEBUG("loaded atlas {} with {} images", uri, result.size());
+
+    *this = std::move(result);
+}
+
+void ImageAtlas::add(const std::string& name, const Rect& rect)
+{
+    const auto size = m_atlas.size();
+    if (rect.empty() || rect.x() < 0 || rect.y() < 0 ||
+        rect.right() > size.width() || rect.bottom() > size.height())
+        throw std::out_of_range(fmt::format("atlas image {} outside of atlas", name));
+
+    m_rects[name] = rect;
+}
+
+Rect ImageAtlas::rect(const std::string& name) const
+{
+    const auto i = m_rects.find(name);
+    if (i == m_rects.end())
+        return {};
+    return i->second;
+}
+
+Image ImageAtlas::image(const std::string& name) const
+{
+    const auto i = m_rects.find(name);
+    if (i == m_rects.end())
+        return {};
+
+    auto surface = detail::alias_surface(m_atlas.surface(), i->second);
+    if (!surface)
+        return {};
+
+    return Image(surface);
+}
+
+std::vector<std::string> ImageAtlas::names() const
+{
+    std::vector<std::string> result;
+    result.reserve(m_rects.size());
+    for (const auto& rect : m_rects)
+        result.push_back(rect.first);
+    return result;
+}
+
+namespace
+{
+/// Registered atlases, which images may be loaded from on any thread.
+struct AtlasRegistry
+{
+    std::mutex mutex;
+    std::unordered_map<std::string, ImageAtlas> atlases;
+};
+}
+
+static AtlasRegistry& registry()
+{
+    static AtlasRegistry r;
+    return r;
+}
+
+void add_image_atlas(const std::string& name, const ImageAtlas& atlas)
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.atlases[name] = atlas;
+}
+
+void remove_image_atlas(const std::string& name)
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.atlases.erase(name);
+}
+
+namespace detail
+{
+
+shared_cairo_surface_t load_image_from_atlas(const std::string& path)
+{
+    const auto separator = path.find('/');
+    if (separator == std::string::npos)
+        throw std::runtime_error("invalid atlas path: " + path);
+
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    const auto i = r.atlases.find(path.substr(0, separator));
+    if (i == r.atlases.end())
+        throw std::runtime_error("atlas not found: " + path);
+
+    const auto name = path.substr(separator + 1);
+    if (!i->second.contains(name))
+        throw std::runtime_error("image not found in atlas: " + path);
+
+    return i->second.image(name).surface();
+}
+
+}
+
+}
+}
@@ -64,11 +64,18 @@ void Label::draw(Painter& painter, const Rect& rect)
     Drawer<Label>::draw(*this, painter, rect);
 }
 
+void Label::prepare_draw(Painter& painter)
+{
+    layout_text(painter);
+    TextWidget::prepare_draw(painter);
+}
+
 void Label::default_draw(const Label& widget, Painter& painter, const Rect&)
 {
     widget.draw_box(painter, Palette::ColorId::label_bg, Palette::ColorId::border);
 
     detail::draw_text(painter,
+                      widget.text_layout(),
                       widget.content_area(),
                       widget.text(),
                       widget.font(),
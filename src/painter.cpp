@@ -77,6 +77,21 @@ Painter& Painter::draw(const Image& image)
     cairo_translate(m_cr.get(), x, y);
     cairo_set_source(m_cr.get(), image.pattern());
 
+    /*
+     * An opaque image replaces what is under it, so copy it instead of
+     * blending it.  When the image has the format of the target, as opaque
+     * images in the image cache have the format of the screen, this is a
+     * plain copy of each row.
+     */
+    if (cairo_surface_get_content(image.surface().get()) == CAIRO_CONTENT_COLOR &&
+        cairo_get_operator(m_cr.get()) == CAIRO_OPERATOR_OVER)
+    {
+        cairo_set_operator(m_cr.get(), CAIRO_OPERATOR_SOURCE);
+        cairo_rectangle(m_cr.get(), 0, 0, image.width(), image.height());
+        fill();
+        return *this;
+    }
+
     /// @todo no paint here
     paint();
 
@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "egt/region.h"
+#include <algorithm>
+#include <ostream>
+
+namespace egt
+{
+inline namespace v1
+{
+
+namespace
+{
+
+/// Horizontal span [x1, x2) of a band.
+struct Span
+{
+    DefaultDim x1;
+    DefaultDim x2;
+};
+
+using SpanArray = std::vector<Span>;
+
+enum class RegionOp
+{
+    unite,
+    subtract,
+    intersect,
+};
+
+/**
+ * Walks the bands of a banded rectangle array.
+ *
+ * Bands are disjoint in y, so the spans covering a horizontal slice [y1, y2)
+ * that does not cross a band boundary are the rectangles of exactly one band.
+ */
+class BandCursor
+{
+public:
+    BandCursor(const Rect* rects, size_t count)
+        : m_rects(rects),
+          m_count(count)
+    {}
+
+    void spans(DefaultDim y1, DefaultDim y2, SpanArray& out)
+    {
+        out.clear();
+
+        while (m_index < m_count && m_rects[m_index].bottom() <= y1)
+            ++m_index;
+
+        for (auto i = m_index; i < m_count; ++i)
+        {
+            const auto& r = m_rects[i];
+            if (r.top() > y1 || r.bottom() < y2)
+                break;
+            out.push_back({r.left(), r.right()});
+        }
+    }
+
+private:
+    const Rect* m_rects;
+    size_t m_count;
+    size_t m_index{0};
+};
+
+void append_span(SpanArray& out, DefaultDim x1, DefaultDim x2)
+{
+    if (x1 >= x2)
+        return;
+
+    // spans that touch are merged so the result stays canonical
+    if (!out.empty() && out.back().x2 >= x1)
+        out.back().x2 = std::max(out.back().x2, x2);
+    else
+        out.push_back({x1, x2});
+}
+
+void combine_spans(RegionOp op, const SpanArray& a, const SpanArray& b, SpanArray& out)
+{
+    out.clear();
+
+    switch (op)
+    {
+    case RegionOp::unite:
+    {
+        size_t ia = 0;
+        size_t ib = 0;
+        while (ia < a.size() || ib < b.size())
+        {
+            if (ib == b.size() || (ia < a.size() && a[ia].x1 <= b[ib].x1))
+            {
+                append_span(out, a[ia].x1, a[ia].x2);
+                ++ia;
+            }
+            else
+            {
+                append_span(out, b[ib].x1, b[ib].x2);
+                ++ib;
+            }
+        }
+        break;
+    }
+    case RegionOp::subtract:
+    {
+        size_t ib = 0;
+        for (const auto& s : a)
+        {
+            auto x1 = s.x1;
+            while (ib < b.size() && b[ib].x2 <= x1)
+                ++ib;
+
+            for (auto j = ib; j < b.size() && b[j].x1 < s.x2; ++j)
+            {
+                append_span(out, x1, b[j].x1);
+                x1 = std::max(x1, b[j].x2);
+            }
+
+            append_span(out, x1, s.x2);
+        }
+        break;
+    }
+    case RegionOp::intersect:
+    {
+        size_t ia = 0;
+        size_t ib = 0;
+        while (ia < a.size() && ib < b.size())
+        {
+            append_span(out, std::max(a[ia].x1, b[ib].x1),
+                        std::min(a[ia].x2, b[ib].x2));
+
+            if (a[ia].x2 < b[ib].x2)
+                ++ia;
+            else
+                ++ib;
+        }
+        break;
+    }
+    }
+}
+
+bool same_spans(const Region::RectArray& rects, size_t begin, size_t end,
+                const SpanArray& spans)
+{
+    if (end - begin != spans.size())
+        return false;
+
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        if (rects[begin + i].left() != spans[i].x1 ||
+            rects[begin + i].right() != spans[i].x2)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Working storage of region_op().
+ *
+ * Regions are combined on every frame while drawing, so this is kept per
+ * thread and reused instead of allocating it for every operation.
+ */
+struct RegionScratch
+{
+    std::vector<DefaultDim> edges;
+    SpanArray sa;
+    SpanArray sb;
+    SpanArray spans;
+    Region::RectArray result;
+};
+
+/**
+ * Combine two banded rectangle arrays band by band.
+ *
+ * This is a sweep over every distinct y edge of both inputs, so the cost is
+ * linear in the number of bands times the number of spans per band.
+ *
+ * The result is written to @p out, which must not be one of the inputs.
+ */
+void region_op(RegionOp op,
+               const Rect* a, size_t na,
+               const Rect* b, size_t nb,
+               Region::RectArray& out)
+{
+    thread_local RegionScratch scratch;
+
+    auto& edges = scratch.edges;
+    edges.clear();
+    for (size_t i = 0; i < na; ++i)
+    {
+        edges.push_back(a[i].top());
+        edges.push_back(a[i].bottom());
+    }
+    for (size_t i = 0; i < nb; ++i)
+    {
+        edges.push_back(b[i].top());
+        edges.push_back(b[i].bottom());
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    auto& result = out;
+    result.clear();
+
+    BandCursor ca(a, na);
+    BandCursor cb(b, nb);
+    auto& sa = scratch.sa;
+    auto& sb = scratch.sb;
+    auto& spans = scratch.spans;
+
+    // start of the previous band in result, for vertical coalescing
+    size_t prev_begin = 0;
+    size_t prev_end = 0;
+
+    for (size_t e = 1; e < edges.size(); ++e)
+    {
+        const auto y1 = edges[e - 1];
+        const auto y2 = edges[e];
+
+        ca.spans(y1, y2, sa);
+        cb.spans(y1, y2, sb);
+        combine_spans(op, sa, sb, spans);
+
+        if (spans.empty())
+            continue;
+
+        if (prev_end > prev_begin &&
+            result[prev_begin].bottom() == y1 &&
+            same_spans(result, prev_begin, prev_end, spans))
+        {
+            for (auto i = prev_begin; i < prev_end; ++i)
+                result[i].height(y2 - result[i].top());
+            continue;
+        }
+
+        prev_begin = result.size();
+        for (const auto& s : spans)
+            result.emplace_back(s.x1, y1, s.x2 - s.x1, y2 - y1);
+        prev_end = result.size();
+    }
+}
+
+/**
+ * Combine two banded rectangle arrays and store the result in @p rects.
+ *
+ * The capacity of @p rects is reused, so in steady state this does not
+ * allocate.
+ */
+void region_op(RegionOp op, Region::RectArray& rects, const Rect* b, size_t nb)
+{
+    thread_local Region::RectArray result;
+
+    region_op(op, rects.data(), rects.size(), b, nb, result);
+    rects.assign(result.begin(), result.end());
+}
+
+}
+
+Region::Region(const Rect& rect)
+{
+    add(rect);
+}
+
+Region::Region(const RectArray& rects)
+{
+    if (rects.size() <= 2)
+    {
+        for (const auto& rect : rects)
+            add(rect);
+        return;
+    }
+
+    // union pairs of regions so each band operation works on similarly
+    // sized inputs, instead of growing one region a rectangle at a time
+    std::vector<RectArray> parts;
+    parts.reserve(rects.size());
+    for (const auto& rect : rects)
+    {
+        if (!rect.empty())
+            parts.push_back(RectArray{rect});
+    }
+
+    while (parts.size() > 1)
+    {
+        size_t out = 0;
+        for (size_t i = 0; i + 1 < parts.size(); i += 2)
+        {
+            RectArray merged;
+            region_op(RegionOp::unite,
+                      parts[i].data(), parts[i].size(),
+                      parts[i + 1].data(), parts[i + 1].size(),
+                      merged);
+            parts[out++] = std::move(merged);
+        }
+        if (parts.size() % 2)
+            parts[out++] = std::move(parts.back());
+        parts.resize(out);
+    }
+
+    if (!parts.empty())
+    {
+        m_rects = std::move(parts.front());
+        update_extents();
+    }
+}
+
+void Region::add(const Rect& rect)
+{
+    if (rect.empty())
+        return;
+
+    if (m_rects.empty())
+    {
+        m_rects.push_back(rect);
+        m_extents = rect;
+        return;
+    }
+
+    // fast path: already covered
+    if (m_rects.size() == 1 &&
+        Rect::intersection(m_rects.front(), rect) == rect)
+        return;
+
+    region_op(RegionOp::unite, m_rects, &rect, 1);
+    update_extents();
+}
+
+void Region::add(const Region& region)
+{
+    if (region.empty())
+        return;
+
+    if (m_rects.empty())
+    {
+        *this = region;
+        return;
+    }
+
+    region_op(RegionOp::unite, m_rects, region.m_rects.data(), region.m_rects.size());
+    update_extents();
+}
+
+void Region::subtract(const Rect& rect)
+{
+    if (rect.empty() || !m_extents.intersect(rect))
+        return;
+
+    region_op(RegionOp::subtract, m_rects, &rect, 1);
+    update_extents();
+}
+
+void Region::subtract(const Region& region)
+{
+    if (region.empty() || !m_extents.intersect(region.extents()))
+        return;
+
+    region_op(RegionOp::subtract, m_rects, region.m_rects.data(), region.m_rects.size());
+    update_extents();
+}
+
+void Region::intersect(const Rect& rect)
+{
+    if (rect.empty() || !m_extents.intersect(rect))
+    {
+        clear();
+        return;
+    }
+
+    region_op(RegionOp::intersect, m_rects, &rect, 1);
+    update_extents();
+}
+
+void Region::translate(const Point& offset)
+{
+    for (auto& rect : m_rects)
+        rect += offset;
+    m_extents += offset;
+}
+
+bool Region::intersects(const Rect& rect) const
+{
+    if (!m_extents.intersect(rect))
+        return false;
+
+    return std::any_of(m_rects.begin(), m_rects.end(),
+                       [&rect](const Rect & r) { return r.intersect(rect); });
+}
+
+bool Region::contains(const Rect& rect) const
+{
+    if (rect.empty())
+        return true;
+
+    if (!m_extents.intersect(rect))
+        return false;
+
+    DefaultDim covered = 0;
+    for (const auto& r : m_rects)
+    {
+        if (r.intersect(rect))
+            covered += Rect::intersection(r, rect).area();
+    }
+
+    return covered == rect.area();
+}
+
+void Region::merge(const Rect& rect, float max_waste)
+{
+    if (rect.empty() || contains(rect))
+        return;
+
+    auto grown = rect;
+    auto grown_covered = covered(grown);
+
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+
+        // neighbours are the rectangles of the bands grown overlaps or touches
+        const auto neighbours = bands(grown.top() - 1, grown.bottom() + 1);
+        for (auto i = neighbours.first; i < neighbours.second; ++i)
+        {
+            const auto bbox = Rect::merge(grown, m_rects[i]);
+            if (bbox == grown)
+                continue;
+
+            // grown is inside bbox, so this is the area of bbox covered once
+            // grown is added to the region
+            const auto bbox_covered = covered(bbox);
+            const auto waste = bbox.area() - (bbox_covered + grown.area() - grown_covered);
+
+            if (waste <= max_waste * bbox.area())
+            {
+                grown = bbox;
+                grown_covered = bbox_covered;
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    add(grown);
+}
+
+void Region::simplify(float max_waste)
+{
+    if (m_rects.size() <= 1)
+        return;
+
+    Region result;
+    for (const auto& rect : m_rects)
+        result.merge(rect, max_waste);
+    *this = std::move(result);
+}
+
+std::pair<size_t, size_t> Region::bands(DefaultDim y1, DefaultDim y2) const
+{
+    // bands are disjoint and sorted by y, so both tops and bottoms are sorted
+    const auto first = std::partition_point(m_rects.begin(), m_rects.end(),
+                                            [y1](const Rect & r) { return r.bottom() <= y1; });
+    const auto last = std::partition_point(first, m_rects.end(),
+                                           [y2](const Rect & r) { return r.top() < y2; });
+
+    return {first - m_rects.begin(), last - m_rects.begin()};
+}
+
+DefaultDim Region::covered(const Rect& rect) const
+{
+    DefaultDim total = 0;
+    const auto range = bands(rect.top(), rect.bottom());
+    for (auto i = range.first; i < range.second; ++i)
+    {
+        if (m_rects[i].intersect(rect))
+            total += Rect::intersection(m_rects[i], rect).area();
+    }
+    return total;
+}
+
+DefaultDim Region::area() const
+{
+    DefaultDim total = 0;
+    for (const auto& r : m_rects)
+        total += r.area();
+    return total;
+}
+
+void Region::update_extents()
+{
+    if (m_rects.empty())
+    {
+        m_extents.clear();
+        return;
+    }
+
+    // bands are sorted by y, so only x needs to be searched
+    auto x1 = m_rects.front().left();
+    auto x2 = m_rects.front().right();
+    for (const auto& r : m_rects)
+    {
+        x1 = std::min(x1, r.left());
+        x2 = std::max(x2, r.right());
+    }
+
+    const auto y1 = m_rects.front().top();
+    const auto y2 = m_rects.back().bottom();
+
+    m_extents = Rect(x1, y1, x2 - x1, y2 - y1);
+}
+
+std::ostream& operator<<(std::ostream& os, const Region& region)
+{
+    os << "{";
+    for (auto i = region.begin(); i != region.end(); ++i)
+    {
+        if (i != region.begin())
+            os << ",";
+        os << *i;
+    }
+    os << "}";
+    return os;
+}
+
+}
+}
@@ -8,11 +8,16 @@
 #endif
 
 #include "detail/egtlog.h"
+#include "detail/resourcebundle.h"
 #include "egt/detail/image.h"
 #include "egt/detail/meta.h"
 #include "egt/resource.h"
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <memory>
+#include <set>
+#include <stdexcept>
 
 #ifdef HAVE_ZLIB
 #include <zlib.h>
@@ -23,6 +28,60 @@ namespace egt
 inline namespace v1
 {
 
+#ifdef HAVE_ZLIB
+/*
+ * Inflated size of gzip data from the ISIZE field of the gzip trailer.  This
+ * is the size modulo 2^32, and comes from the data itself, so it is only a
+ * hint: it is limited to what deflate can expand the data to at most.
+ */
+static size_t gzip_size_hint(const unsigned char* data, size_t len)
+{
+    // smallest possible gzip member: 10 byte header, 8 byte trailer
+    if (len < 18)
+        return 0;
+
+    const auto p = data + len - 4;
+    const auto isize = static_cast<size_t>(p[0]) |
+                       static_cast<size_t>(p[1]) << 8 |
+                       static_cast<size_t>(p[2]) << 16 |
+                       static_cast<size_t>(p[3]) << 24;
+
+    // the maximum compression ratio of deflate is 1032:1
+    return std::min(isize, len * 1032);
+}
+
+/// zlib inflate state that is released with its owner.
+struct InflateStream
+{
+    InflateStream(const unsigned char* data, size_t len)
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = len;
+        // automatic zlib or gzip header detection
+        ok = inflateInit2(&stream, 15 + 32) == Z_OK;
+        if (!ok)
+            detail::warn("failed to init zlib inflate");
+    }
+
+    InflateStream(const InflateStream&) = delete;
+    InflateStream& operator=(const InflateStream&) = delete;
+    InflateStream(InflateStream&&) = delete;
+    InflateStream& operator=(InflateStream&&) = delete;
+
+    ~InflateStream()
+    {
+        if (ok)
+            inflateEnd(&stream);
+    }
+
+    z_stream stream{};
+    bool ok{false};
+};
+#endif
+
 // NOLINTNEXTLINE(hicpp-special-member-functions, cppcoreguidelines-special-member-functions)
 struct ResourceManager::ResourceItem
 {
@@ -34,25 +93,27 @@ struct ResourceManager::ResourceItem
     {}
 
     explicit ResourceItem(std::vector<unsigned char> data)
-        : m_data_copy(std::move(data)),
-          m_data(m_data_copy.data()),
-          m_len(m_data_copy.size())
+    {
+        auto copy = std::make_shared<std::vector<unsigned char>>(std::move(data));
+        m_data = copy->data();
+        m_len = copy->size();
+        m_owner = std::move(copy);
+    }
+
+    /// Data owned by something else, like a bundle, kept alive by @p owner.
+    ResourceItem(std::shared_ptr<const void> owner, const unsigned char* data, size_t len) noexcept
+        : m_owner(std::move(owner)),
+          m_data(data),
+          m_len(len)
     {}
 
+    // the copy starts its own stream, the data itself is shared
     ResourceItem(const ResourceItem& rhs)
-        : m_data_copy(rhs.m_data_copy)
-    {
-        if (!m_data_copy.empty())
-        {
-            m_data = m_data_copy.data();
-            m_len = m_data_copy.size();
-        }
-        else
-        {
-            m_data = rhs.m_data;
-            m_len = rhs.m_len;
-        }
-    }
+        : m_owner(rhs.m_owner),
+          m_data(rhs.m_data),
+          m_len(rhs.m_len),
+          m_inflated(rhs.m_inflated)
+    {}
 
     ResourceItem& operator=(const ResourceItem&) = delete;
     ResourceItem(ResourceItem&&) = default;
@@ -61,80 +122,206 @@ struct ResourceManager::ResourceItem
     inline const unsigned char* data()
     {
         do_inflate();
-        return m_data;
+        return m_inflated ? m_inflated->data() : m_data;
     }
 
     inline size_t len()
     {
         do_inflate();
-        return m_len;
+        return m_inflated ? m_inflated->size() : m_len;
+    }
+
+    SharedData share(size_t& len)
+    {
+        do_inflate();
+        if (m_inflated)
+        {
+            len = m_inflated->size();
+            return {m_inflated, m_inflated->data()};
+        }
+
+        len = m_len;
+        // data without an owner belongs to the application
+        if (m_owner)
+            return {m_owner, m_data};
+        return {SharedData(), m_data};
+    }
+
+    /// Get the data as added, without inflating it.
+    const unsigned char* raw(size_t& len) const
+    {
+        len = m_len;
+        return m_data;
+    }
+
+    void trim()
+    {
+        m_inflated.reset();
+    }
+
+    void stream_reset()
+    {
+        index = 0;
+#ifdef HAVE_ZLIB
+        m_stream.reset();
+#endif
+    }
+
+    void stream_read(unsigned char* data, size_t length)
+    {
+#ifdef HAVE_ZLIB
+        // inflate straight into the caller's buffer, unless already inflated
+        if (!m_inflated && compressed())
+        {
+            if (!m_stream)
+            {
+                m_stream = std::make_unique<InflateStream>(m_data, m_len);
+                if (!m_stream->ok)
+                    throw std::runtime_error("failed to init zlib inflate");
+
+                // the stream started on inflated data that was trimmed since
+                std::array<unsigned char, 1024> skip{};
+                for (size_t skipped = 0; skipped < index;)
+                {
+                    const auto n = std::min(skip.size(), index - skipped);
+                    stream_inflate(skip.data(), n);
+                    skipped += n;
+                }
+            }
+
+            stream_inflate(data, length);
+            index += length;
+            return;
+        }
+#endif
+
+        if ((index + length) > len())
+            throw std::runtime_error("read past end of data on resource");
+
+        memcpy(data, this->data() + index, length);
+        index += length;
     }
 
     size_t index{0};
 
+    /// Is the data compressed.
+    bool compressed()
+    {
+#ifdef HAVE_ZLIB
+        if (!m_checked)
+        {
+            m_checked = true;
+            m_compressed = detail::get_mime_type(m_data, m_len) == "application/gzip";
+        }
+        return m_compressed;
+#else
+        return false;
+#endif
+    }
+
+    /// Set if the data is compressed, instead of detecting it.
+    void compressed(bool value)
+    {
+#ifdef HAVE_ZLIB
+        m_checked = true;
+        m_compressed = value;
+#else
+        detail::ignoreparam(value);
+#endif
+    }
+
 private:
 
+#ifdef HAVE_ZLIB
+    /// Inflate the next bytes of the stream of stream_read().
+    void stream_inflate(unsigned char* data, size_t length)
+    {
+        auto& stream = m_stream->stream;
+        stream.next_out = reinterpret_cast<Bytef*>(data);
+        stream.avail_out = length;
+
+        int res;
+        do
+        {
+            res = inflate(&stream, Z_NO_FLUSH);
+        }
+        while (res == Z_OK && stream.avail_out);
+
+        if (stream.avail_out)
+        {
+            if (res == Z_STREAM_END)
+                throw std::runtime_error("read past end of data on resource");
+            throw std::runtime_error(fmt::format("failed to inflate resource: {}", res));
+        }
+    }
+#endif
+
+    /*
+     * Inflate the whole resource into one allocation sized from the gzip
+     * trailer.  The buffer only grows if the trailer is wrong, for example
+     * with more than 4 GB of data.
+     */
     void do_inflate()
     {
 #ifdef HAVE_ZLIB
-        if (m_inflated)
-            return;
-        m_inflated = true;
-
-        auto mimetype = detail::get_mime_type(m_data, m_len);
-        if (mimetype != "application/gzip")
+        if (m_inflated || m_failed || !compressed())
             return;
 
-        z_stream stream{};
-        stream.zalloc = Z_NULL;
-        stream.zfree = Z_NULL;
-        stream.opaque = Z_NULL;
-        if (inflateInit2(&stream, 15 + 32) != Z_OK)
+        InflateStream s(m_data, m_len);
+        if (!s.ok)
         {
-            detail::warn("failed to init zlib inflate");
+            m_failed = true;
             return;
         }
 
-        stream.next_in = (Bytef*)m_data;
-        stream.avail_in = m_len;
+        auto buffer = std::make_shared<std::vector<unsigned char>>(
+                          std::max<size_t>(gzip_size_hint(m_data, m_len), 1));
 
-        const size_t BUFSIZE = 8 * 1024;
-        unsigned char buffer[BUFSIZE];
+        auto& stream = s.stream;
         int res;
-        do
+        while (true)
         {
-            stream.next_out = reinterpret_cast<Bytef*>(buffer);
-            stream.avail_out = BUFSIZE;
-
-            res = inflate(&stream, Z_NO_FLUSH);
+            stream.next_out = buffer->data() + stream.total_out;
+            stream.avail_out = buffer->size() - stream.total_out;
 
-            if (m_buf.size() < stream.total_out)
-                m_buf.insert(m_buf.end(),
-                             buffer,
-                             buffer + stream.total_out - m_buf.size());
+            res = inflate(&stream, Z_FINISH);
+            if (res == Z_STREAM_END)
+                break;
 
-        } while (res == Z_OK);
+            if (res == Z_OK || (res == Z_BUF_ERROR && !stream.avail_out))
+            {
+                if (!stream.avail_out)
+                    buffer->resize(buffer->size() * 2);
+                continue;
+            }
 
-        inflateEnd(&stream);
+            break;
+        }
 
         if (res != Z_STREAM_END)
         {
             detail::warn("failed to finish zlib inflate: {}", res);
+            m_failed = true;
             return;
         }
 
-        m_data = m_buf.data();
-        m_len = m_buf.size();
-        m_data_copy.clear();
+        buffer->resize(stream.total_out);
+        m_inflated = std::move(buffer);
 #endif
     }
 
-    std::vector<unsigned char> m_data_copy;
+    /// Owner of the data, if not the application.
+    std::shared_ptr<const void> m_owner;
     const unsigned char* m_data{nullptr};
     size_t m_len{0};
-    std::vector<unsigned char> m_buf;
+    /// Inflated data of a compressed resource, shared with share().
+    std::shared_ptr<std::vector<unsigned char>> m_inflated;
 #ifdef HAVE_ZLIB
-    bool m_inflated {false};
+    /// Inflate state of stream_read().
+    std::unique_ptr<InflateStream> m_stream;
+    bool m_checked{false};
+    bool m_compressed{false};
+    bool m_failed{false};
 #endif
 };
 
@@ -148,25 +335,64 @@ ResourceManager& ResourceManager::instance()
 
 bool ResourceManager::exists(const char* name) const
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     const auto i = m_resources.find(name);
-    return i != m_resources.end();
+    if (i != m_resources.end())
+        return true;
+
+    const std::string key(name);
+    return std::any_of(m_bundles.begin(), m_bundles.end(),
+                       [&key](const std::shared_ptr<detail::ResourceBundle>& bundle)
+    {
+        return bundle->find(key) != nullptr;
+    });
+}
+
+ResourceManager::ResourceMap::iterator ResourceManager::lookup(const char* name)
+{
+    const std::string key(name);
+    const auto i = m_resources.find(key);
+    if (i != m_resources.end())
+        return i;
+
+    for (auto b = m_bundles.rbegin(); b != m_bundles.rend(); ++b)
+    {
+        const auto& bundle = *b;
+        if (const auto entry = bundle->find(key))
+        {
+            ResourceItem item(bundle, bundle->data(*entry), entry->size);
+            item.compressed(entry->flags & detail::ResourceBundle::compressed);
+            return m_resources.emplace(key, std::move(item)).first;
+        }
+    }
+
+    return m_resources.end();
 }
 
 void ResourceManager::clear()
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_resources.clear();
+    m_bundles.clear();
+    m_variants.clear();
+    m_indexed_bundles = 0;
 }
 
 void ResourceManager::clear(const char* name)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     const auto i = m_resources.find(name);
     if (i != m_resources.end())
+    {
         m_resources.erase(i);
+        unindex_variant(name);
+    }
 }
 
 size_t ResourceManager::size(const char* name)
 {
-    const auto i = m_resources.find(name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
     if (i != m_resources.end())
         return i->second.len();
 
@@ -175,17 +401,37 @@ size_t ResourceManager::size(const char* name)
 
 const unsigned char* ResourceManager::data(const char* name)
 {
-    const auto i = m_resources.find(name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
     if (i != m_resources.end())
         return i->second.data();
 
     return nullptr;
 }
 
+ResourceManager::SharedData ResourceManager::share(const char* name, size_t& len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
+    if (i != m_resources.end())
+        return i->second.share(len);
+
+    len = 0;
+    return nullptr;
+}
+
+void ResourceManager::trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& resource : m_resources)
+        resource.second.trim();
+}
+
 bool ResourceManager::read(const char* name, unsigned char* data,
                            size_t length, size_t offset)
 {
-    const auto i = m_resources.find(name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
     if (i != m_resources.end())
     {
         if ((offset + length) > i->second.len())
@@ -200,67 +446,171 @@ bool ResourceManager::read(const char* name, unsigned char* data,
 
 void ResourceManager::stream_reset(const char* name)
 {
-    const auto i = m_resources.find(name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
     if (i != m_resources.end())
-        i->second.index = 0;
+        i->second.stream_reset();
 }
 
 bool ResourceManager::stream_read(const char* name, unsigned char* data,
                                   size_t length)
 {
-    const auto i = m_resources.find(name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto i = lookup(name);
     if (i != m_resources.end())
     {
-        if ((i->second.index + length) > i->second.len())
-            throw std::runtime_error("read past end of data on resource");
-
-        memcpy(data, i->second.data() + i->second.index, length);
-        i->second.index += length;
-
+        i->second.stream_read(data, length);
         return true;
     }
 
     return false;
 }
 
-template<typename T1, typename T2>
-std::vector<T1> extract_keys(std::map<T1, T2> const& input_map)
+ResourceManager::ItemArray ResourceManager::list() const
 {
-    std::vector<T1> ret;
-    ret.reserve(input_map.size());
-    for (auto const& element : input_map)
-        ret.push_back(element.first);
-    return ret;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::set<std::string> names;
+    for (const auto& resource : m_resources)
+        names.insert(resource.first);
+
+    for (const auto& bundle : m_bundles)
+    {
+        const auto entries = bundle->entries();
+        for (uint32_t i = 0; i < bundle->count(); ++i)
+            names.insert(bundle->name(entries[i]));
+    }
+
+    return {names.begin(), names.end()};
 }
 
-ResourceManager::ItemArray ResourceManager::list() const
+ResourceManager::ItemArray ResourceManager::variants(const char* name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // read the names of bundles only once, and only if variants are used
+    for (; m_indexed_bundles < m_bundles.size(); ++m_indexed_bundles)
+    {
+        const auto& bundle = m_bundles[m_indexed_bundles];
+        const auto entries = bundle->entries();
+        for (uint32_t i = 0; i < bundle->count(); ++i)
+            index_variant(bundle->name(entries[i]));
+    }
+
+    const auto i = m_variants.find(name);
+    if (i == m_variants.end())
+        return {};
+
+    return {i->second.begin(), i->second.end()};
+}
+
+void ResourceManager::index_variant(const std::string& name)
 {
-    return extract_keys(m_resources);
+    const auto at = name.rfind('@');
+    if (at == std::string::npos || at == 0 || at + 1 == name.size())
+        return;
+
+    m_variants[name.substr(0, at)].insert(name);
+}
+
+void ResourceManager::unindex_variant(const std::string& name)
+{
+    const auto in_bundle = std::any_of(m_bundles.begin(), m_bundles.end(),
+                                       [&name](const std::shared_ptr<detail::ResourceBundle>& bundle)
+    {
+        return bundle->find(name) != nullptr;
+    });
+
+    // still there in a bundle
+    if (in_bundle)
+        return;
+
+    const auto at = name.rfind('@');
+    if (at == std::string::npos)
+        return;
+
+    const auto i = m_variants.find(name.substr(0, at));
+    if (i == m_variants.end())
+        return;
+
+    i->second.erase(name);
+    if (i->second.empty())
+        m_variants.erase(i);
 }
 
 void ResourceManager::add(const char* name, const unsigned char* data, size_t len)
 {
-    if (exists(name))
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_resources.find(name) != m_resources.end())
         detail::warn("resource added with duplicate name: {}", name);
 
     ResourceItem r(data, len);
     m_resources.insert(std::make_pair(name, r));
+    index_variant(name);
 }
 
 void ResourceManager::add(const char* name, const std::vector<unsigned char>& data)
 {
-    if (exists(name))
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_resources.find(name) != m_resources.end())
         detail::warn("resource added with duplicate name: {}", name);
 
     ResourceItem r(data);
     m_resources.insert(std::make_pair(name, r));
+    index_variant(name);
 }
 
 void ResourceManager::remove(const char* name)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     const auto i = m_resources.find(name);
     if (i != m_resources.end())
+    {
         m_resources.erase(i);
+        unindex_variant(name);
+    }
+}
+
+void ResourceManager::add_bundle(const std::string& path)
+{
+    auto bundle = detail::ResourceBundle::map(path);
+
+    EGTLOG_DEBUG("added resource bundle {} with {} resources", path, bundle->count());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bundles.push_back(std::move(bundle));
+}
+
+void ResourceManager::add_bundle(const unsigned char* data, size_t len)
+{
+    auto bundle = std::make_shared<detail::ResourceBundle>(data, len);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bundles.push_back(std::move(bundle));
+}
+
+void ResourceManager::save_bundle(const std::string& path, const ItemArray& names,
+                                  size_t alignment)
+{
+    const auto all = names.empty() ? list() : names;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<detail::ResourceBundle::Item> items;
+    items.reserve(all.size());
+    for (const auto& name : all)
+    {
+        const auto i = lookup(name.c_str());
+        if (i == m_resources.end())
+            throw std::runtime_error("resource not found: " + name);
+
+        size_t len = 0;
+        const auto data = i->second.raw(len);
+        items.push_back({name, data, len,
+                         i->second.compressed() ? detail::ResourceBundle::compressed : 0u});
+    }
+
+    detail::ResourceBundle::write(path, items, alignment);
 }
 
 namespace detail
@@ -142,6 +142,12 @@ SchemeType resolve_path(const std::string& path, std::string& result)
         result = uri.to_string();
         break;
     }
+    case detail::hash("atlas"):
+    {
+        type = SchemeType::atlas;
+        result = uri.path();
+        break;
+    }
     case detail::hash("file"):
     {
         type = SchemeType::filesystem;
@@ -8,13 +8,16 @@
 #endif
 
 #include "detail/dump.h"
+#include "detail/egtlog.h"
 #include "egt/color.h"
 #include "egt/palette.h"
 #include "egt/screen.h"
 #include "egt/types.h"
 #include "egt/utils.h"
+#include <algorithm>
 #include <cairo.h>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <numeric>
 #include <string>
@@ -34,18 +37,53 @@ Screen::Screen() noexcept
         m_async = true;
 }
 
-void Screen::flip(const DamageArray& damage)
+void Screen::flip(const Region& damage)
 {
+    if (m_direct)
+    {
+        if (damage.empty())
+            return;
+
+        // the frame was drawn in place; remember its damage for the other
+        // buffers and hand this one to the display
+        ++m_frame;
+        m_history[m_frame % m_history.size()] = damage;
+        m_buffers[index()].frame = m_frame;
+
+        m_flip_damage = damage.extents();
+        schedule_flip();
+        select_direct_buffer();
+        return;
+    }
+
     if (!damage.empty() && index() < m_buffers.size())
     {
-        // save the damage to all buffers
-        for (auto& b : m_buffers)
-            for (const auto& d : damage)
-                b.add_damage(d);
+        if (m_tile_size)
+        {
+            // damage is tracked in the tile map instead of per buffer
+            damage_tiles(damage);
+        }
+        else
+        {
+            // save the damage to all buffers
+            for (auto& b : m_buffers)
+            {
+                if (damage_policy() == DamagePolicy::exact)
+                    b.damage.add(damage);
+                else
+                    for (const auto& d : damage)
+                        b.add_damage(d);
+            }
+        }
 
         detail::code_timer(false, "copy_to_buffer: ", [&]()
         {
             ScreenBuffer& buffer = m_buffers[index()];
+            if (m_tile_size)
+            {
+                buffer.damage = tile_damage(buffer.frame);
+                buffer.frame = m_frame;
+            }
             if ((m_format == PixelFormat::rgb565) ||
                 (m_format == PixelFormat::argb8888) ||
                 (m_format == PixelFormat::xrgb8888))
@@ -56,6 +94,7 @@ void Screen::flip(const DamageArray& damage)
             {
                 throw std::runtime_error("invalid pixelformat: cario supports only RGB formats");
             }
+            m_flip_damage = buffer.damage.extents();
             // delete all damage from current buffer
             buffer.damage.clear();
         });
@@ -86,7 +125,7 @@ static constexpr View::Format simd_format(cairo_format_t format)
 
 static void simd_copy(cairo_surface_t* src_surface,
                       cairo_surface_t* dst_surface,
-                      const Screen::DamageArray& damage)
+                      const Region& damage)
 {
     cairo_surface_flush(src_surface);
 
@@ -118,7 +157,7 @@ static void simd_copy(cairo_surface_t* src_surface,
                  simd_format(dst_format), dst);
 
     if (damage.size() == 1 &&
-        damage[0] == Rect(Point(), Size(src_width, src_height)))
+        damage.front() == Rect(Point(), Size(src_width, src_height)))
     {
         memcpy(dst, src,
                src_width * dst_height * (src_format == CAIRO_FORMAT_RGB16_565 ? 2 : 4));
@@ -377,33 +416,243 @@ void Screen::copy_to_buffer_software(ScreenBuffer& buffer)
     cairo_surface_flush(buffer.surface.get());
 }
 
+namespace
+{
+struct DamageConfig
+{
+    Screen::DamagePolicy policy{Screen::DamagePolicy::cost};
+    float max_waste{0.25f};
+    /// Past this many rectangles the damage is replaced by its bounding box.
+    size_t max_rects{32};
+};
+}
+
+static DamageConfig& damage_config()
+{
+    static DamageConfig config = []()
+    {
+        DamageConfig c;
+
+        const char* env = std::getenv("EGT_DAMAGE_POLICY");
+        if (env && strlen(env))
+        {
+            const std::string value(env);
+            const auto sep = value.find(':');
+            const auto name = value.substr(0, sep);
+
+            if (name == "exact")
+                c.policy = Screen::DamagePolicy::exact;
+            else if (name == "bbox" || name == "bounding_box")
+                c.policy = Screen::DamagePolicy::bounding_box;
+            else if (name == "cost")
+                c.policy = Screen::DamagePolicy::cost;
+            else
+                detail::warn("invalid EGT_DAMAGE_POLICY: {}", value);
+
+            if (sep != std::string::npos)
+                c.max_waste = detail::clamp(std::strtol(env + sep + 1, nullptr, 10) / 100.f, 0.f, 1.f);
+        }
+
+        return c;
+    }();
+
+    return config;
+}
+
+void Screen::damage_policy(DamagePolicy policy, float max_waste)
+{
+    damage_config().policy = policy;
+    damage_config().max_waste = detail::clamp(max_waste, 0.f, 1.f);
+}
+
+Screen::DamagePolicy Screen::damage_policy()
+{
+    return damage_config().policy;
+}
+
+void Screen::damage_algorithm(Region& damage, const Rect& rect)
+{
+    if (rect.empty())
+        return;
+
+    const auto& config = damage_config();
+    switch (config.policy)
+    {
+    case DamagePolicy::exact:
+        damage.add(rect);
+        break;
+    case DamagePolicy::cost:
+        damage.merge(rect, config.max_waste);
+        if (damage.size() > config.max_rects)
+        {
+            const auto extents = damage.extents();
+            damage.clear();
+            damage.add(extents);
+        }
+        break;
+    case DamagePolicy::bounding_box:
+        damage.add(rect);
+        if (damage.size() > 1)
+        {
+            const auto extents = damage.extents();
+            damage.clear();
+            damage.add(extents);
+        }
+        break;
+    }
+}
+
 void Screen::damage_algorithm(Screen::DamageArray& damage, Rect rect)
 {
     if (rect.empty())
         return;
 
-    // work backwards for a stronger hit chance for existing rectangles
-    for (auto i = damage.rbegin(); i != damage.rend();)
+    Region region(damage);
+    damage_algorithm(region, rect);
+    damage.assign(region.begin(), region.end());
+}
+
+void Screen::tile_size(DefaultDim size)
+{
+    // nothing is copied to the buffers when drawing directly into them
+    if (m_direct)
+        return;
+
+    // hand any pending tile damage back to the buffers
+    if (m_tile_size)
     {
-        // exact rectangle already exists; done
-        if (*i == rect)
-            return;
+        for (auto& b : m_buffers)
+            b.damage.add(tile_damage(b.frame));
+    }
 
-        // if this rectangle intersects an existing rectangle, then merge
-        // the rectangles and start over
-        if (rect.intersect(*i))
-        {
-            rect = Rect::merge(*i, rect);
-            damage.erase(std::next(i).base());
-            i = damage.rbegin();
+    m_tile_size = std::max(size, 0);
+    m_tiles.clear();
+    m_tile_columns = 0;
+    m_tile_rows = 0;
+
+    if (!m_tile_size || m_size.empty())
+        return;
+
+    m_tile_columns = (m_size.width() + m_tile_size - 1) / m_tile_size;
+    m_tile_rows = (m_size.height() + m_tile_size - 1) / m_tile_size;
+
+    // start with every tile damaged for every buffer
+    ++m_frame;
+    m_tiles.assign(m_tile_columns * m_tile_rows, m_frame);
+    for (auto& b : m_buffers)
+        b.damage.clear();
+}
+
+void Screen::damage_tiles(const Region& damage)
+{
+    ++m_frame;
+
+    for (const auto& rect : damage)
+    {
+        const auto r = Rect::intersection(rect, box());
+        if (r.empty())
             continue;
+
+        const auto x1 = r.left() / m_tile_size;
+        const auto x2 = (r.right() - 1) / m_tile_size;
+        const auto y1 = r.top() / m_tile_size;
+        const auto y2 = (r.bottom() - 1) / m_tile_size;
+
+        for (auto y = y1; y <= y2; ++y)
+        {
+            auto row = m_tiles.begin() + y * m_tile_columns;
+            std::fill(row + x1, row + x2 + 1, m_frame);
+        }
+    }
+}
+
+Region Screen::tile_damage(uint32_t frame) const
+{
+    Region::RectArray runs;
+
+    for (auto y = 0; y < m_tile_rows; ++y)
+    {
+        const auto row = m_tiles.begin() + y * m_tile_columns;
+
+        auto x = 0;
+        while (x < m_tile_columns)
+        {
+            if (row[x] <= frame)
+            {
+                ++x;
+                continue;
+            }
+
+            const auto start = x;
+            while (x < m_tile_columns && row[x] > frame)
+                ++x;
+
+            // one copy per run of tiles, clipped to the screen
+            runs.push_back(Rect::intersection(
+                               Rect(start * m_tile_size, y * m_tile_size,
+                                    (x - start) * m_tile_size, m_tile_size),
+                               box()));
         }
+    }
+
+    // vertically adjacent runs with the same columns are coalesced
+    return Region(runs);
+}
+
+Region Screen::frame_damage(const Region& damage)
+{
+    if (!m_direct)
+        return damage;
+
+    const auto& buffer = m_buffers[index()];
 
-        ++i;
+    // buffer never drawn, or older than the history we keep
+    if (!buffer.frame || m_frame - buffer.frame >= m_history.size())
+        return Region(box());
+
+    auto result = damage;
+    for (auto frame = buffer.frame + 1; frame <= m_frame; ++frame)
+        result.add(m_history[frame % m_history.size()]);
+
+    return result;
+}
+
+void Screen::select_direct_buffer()
+{
+    auto surface = m_buffers[index()].surface.get();
+    if (m_surface.get() == surface)
+        return;
+
+    m_surface = shared_cairo_surface_t(cairo_surface_reference(surface),
+                                       cairo_surface_destroy);
+
+    shared_cairo_t cr(cairo_create(m_surface.get()), cairo_destroy);
+
+    // carry over any fidelity settings
+    if (m_cr)
+    {
+        cairo_font_options_t* cfo = cairo_font_options_create();
+        cairo_get_font_options(m_cr.get(), cfo);
+        cairo_set_font_options(cr.get(), cfo);
+        cairo_font_options_destroy(cfo);
+
+        cairo_set_antialias(cr.get(), cairo_get_antialias(m_cr.get()));
     }
 
-    // if we get here, no intersect found so add it
-    damage.emplace_back(rect);
+    m_cr = cr;
+}
+
+bool Screen::direct_render_requested() const
+{
+    static int value = 0;
+    if (value == 0)
+    {
+        if (std::getenv("EGT_DIRECT_RENDER") && strlen(std::getenv("EGT_DIRECT_RENDER")))
+            value += 1;
+        else
+            value -= 1;
+    }
+    return value == 1;
 }
 
 static inline bool no_composition_buffer()
@@ -428,6 +677,8 @@ void Screen::init(void** ptr, uint32_t count, const Size& size, PixelFormat form
         f = CAIRO_FORMAT_ARGB32;
 
     m_buffers.clear();
+    m_history.clear();
+    m_direct = false;
 
     if (count == 1 && no_composition_buffer())
     {
@@ -448,19 +699,45 @@ void Screen::init(void** ptr, uint32_t count, const Size& size, PixelFormat form
                                                     size.width(), size.height(),
                                                     cairo_format_stride_for_width(f, size.width())));
 
-            m_buffers.back().damage.emplace_back(Point(), size);
+            m_buffers.back().damage.add(Rect(Point(), size));
         }
 
-        m_surface = shared_cairo_surface_t(cairo_image_surface_create(f, size.width(), size.height()),
-                                           cairo_surface_destroy);
+        if (count > 1 && direct_render_requested())
+        {
+            // draw straight into the buffers, no composition surface
+            m_direct = true;
+            m_history.resize(count);
+            m_surface.reset();
+            m_cr.reset();
+            select_direct_buffer();
+        }
+        else
+        {
+            m_surface = shared_cairo_surface_t(cairo_image_surface_create(f, size.width(), size.height()),
+                                               cairo_surface_destroy);
+        }
     }
 
     assert(m_surface.get());
 
-    m_cr = shared_cairo_t(cairo_create(m_surface.get()), cairo_destroy);
+    if (!m_direct)
+        m_cr = shared_cairo_t(cairo_create(m_surface.get()), cairo_destroy);
     assert(m_cr);
 
     m_format = format;
+
+    static DefaultDim tile_size_env = -1;
+    if (tile_size_env < 0)
+    {
+        const char* env = std::getenv("EGT_SCREEN_TILE_SIZE");
+        if (env && strlen(env))
+            tile_size_env = std::max<DefaultDim>(std::strtol(env, nullptr, 10), 0);
+        else
+            tile_size_env = 0;
+    }
+
+    if (!m_buffers.empty() && !m_direct)
+        tile_size(m_tile_size ? m_tile_size : tile_size_env);
 }
 
 void Screen::low_fidelity()
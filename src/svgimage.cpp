@@ -4,23 +4,204 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "detail/dump.h"
+#include "detail/egtlog.h"
+#include "detail/fmt.h"
+#include "egt/app.h"
 #include "egt/canvas.h"
-#include "egt/detail/filesystem.h"
+#include "egt/detail/imagecache.h"
 #include "egt/detail/meta.h"
+#include "egt/eventloop.h"
 #include "egt/resource.h"
 #include "egt/respath.h"
 #include "egt/svgimage.h"
 #include <librsvg/rsvg.h>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <sys/stat.h>
 
 namespace egt
 {
 inline namespace v1
 {
 
-struct SvgImage::SvgImpl
+namespace
+{
+
+/**
+ * A parsed SVG, shared by all SvgImage instances with the same URI.
+ *
+ * RsvgHandle is not thread safe, and a document may be rendered by
+ * SvgImage::prerender() on another thread, so every use of the handle must
+ * hold the mutex.
+ */
+struct SvgDocument
 {
+    /// URI and version of the source, identifying the document in caches.
+    std::string key;
     std::shared_ptr<RsvgHandle> rsvg;
     RsvgDimensionData dim{};
+    std::mutex mutex;
+};
+
+/**
+ * The most recently loaded documents.
+ *
+ * SvgImage instances are often created again for the same file, for example
+ * when a Gauge is rebuilt, so a few documents are kept parsed even when no
+ * SvgImage uses them anymore.
+ */
+class DocumentCache
+{
+public:
+
+    std::shared_ptr<SvgDocument> find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto i = m_documents.begin(); i != m_documents.end(); ++i)
+        {
+            if ((*i)->key == key)
+            {
+                m_documents.splice(m_documents.begin(), m_documents, i);
+                return *i;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void add(const std::shared_ptr<SvgDocument>& document)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_documents.push_front(document);
+        if (m_documents.size() > MAX_DOCUMENTS)
+            m_documents.pop_back();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_documents.clear();
+    }
+
+private:
+
+    static constexpr size_t MAX_DOCUMENTS = 8;
+
+    std::mutex m_mutex;
+    std::list<std::shared_ptr<SvgDocument>> m_documents;
+};
+
+DocumentCache& document_cache()
+{
+    static DocumentCache cache;
+    return cache;
+}
+
+/*
+ * Document cache key of a source.  A file is known by its modification time
+ * and size, which are cheap to get, and a resource by a hash of its data,
+ * which is cheap next to parsing it.  The URI is ended by a NUL, which it
+ * cannot contain, so a URI never shares a key with another one.
+ */
+std::string document_key(const std::string& uri, const std::string& path,
+                         detail::SchemeType type, const unsigned char* data, size_t len)
+{
+    std::string key = uri;
+    key += '\0';
+
+    if (type == detail::SchemeType::filesystem)
+    {
+        struct stat buf {};
+        if (stat(path.c_str(), &buf))
+            throw std::runtime_error("file not found: " + path);
+
+        key += fmt::format("{}.{}:{}", buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec, buf.st_size);
+    }
+    else
+    {
+        const std::string_view bytes(reinterpret_cast<const char*>(data), len);
+        key += fmt::format("{:x}:{}", std::hash<std::string_view>()(bytes), len);
+    }
+
+    return key;
+}
+
+/*
+ * Image cache key of a rendering.  The scale is part of the size, so the
+ * cache sees every rendering at a scale of 1.  The document key and id are
+ * ended by a NUL, which the id cannot contain, so different pairs never
+ * share a key.
+ */
+std::string cache_key(const SvgDocument& document, const std::string& id,
+                      const SizeF& size, const RectF& rect)
+{
+    std::string key = "svg:";
+    key += document.key;
+    key += '\0';
+    key += id;
+    key += '\0';
+    key += fmt::format("{}x{}:{},{},{}x{}",
+                       size.width(), size.height(),
+                       rect.x(), rect.y(), rect.width(), rect.height());
+    return key;
+}
+
+shared_cairo_surface_t render_document(SvgDocument& document, const SizeF& size,
+                                       const std::string& id, const RectF& rect)
+{
+    auto s = size;
+    if (!rect.empty())
+        s = rect.size();
+
+    Canvas canvas(s);
+    auto cr = canvas.context().get();
+
+    detail::code_timer(false, "render " + id + ": ", [&]()
+    {
+        if (!rect.empty())
+        {
+            cairo_translate(cr,
+                            -rect.x(),
+                            -rect.y());
+
+            cairo_rectangle(cr,
+                            rect.x(),
+                            rect.y(),
+                            rect.width(),
+                            rect.height());
+
+            cairo_clip(cr);
+        }
+
+        const auto scaled = size / SizeF(document.dim.width, document.dim.height);
+        cairo_scale(cr, scaled.width(), scaled.height());
+
+        /* To avoid getting the edge pixels blended with 0 alpha, which would
+         * occur with the default EXTEND_NONE. Use EXTEND_PAD for 1.2 or newer (2)
+         */
+        cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+
+        /* Replace the destination with the source instead of overlaying */
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+
+        std::lock_guard<std::mutex> lock(document.mutex);
+        if (id.empty())
+            rsvg_handle_render_cairo(document.rsvg.get(), cr);
+        else
+            rsvg_handle_render_cairo_sub(document.rsvg.get(), cr, id.c_str());
+
+    });
+
+    return canvas.surface();
+}
+
+}
+
+struct SvgImage::SvgImpl
+{
+    std::shared_ptr<SvgDocument> document;
 };
 
 SvgImage::SvgImage()
@@ -40,12 +221,75 @@ SvgImage::SvgImage(const std::string& uri, const SizeF& size)
 
 SvgImage::operator Image() const
 {
-    return Image(do_render(), m_uri);
+    return render();
 }
 
 Image SvgImage::render(const std::string& id, const RectF& rect) const
 {
-    return Image(do_render(id, rect), m_uri);
+    if (!m_impl->document)
+        return Image(do_render(id, rect), m_uri);
+
+    auto& cache = detail::image_cache();
+    const auto key = cache_key(*m_impl->document, id, size(), rect);
+
+    auto surface = cache.find(key, 1.0, 1.0, false);
+    if (!surface)
+    {
+        surface = detail::ImageCache::convert_opaque(do_render(id, rect),
+                  cache.native_format());
+        cache.add(key, surface, 1.0, 1.0, false);
+    }
+
+    // the cached rendering is shared, so the caller gets its own pixels
+    Canvas copy(surface, detail::egt_format(cairo_image_surface_get_format(surface.get())));
+    return Image(copy.surface(), m_uri);
+}
+
+void SvgImage::prerender(const std::string& id, const RectF& rect) const
+{
+    if (!m_impl->document)
+        return;
+
+    auto& cache = detail::image_cache();
+    auto key = cache_key(*m_impl->document, id, size(), rect);
+    if (cache.find(key, 1.0, 1.0, false))
+        return;
+
+    // without an event loop to hand the result back to, render it now
+    if (!Application::check_instance())
+    {
+        (void)render(id, rect);
+        return;
+    }
+
+    auto surface = std::make_shared<shared_cairo_surface_t>();
+    Application::instance().event().async_work([document = m_impl->document, size = size(),
+                                                 id, rect, format = cache.native_format(), surface]()
+    {
+        try
+        {
+            *surface = detail::ImageCache::convert_opaque(
+                           render_document(*document, size, id, rect), format);
+        }
+        catch (const std::exception& e)
+        {
+            detail::warn("{}", e.what());
+            return false;
+        }
+
+        return true;
+    },
+    [surface, key = std::move(key)]()
+    {
+        auto& cache = detail::image_cache();
+        if (!cache.find(key, 1.0, 1.0, false))
+            cache.add(key, *surface, 1.0, 1.0, false);
+    });
+}
+
+void SvgImage::clear_cache()
+{
+    document_cache().clear();
 }
 
 RectF SvgImage::id_box(const std::string& id) const
@@ -55,20 +299,23 @@ RectF SvgImage::id_box(const std::string& id) const
     if (id.empty())
         return size();
 
-    if (m_impl->rsvg)
+    if (m_impl->document)
     {
+        auto& document = *m_impl->document;
         auto s = size();
-        auto hfactor = s.width() / m_impl->dim.width;
-        auto vfactor = s.height() / m_impl->dim.height;
+        auto hfactor = s.width() / document.dim.width;
+        auto vfactor = s.height() / document.dim.height;
+
+        std::lock_guard<std::mutex> lock(document.mutex);
 
         RsvgPositionData pos;
-        if (rsvg_handle_get_position_sub(m_impl->rsvg.get(), &pos, id.c_str()))
+        if (rsvg_handle_get_position_sub(document.rsvg.get(), &pos, id.c_str()))
         {
             result.point(PointF(pos.x * hfactor, pos.y * vfactor));
         }
 
         RsvgDimensionData dim{};
-        if (rsvg_handle_get_dimensions_sub(m_impl->rsvg.get(), &dim, id.c_str()))
+        if (rsvg_handle_get_dimensions_sub(document.rsvg.get(), &dim, id.c_str()))
         {
             /*
              * This +1 here in both dimensions is a hack of a workaround.  The
@@ -88,8 +335,11 @@ RectF SvgImage::id_box(const std::string& id) const
 
 bool SvgImage::id_exists(const std::string& id) const
 {
-    if (m_impl->rsvg)
-        return rsvg_handle_has_sub(m_impl->rsvg.get(), id.c_str());
+    if (m_impl->document)
+    {
+        std::lock_guard<std::mutex> lock(m_impl->document->mutex);
+        return rsvg_handle_has_sub(m_impl->document->rsvg.get(), id.c_str());
+    }
 
     return false;
 }
@@ -104,21 +354,23 @@ SizeF SvgImage::size() const
 {
     auto result = m_size;
 
-    if (m_impl->rsvg)
+    if (m_impl->document)
     {
+        const auto& dim = m_impl->document->dim;
+
         if (m_size.width() <= 0 && m_size.height() > 0)
         {
-            auto factor = m_size.height() / m_impl->dim.height;
-            result.width(m_impl->dim.width * factor);
+            auto factor = m_size.height() / dim.height;
+            result.width(dim.width * factor);
         }
         else if (m_size.height() <= 0 && m_size.width() > 0)
         {
-            auto factor = m_size.width() / m_impl->dim.width;
-            result.height(m_impl->dim.height * factor);
+            auto factor = m_size.width() / dim.width;
+            result.height(dim.height * factor);
         }
 
         if (result.empty())
-            result = SizeF(m_impl->dim.width, m_impl->dim.height);
+            result = SizeF(dim.width, dim.height);
     }
 
     return result;
@@ -129,97 +381,69 @@ void SvgImage::load()
     std::string path;
     auto type = detail::resolve_path(m_uri, path);
 
+    std::shared_ptr<const unsigned char> data;
+    size_t len = 0;
+
     switch (type)
     {
     case detail::SchemeType::resource:
     {
-        auto data = ResourceManager::instance().data(path.c_str());
+        data = ResourceManager::instance().share(path.c_str(), len);
         if (!data)
             throw std::runtime_error("resource not found: " + path);
-
-        auto handle = rsvg_handle_new_from_data(data,
-                                                ResourceManager::instance().size(path.c_str()),
-                                                nullptr);
-
-        if (!handle)
-            throw std::runtime_error("unable to load svg resource: " + m_uri);
-
-        m_impl->rsvg = std::shared_ptr<RsvgHandle>(handle,
-        [](RsvgHandle * r) { g_object_unref(r); });
-
-        // this is a somewhat expensive operation, so do it once
-        rsvg_handle_get_dimensions(m_impl->rsvg.get(), &m_impl->dim);
         break;
     }
     case detail::SchemeType::filesystem:
-    {
-        if (!detail::exists(path))
-            throw std::runtime_error("file not found: " + path);
-
-        auto handle = rsvg_handle_new_from_file(path.c_str(), nullptr);
-
-        if (!handle)
-            throw std::runtime_error("unable to load svg file: " + m_uri);
-
-        m_impl->rsvg = std::shared_ptr<RsvgHandle>(handle,
-        [](RsvgHandle * r) { g_object_unref(r); });
-
-        // this is a somewhat expensive operation, so do it once
-        rsvg_handle_get_dimensions(m_impl->rsvg.get(), &m_impl->dim);
         break;
-    }
     default:
     {
         throw std::runtime_error("unsupported uri: " + m_uri);
     }
     }
-}
 
-shared_cairo_surface_t SvgImage::do_render(const std::string& id, const RectF& rect) const
-{
-    auto s = size();
-    if (!rect.empty())
-        s = rect.size();
+    // a changed file or resource is parsed again
+    auto key = document_key(m_uri, path, type, data.get(), len);
+    m_impl->document = document_cache().find(key);
+    if (m_impl->document)
+        return;
 
-    Canvas canvas(s);
-    auto cr = canvas.context().get();
+    RsvgHandle* handle = nullptr;
 
-    detail::code_timer(false, "render " + id + ": ", [&]()
+    if (type == detail::SchemeType::resource)
     {
-        if (!rect.empty())
-        {
-            cairo_translate(cr,
-                            -rect.x(),
-                            -rect.y());
+        handle = rsvg_handle_new_from_data(data.get(), len, nullptr);
 
-            cairo_rectangle(cr,
-                            rect.x(),
-                            rect.y(),
-                            rect.width(),
-                            rect.height());
+        if (!handle)
+            throw std::runtime_error("unable to load svg resource: " + m_uri);
+    }
+    else
+    {
+        handle = rsvg_handle_new_from_file(path.c_str(), nullptr);
 
-            cairo_clip(cr);
-        }
+        if (!handle)
+            throw std::runtime_error("unable to load svg file: " + m_uri);
+    }
 
-        const auto scaled = size() / SizeF(m_impl->dim.width, m_impl->dim.height);
-        cairo_scale(cr, scaled.width(), scaled.height());
+    auto document = std::make_shared<SvgDocument>();
+    document->key = std::move(key);
+    document->rsvg = std::shared_ptr<RsvgHandle>(handle,
+    [](RsvgHandle * r) { g_object_unref(r); });
 
-        /* To avoid getting the edge pixels blended with 0 alpha, which would
-         * occur with the default EXTEND_NONE. Use EXTEND_PAD for 1.2 or newer (2)
-         */
-        cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+    // this is a somewhat expensive operation, so do it once
+    rsvg_handle_get_dimensions(document->rsvg.get(), &document->dim);
 
-        /* Replace the destination with the source instead of overlaying */
-        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    EGTLOG_DEBUG("loaded svg {}", m_uri);
 
-        if (id.empty())
-            rsvg_handle_render_cairo(m_impl->rsvg.get(), cr);
-        else
-            rsvg_handle_render_cairo_sub(m_impl->rsvg.get(), cr, id.c_str());
+    document_cache().add(document);
+    m_impl->document = std::move(document);
+}
 
-    });
+shared_cairo_surface_t SvgImage::do_render(const std::string& id, const RectF& rect) const
+{
+    if (!m_impl->document)
+        return Canvas(size()).surface();
 
-    return canvas.surface();
+    return render_document(*m_impl->document, size(), id, rect);
 }
 
 SvgImage::SvgImage(SvgImage&&) noexcept = default;
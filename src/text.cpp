@@ -10,6 +10,7 @@
 #include "detail/utf8text.h"
 #include "egt/detail/alignment.h"
 #include "egt/detail/enum.h"
+#include "egt/detail/glyphcache.h"
 #include "egt/detail/layout.h"
 #include "egt/detail/string.h"
 #include "egt/frame.h"
@@ -37,7 +38,7 @@ TextRect& TextRect::consolidate(const TextRect& r, cairo_t* cr) noexcept
 {
     m_text += r.m_text;
     m_rect.width(m_rect.width() + r.m_rect.width());
-    cairo_text_extents(cr, m_text.c_str(), &m_te);
+    detail::GlyphCache::get(cr).extents(m_text, m_te);
     return *this;
 }
 
@@ -49,11 +50,13 @@ TextRect TextRect::split(size_t pos, cairo_t* cr) noexcept
     std::string head_text(m_text.begin(), it);
     std::string tail_text(it, m_text.end());
 
+    auto& glyphs = detail::GlyphCache::get(cr);
+
     cairo_text_extents_t head_te;
-    cairo_text_extents(cr, head_text.c_str(), &head_te);
+    glyphs.extents(head_text, head_te);
 
     cairo_text_extents_t tail_te;
-    cairo_text_extents(cr, tail_text.c_str(), &tail_te);
+    glyphs.extents(tail_text, tail_te);
 
     /*
      * Fix a former rounding issue when computing:
@@ -79,6 +82,14 @@ TextRect TextRect::split(size_t pos, cairo_t* cr) noexcept
 }
 
 void TextBox::tokenize(TextRects& rects)
+{
+    tokenize(rects, m_text.cbegin(), m_text.cend(), false);
+}
+
+void TextBox::tokenize(TextRects& rects,
+                       std::string::const_iterator begin,
+                       std::string::const_iterator end,
+                       bool line_break)
 {
     cairo_t* cr = context();
     cairo_font_extents_t fe;
@@ -88,23 +99,23 @@ void TextBox::tokenize(TextRects& rects)
     static const std::string delimiters = " \t\n\r";
     std::vector<std::string> tokens;
 
-    tokens.reserve(m_text.length());
+    tokens.reserve(end - begin);
 
     bool multiline = text_flags().is_set(TextBox::TextFlag::multiline);
     if (multiline && text_flags().is_set(TextBox::TextFlag::word_wrap))
     {
-        detail::tokenize_with_delimiters(m_text.cbegin(),
-                                         m_text.cend(),
+        detail::tokenize_with_delimiters(begin,
+                                         end,
                                          delimiters.cbegin(),
                                          delimiters.cend(),
                                          tokens);
     }
     else
     {
-        for (detail::utf8_const_iterator ch(m_text.begin(), m_text.begin(), m_text.end());
-             ch != detail::utf8_const_iterator(m_text.end(), m_text.begin(), m_text.end()); ++ch)
+        for (detail::utf8_const_iterator ch(begin, begin, end);
+             ch != detail::utf8_const_iterator(end, begin, end); ++ch)
         {
-            auto t = detail::utf8_char_to_string(ch.base(), m_text.cend());
+            auto t = detail::utf8_char_to_string(ch.base(), end);
 
             if (!multiline && t == "\n")
                 break;
@@ -113,8 +124,12 @@ void TextBox::tokenize(TextRects& rects)
         }
     }
 
+    auto& glyphs = detail::GlyphCache::get(cr);
+
     uint32_t default_behave = 0;
     uint32_t behave = default_behave;
+    if (line_break)
+        behave |= LAY_BREAK;
 
     bool empty_line = true;
     for (const auto& t : tokens)
@@ -137,7 +152,7 @@ void TextBox::tokenize(TextRects& rects)
         }
         else
         {
-            cairo_text_extents(cr, t.c_str(), &te);
+            glyphs.extents(t, te);
             rects.emplace_back(behave, Rect(0, 0, te.x_advance, fe.height), t, te);
             behave = default_behave;
             empty_line = false;
@@ -146,6 +161,11 @@ void TextBox::tokenize(TextRects& rects)
 }
 
 void TextBox::compute_layout(TextRects& rects)
+{
+    compute_layout(rects, text_boundaries().y());
+}
+
+void TextBox::compute_layout(TextRects& rects, DefaultDim top)
 {
     const auto boundaries = text_boundaries();
     lay_context ctx;
@@ -183,7 +203,7 @@ void TextBox::compute_layout(TextRects& rects)
 
     lay_run_context(&ctx);
 
-    DefaultDim line_y = boundaries.y() - 1;
+    DefaultDim line_y = top - 1;
     bool next_is_beginning_of_line = true;
 
     auto it = rects.begin();
@@ -192,7 +212,7 @@ void TextBox::compute_layout(TextRects& rects)
     {
         lay_vec4 r = lay_get_rect(&ctx, child);
         auto x = boundaries.x() + r[0];
-        auto y = boundaries.y() + r[1];
+        auto y = top + r[1];
         it->point(Point(x, y));
         x += it->rect().width();
 
@@ -702,6 +722,246 @@ void TextBox::prepare_text(TextRects& rects)
     tokenize(rects);
     compute_layout(rects);
     set_selection(rects);
+
+    m_layout_boundaries = text_boundaries();
+    m_layout_font.reset(cairo_scaled_font_reference(font().scaled_font()),
+                        cairo_scaled_font_destroy);
+    m_layout_align = text_align();
+    m_layout_flags = text_flags();
+    m_breaks_laid_out = false;
+}
+
+void TextBox::index_text()
+{
+    m_length = 0;
+    m_breaks.clear();
+    m_breaks_laid_out = false;
+
+    const auto begin = m_text.cbegin();
+    const auto end = m_text.cend();
+    for (detail::utf8_const_iterator ch(begin, begin, end);
+         ch != detail::utf8_const_iterator(end, begin, end); ++ch, ++m_length)
+    {
+        if (*ch == '\n')
+            m_breaks.push_back({m_length, static_cast<size_t>(ch.base() - begin), m_rects.end()});
+    }
+}
+
+void TextBox::index_insert(size_t pos, size_t byte, size_t len, size_t bytes)
+{
+    auto it = break_at(pos);
+    for (auto b = it; b != m_breaks.end(); ++b)
+    {
+        b->pos += len;
+        b->byte += bytes;
+    }
+
+    std::vector<LineBreak> breaks;
+    const auto begin = m_text.cbegin() + byte;
+    const auto end = begin + bytes;
+    for (detail::utf8_const_iterator ch(begin, begin, end);
+         ch != detail::utf8_const_iterator(end, begin, end); ++ch, ++pos)
+    {
+        if (*ch == '\n')
+            breaks.push_back({pos, static_cast<size_t>(ch.base() - m_text.cbegin()), m_rects.end()});
+    }
+
+    m_breaks.insert(it, breaks.begin(), breaks.end());
+    m_length += len;
+}
+
+void TextBox::index_erase(size_t pos, size_t len, size_t bytes)
+{
+    const auto first = break_at(pos);
+    const auto last = break_at(pos + len);
+    for (auto b = last; b != m_breaks.end(); ++b)
+    {
+        b->pos -= len;
+        b->byte -= bytes;
+    }
+
+    m_breaks.erase(first, last);
+    m_length -= len;
+}
+
+void TextBox::index_break_rects()
+{
+    auto b = m_breaks.begin();
+    for (auto it = m_rects.begin(); it != m_rects.end(); ++it)
+    {
+        if (it->text() == "\n")
+        {
+            if (b == m_breaks.end())
+            {
+                m_breaks_laid_out = false;
+                return;
+            }
+
+            (b++)->rect = it;
+        }
+    }
+
+    m_breaks_laid_out = b == m_breaks.end();
+}
+
+std::vector<TextBox::LineBreak>::iterator TextBox::break_at(size_t pos)
+{
+    return std::lower_bound(m_breaks.begin(), m_breaks.end(), pos,
+                            [](const LineBreak & b, size_t p) { return b.pos < p; });
+}
+
+size_t TextBox::byte_offset(size_t pos) const
+{
+    auto it = std::lower_bound(m_breaks.cbegin(), m_breaks.cend(), pos,
+                               [](const LineBreak & b, size_t p) { return b.pos < p; });
+
+    // walk from the start of the paragraph
+    auto i = m_text.cbegin();
+    if (it != m_breaks.cbegin())
+    {
+        --it;
+        i += it->byte + 1;
+        pos -= it->pos + 1;
+    }
+
+    utf8::advance(i, pos, m_text.cend());
+    return i - m_text.cbegin();
+}
+
+bool TextBox::relayout_text(size_t pos, size_t inserted)
+{
+    /*
+     * Paragraphs can only be laid out on their own when their lines fill the
+     * width of the text boundaries and start from their top.
+     */
+    if (!text_flags().is_set(TextFlag::multiline) ||
+        !text_align().is_set(AlignFlag::expand_horizontal) ||
+        !(text_align().is_set(AlignFlag::expand_vertical) ||
+          text_align().is_set(AlignFlag::top)) ||
+        m_select_len)
+        return false;
+
+    const auto boundaries = text_boundaries();
+    if (m_layout_font.get() != font().scaled_font() ||
+        m_layout_boundaries != boundaries ||
+        m_layout_align != text_align() ||
+        m_layout_flags != text_flags())
+        return false;
+
+    if (!m_breaks_laid_out)
+        return false;
+
+    /*
+     * The edited paragraphs start after the "\n" before pos, and end with the
+     * first "\n" after the inserted text, if any.
+     */
+    const auto first_break = break_at(pos);
+    const auto last_break = break_at(pos + inserted);
+
+    auto first = m_rects.begin();
+    size_t first_byte = 0;
+    if (first_break != m_breaks.begin())
+    {
+        const auto& b = *std::prev(first_break);
+        first = std::next(b.rect);
+        first_byte = b.byte + 1;
+    }
+
+    auto last = m_rects.end();
+    auto last_byte = m_text.size();
+    auto end_break = last_break;
+    if (last_break != m_breaks.end())
+    {
+        last = std::next(last_break->rect);
+        last_byte = last_break->byte + 1;
+        ++end_break;
+    }
+
+    cairo_set_scaled_font(context(), font().scaled_font());
+
+    // a paragraph starts on the line after the "\n" ending the previous one
+    auto top = boundaries.y();
+    if (first != m_rects.begin())
+    {
+        const auto& r = std::prev(first)->rect();
+        top = r.y() + r.height();
+    }
+
+    TextRects rects;
+    tokenize(rects,
+             m_text.cbegin() + first_byte,
+             m_text.cbegin() + last_byte,
+             first_byte > 0);
+    compute_layout(rects, top);
+
+    const auto terminated = last != m_rects.end();
+    DefaultDim old_bottom = 0;
+    if (terminated)
+        old_bottom = std::prev(last)->rect().y();
+
+    TextRects prev;
+    prev.splice(prev.end(), m_rects, first, last);
+    tag_text(prev, rects);
+
+    if (terminated && !rects.empty())
+    {
+        // move the following paragraphs by the number of lines added or removed
+        const auto& r = rects.back().rect();
+        const auto delta = r.y() - old_bottom;
+        if (delta)
+        {
+            for (auto it = last; it != m_rects.end(); ++it)
+                it->point(it->rect().point() + Point(0, delta));
+
+            const auto y = std::min(old_bottom, r.y()) + r.height();
+            const auto area = text_area();
+            if (y < area.bottom())
+                damage_text(Rect(area.x(), y, area.width(), area.bottom() - y));
+        }
+    }
+
+    // the TextRects stay valid once spliced into m_rects
+    auto b = first_break;
+    for (auto it = rects.begin(); it != rects.end(); ++it)
+    {
+        if (it->text() == "\n")
+        {
+            if (b == end_break)
+            {
+                m_breaks_laid_out = false;
+                break;
+            }
+
+            (b++)->rect = it;
+        }
+    }
+    if (b != end_break)
+        m_breaks_laid_out = false;
+
+    m_rects.splice(last, rects);
+
+    return true;
+}
+
+bool TextBox::move_text()
+{
+    const auto boundaries = text_boundaries();
+    if (m_layout_font.get() != font().scaled_font() ||
+        m_layout_boundaries.size() != boundaries.size() ||
+        m_layout_align != text_align() ||
+        m_layout_flags != text_flags())
+        return false;
+
+    const auto delta = boundaries.point() - m_layout_boundaries.point();
+    if (delta != Point())
+    {
+        for (auto& r : m_rects)
+            r.point(r.rect().point() + delta);
+    }
+
+    m_layout_boundaries = boundaries;
+
+    return true;
 }
 
 constexpr static auto CURSOR_WIDTH = 2;
@@ -758,13 +1018,11 @@ void TextBox::get_cursor_rect()
 
         auto it = r.text().begin();
         utf8::advance(it, m_cursor_pos - pos, r.text().end());
-        std::string str(r.text().begin(), it);
-
-        cairo_text_extents_t te;
-        cairo_text_extents(cr, str.c_str(), &te);
+        const auto advance = detail::GlyphCache::get(cr).advance(r.text().data(),
+                             r.text().data() + (it - r.text().begin()));
 
         p = r.rect().point();
-        p.x(p.x() + te.x_advance - CURSOR_X_MARGIN);
+        p.x(p.x() + advance - CURSOR_X_MARGIN);
         break;
     }
 
@@ -809,7 +1067,8 @@ void TextBox::init_sliders()
     auto redraw = [this]()
     {
         damage();
-        prepare_text(m_rects);
+        if (!move_text())
+            prepare_text(m_rects);
         get_cursor_rect();
         invalidate_text_rect();
     };
@@ -1103,6 +1362,9 @@ TextBox::TextBox(Serializer::Properties& props, bool is_derived) noexcept
       m_canvas(Size(1, 1)),
       m_cr(m_canvas.context().get())
 {
+    // the text was set by TextWidget
+    index_text();
+
     initialize(false);
 
     deserialize(props);
@@ -1318,7 +1580,7 @@ void TextBox::handle_key(const Key& key)
     /// NOLINTNEXTLINE(bugprone-branch-clone)
     case EKEY_END:
     {
-        auto eol = key.state.is_set(Key::KeyMod::control) ? detail::utf8len(m_text) : end_of_line();
+        auto eol = key.state.is_set(Key::KeyMod::control) ? m_length : end_of_line();
         if (key.state.is_set(Key::KeyMod::shift))
         {
             selection_move(eol - selection_cursor());
@@ -1435,6 +1697,9 @@ void TextBox::text(const std::string& str)
 void TextBox::clear()
 {
     m_rects.clear();
+    m_length = 0;
+    m_breaks.clear();
+    m_breaks_laid_out = false;
     selection_clear();
     cursor_begin();
     TextWidget::clear();
@@ -1449,12 +1714,12 @@ void TextBox::max_length(size_t len)
     {
         if (m_max_len)
         {
-            const auto length = detail::utf8len(m_text);
-            if (length > m_max_len)
+            if (m_length > m_max_len)
             {
-                auto i = m_text.begin();
-                utf8::advance(i, m_max_len, m_text.end());
-                m_text.erase(i, m_text.end());
+                m_text.erase(byte_offset(m_max_len));
+                index_text();
+                // m_rects no longer match the text
+                m_layout_font.reset();
                 on_text_changed.invoke();
             }
         }
@@ -1463,6 +1728,11 @@ void TextBox::max_length(size_t len)
     }
 }
 
+size_t TextBox::len() const
+{
+    return m_length;
+}
+
 size_t TextBox::append(const std::string& str)
 {
     cursor_end();
@@ -1474,18 +1744,17 @@ size_t TextBox::width_to_len(const std::string& str) const
     const auto b = text_area();
 
     cairo_set_scaled_font(context(), font().scaled_font());
+    auto& glyphs = detail::GlyphCache::get(context());
 
     size_t len = 0;
     float total = 0;
     for (detail::utf8_const_iterator ch(str.begin(), str.begin(), str.end());
          ch != detail::utf8_const_iterator(str.end(), str.begin(), str.end()); ++ch)
     {
-        const auto txt = detail::utf8_char_to_string(ch.base(), str.cend());
-        cairo_text_extents_t te;
-        cairo_text_extents(context(), txt.c_str(), &te);
-        if (total + static_cast<float>(te.x_advance) > b.width())
+        const auto advance = static_cast<float>(glyphs.advance(*ch));
+        if (total + advance > b.width())
             return len;
-        total += static_cast<float>(te.x_advance);
+        total += advance;
         len++;
     }
 
@@ -1497,7 +1766,7 @@ size_t TextBox::insert(const std::string& str)
     if (str.empty())
         return 0;
 
-    const auto current_len = detail::utf8len(m_text);
+    const auto current_len = m_length;
     auto len = detail::utf8len(str);
 
     if (m_max_len)
@@ -1534,20 +1803,26 @@ size_t TextBox::insert(const std::string& str)
 
     if (len > 0)
     {
+        selection_clear();
+        if (!m_breaks_laid_out)
+            index_break_rects();
+
         // insert at cursor position
-        auto i = m_text.begin();
-        utf8::advance(i, m_cursor_pos, m_text.end());
+        const auto byte = byte_offset(m_cursor_pos);
         auto end = str.begin();
         utf8::advance(end, len, str.end());
-        m_text.insert(i, str.begin(), end);
-        selection_clear();
+        m_text.insert(m_text.begin() + byte, str.begin(), end);
+        index_insert(m_cursor_pos, byte, len, end - str.begin());
 
-        on_text_changed.invoke();
+        if (!relayout_text(m_cursor_pos, len))
+        {
+            TextRects rects;
+            prepare_text(rects);
+            tag_text(m_rects, rects);
+            m_rects = std::move(rects);
+        }
 
-        TextRects rects;
-        prepare_text(rects);
-        tag_text(m_rects, rects);
-        m_rects = std::move(rects);
+        on_text_changed.invoke();
 
         cursor_forward(len);
         continue_show_cursor();
@@ -1572,7 +1847,7 @@ void TextBox::cursor_begin()
 void TextBox::cursor_end()
 {
     // one past end
-    cursor_set(detail::utf8len(m_text));
+    cursor_set(m_length);
 }
 
 void TextBox::cursor_forward(size_t count)
@@ -1595,7 +1870,7 @@ void TextBox::cursor_set(size_t pos)
 
 void TextBox::cursor_set(size_t pos, bool save_column)
 {
-    const auto len = detail::utf8len(m_text);
+    const auto len = m_length;
     if (pos > len)
         pos = len;
 
@@ -1618,7 +1893,7 @@ void TextBox::change_cursor(size_t pos, bool save_column)
 
 void TextBox::selection_all()
 {
-    selection(0, detail::utf8len(m_text));
+    selection(0, m_length);
 }
 
 void TextBox::selection_damage()
@@ -1630,19 +1905,16 @@ void TextBox::selection_damage()
     set_selection(rects);
     tag_text_selection(m_rects, rects);
     m_rects = std::move(rects);
+    m_breaks_laid_out = false;
 }
 
 void TextBox::selection(size_t pos, size_t length)
 {
-    const auto len = detail::utf8len(m_text);
-    if (pos > len)
-        pos = len;
+    if (pos > m_length)
+        pos = m_length;
 
-    auto i = m_text.begin();
-    utf8::advance(i, pos, m_text.end());
-    size_t d = utf8::distance(i, m_text.end());
-    if (length > d)
-        length = d;
+    if (length > m_length - pos)
+        length = m_length - pos;
 
     if (pos != m_select_start || length != m_select_len)
     {
@@ -1680,7 +1952,7 @@ void TextBox::selection_move(size_t count, bool save_column)
 
     auto a = m_select_origin;
     auto b = selection_cursor() + count;
-    auto len = detail::utf8len(m_text);
+    auto len = m_length;
 
     auto start = std::min(std::max(std::min(a, b), (size_t)0), len);
     auto end = std::min(std::max(std::max(a, b), (size_t)0), len);
@@ -1734,19 +2006,27 @@ void TextBox::selection_delete()
 {
     if (m_select_len)
     {
-        auto i = m_text.begin();
-        utf8::advance(i, m_select_start, m_text.end());
-        auto l = i;
-        utf8::advance(l, m_select_len, m_text.end());
-
-        m_text.erase(i, l);
+        const auto removed = m_select_len;
         selection_clear();
-        on_text_changed.invoke();
+        if (!m_breaks_laid_out)
+            index_break_rects();
 
-        TextRects rects;
-        prepare_text(rects);
-        tag_text(m_rects, rects);
-        m_rects = std::move(rects);
+        const auto byte = byte_offset(m_select_start);
+        auto l = m_text.cbegin() + byte;
+        utf8::advance(l, removed, m_text.cend());
+        const auto bytes = static_cast<size_t>(l - m_text.cbegin()) - byte;
+        m_text.erase(byte, bytes);
+        index_erase(m_select_start, removed, bytes);
+
+        if (!relayout_text(m_select_start, 0))
+        {
+            TextRects rects;
+            prepare_text(rects);
+            tag_text(m_rects, rects);
+            m_rects = std::move(rects);
+        }
+
+        on_text_changed.invoke();
 
         cursor_set(m_select_start);
         invalidate_text_rect();
@@ -1856,20 +2136,22 @@ size_t TextBox::point2pos(const Point& p) const
 
         auto* cr = context();
         cairo_set_scaled_font(cr, font().scaled_font());
-        for (size_t len = r.length(); len > 0; --len)
+        auto& glyphs = detail::GlyphCache::get(cr);
+
+        // advances are not negative, so the longest fitting head is found
+        // by adding them up
+        const auto& text = r.text();
+        double advance = 0;
+        size_t len = 0;
+        for (detail::utf8_const_iterator ch(text.begin(), text.begin(), text.end());
+             ch != detail::utf8_const_iterator(text.end(), text.begin(), text.end()); ++ch)
         {
-            auto first = r.text().begin();
-            auto last = first;
-            utf8::advance(last, len, r.text().end());
-            auto text = std::string(first, last);
-            cairo_text_extents_t te;
-            cairo_text_extents(cr, text.c_str(), &te);
-            if (te.x_advance <= delta_x)
-            {
-                pos += len;
+            advance += glyphs.advance(*ch);
+            if (advance > delta_x)
                 break;
-            }
+            ++len;
         }
+        pos += len;
     }
 
     return pos;
@@ -1955,7 +2237,7 @@ size_t TextBox::down(size_t cursor_pos) const
 {
     auto eol = end_of_line(cursor_pos);
 
-    if (eol >= detail::utf8len(m_text))
+    if (eol >= m_length)
         return cursor_pos;
 
     auto bol = beginning_of_line(eol + 1);
@@ -5,6 +5,7 @@
  */
 #include "detail/utf8text.h"
 #include "egt/canvas.h"
+#include "egt/detail/textlayout.h"
 #include "egt/painter.h"
 #include "egt/serialize.h"
 #include "egt/textwidget.h"
@@ -140,6 +141,28 @@ Size TextWidget::text_size(const std::string& text) const
     return size;
 }
 
+detail::TextLayout& TextWidget::text_layout() const
+{
+    if (!m_text_layout)
+        m_text_layout = std::make_shared<detail::TextLayout>();
+    return *m_text_layout;
+}
+
+void TextWidget::layout_text(Painter& painter,
+                             const AlignFlags& image_align,
+                             const Size& image_size) const
+{
+    text_layout().layout(painter,
+                         content_area().size(),
+                         text(),
+                         font(),
+                         TextBox::TextFlags({TextBox::TextFlag::multiline, TextBox::TextFlag::word_wrap}),
+                         text_align(),
+                         Justification::middle,
+                         image_align,
+                         image_size);
+}
+
 void TextWidget::serialize(Serializer& serializer) const
 {
     Widget::serialize(serializer);
@@ -26,6 +26,7 @@ void ShamrockTheme::init_draw()
         widget.draw_circle(painter, Palette::ColorId::button_bg, Palette::ColorId::border);
 
         detail::draw_text(painter,
+                          widget.text_layout(),
                           widget.content_area(),
                           widget.text(),
                           widget.font(),
@@ -4,12 +4,16 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "detail/egtlog.h"
+#include "egt/app.h"
 #include "egt/canvas.h"
 #include "egt/detail/alignment.h"
 #include "egt/detail/enum.h"
 #include "egt/detail/math.h"
+#include "egt/detail/rendercache.h"
 #include "egt/detail/string.h"
+#include "egt/eventloop.h"
 #include "egt/frame.h"
+#include "egt/frameclock.h"
 #include "egt/geometry.h"
 #include "egt/image.h"
 #include "egt/input.h"
@@ -18,9 +22,12 @@
 #include "egt/serialize.h"
 #include "egt/types.h"
 #include "egt/widget.h"
+#include <algorithm>
 #include <cassert>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "detail/dump.h"
 
@@ -47,6 +54,9 @@ const std::pair<Widget::Flag, char const*> detail::EnumStrings<Widget::Flag>::da
     {Widget::Flag::component, "component"},
     {Widget::Flag::user_drag, "user_drag"},
     {Widget::Flag::user_track_drag, "user_track_drag"},
+    {Widget::Flag::parallel_paint, "parallel_paint"},
+    {Widget::Flag::cached, "cached"},
+    {Widget::Flag::occlude, "occlude"},
 };
 
 std::ostream& operator<<(std::ostream& os, const Widget::Flags& flags)
@@ -444,12 +454,28 @@ bool Widget::grab_mouse() const
     return flags().is_set(Widget::Flag::grab_mouse);
 }
 
+/*
+ * Widgets that are cached, or semi-transparent and blended from a cached
+ * group, keep a retained rendering in the render cache.
+ */
+static inline bool has_retained_rendering(const Widget& widget)
+{
+    return widget.cached() || !detail::float_equal(widget.alpha(), 1.f);
+}
+
 void Widget::alpha(float alpha)
 {
     alpha = detail::clamp<>(alpha, 0.f, 1.f);
 
     if (detail::change_if_diff<float>(m_alpha, alpha))
-        damage();
+    {
+        if (!has_retained_rendering(*this))
+            detail::render_cache().remove(this);
+
+        // the content did not change, only how it is blended, so keep any
+        // retained rendering of this widget
+        propagate_damage(box());
+    }
 }
 
 void Widget::damage()
@@ -458,6 +484,18 @@ void Widget::damage()
 }
 
 void Widget::damage(const Rect& rect)
+{
+    if (egt_unlikely(rect.empty()))
+        return;
+
+    // damage of children reaches here through damage_from_subordinate()
+    if (has_retained_rendering(*this))
+        detail::render_cache().invalidate(this);
+
+    propagate_damage(rect);
+}
+
+void Widget::propagate_damage(const Rect& rect)
 {
     if (egt_unlikely(rect.empty()))
         return;
@@ -502,6 +540,15 @@ void Widget::add_damage(const Rect& rect)
     auto r = Rect::intersection(rect, to_subordinate(box()));
 
     Screen::damage_algorithm(m_damage, r);
+
+    // damage added by update callbacks is drawn in the same frame, damage
+    // added while painting needs the next one
+    if (Application::check_instance())
+    {
+        auto& clock = Application::instance().event().frame_clock();
+        if (!clock.dispatching() || clock.painting())
+            clock.request_frame();
+    }
 }
 
 Palette::GroupId Widget::group() const
@@ -1245,6 +1292,9 @@ Widget::~Widget() noexcept
 
     if (detail::dragged() == this)
         detail::dragged(nullptr);
+
+    if (has_retained_rendering(*this))
+        detail::render_cache().remove(this);
 }
 
 void Widget::set_parent(Widget* parent)
@@ -1339,6 +1389,91 @@ void Widget::on_screen_resized()
     }
 }
 
+bool Widget::opaque() const
+{
+    // what the widget draws is unknown unless it says so
+    if (!occlude() || !visible() || !detail::float_equal(alpha(), 1.f))
+        return false;
+
+    // these leave part of the box uncovered
+    if (margin() || !detail::float_equal(border_radius(), 0.f) || background(group(), true))
+        return false;
+
+    const auto& type = fill_flags();
+
+    // a border is drawn around a smaller fill, all sides have to be drawn
+    if (border() && (!border_flags().empty() || !type.is_set(Theme::FillFlag::solid)))
+        return false;
+
+    // a solid fill replaces whatever is below, even with a transparent color
+    if (type.is_set(Theme::FillFlag::solid))
+        return true;
+
+    if (type.is_set(Theme::FillFlag::blend))
+    {
+        const auto& bg = color(Palette::ColorId::bg);
+        return bg.type() == Pattern::Type::solid && bg.solid().alpha() == 255;
+    }
+
+    return false;
+}
+
+namespace
+{
+
+/*
+ * Occlusion culling state of one Widget::draw() call.
+ *
+ * Drawing happens every frame, so instead of allocating this in every call,
+ * there is one per level of the widget tree, per thread, and they keep their
+ * storage from frame to frame.
+ */
+struct DrawScratch
+{
+    std::vector<Region> visible;
+    Region covered;
+    Region remaining;
+};
+
+class DrawScratchLevel
+{
+public:
+    DrawScratchLevel()
+    {
+        if (depth() == levels().size())
+            levels().emplace_back(new DrawScratch);
+        m_scratch = levels()[depth()++].get();
+    }
+
+    DrawScratchLevel(const DrawScratchLevel&) = delete;
+    DrawScratchLevel& operator=(const DrawScratchLevel&) = delete;
+
+    DrawScratch& operator*() const { return *m_scratch; }
+
+    ~DrawScratchLevel()
+    {
+        --depth();
+    }
+
+private:
+
+    static std::vector<std::unique_ptr<DrawScratch>>& levels()
+    {
+        thread_local std::vector<std::unique_ptr<DrawScratch>> value;
+        return value;
+    }
+
+    static size_t& depth()
+    {
+        thread_local size_t value = 0;
+        return value;
+    }
+
+    DrawScratch* m_scratch;
+};
+
+}
+
 void Widget::draw(Painter& painter, const Rect& rect)
 {
     EGTLOG_TRACE("{} draw {}", name(), rect);
@@ -1354,53 +1489,43 @@ void Widget::draw(Painter& painter, const Rect& rect)
         painter.clip();
     }
 
-    // draw our widget box, but now that the physical origin has possibly changed
-    // and our box() is relative to our parent, we have to adjust to our local
-    // origin
-    if (!fill_flags().empty() || border())
-    {
-        draw_box(painter, Palette::ColorId::bg, Palette::ColorId::border);
-    }
-    else if (Application::instance().is_composer())
-    {
-        constexpr static Color composer_border = Palette::black;
-        constexpr static Color composer_bg = Color(0x00000020);
-
-        theme().draw_box(painter,
-        {Theme::FillFlag::blend},
-        box(),
-        composer_border,
-        composer_bg,
-        1,
-        0,
-        0,
-        {});
-    }
-
-    if (m_subordinates.empty())
-        return;
-
-    // child rect
-    auto crect = rect;
-
     // if this widget does not have a screen, it means the damage rect is in
     // coordinates of some parent widget, so we have to adjust the physical origin
     // and take it into account when looking at children, who's coordinates are
     // respective of this widget
+    Point origin;
     if (!has_screen())
+        origin = point();
+
+    // child rect, kept inside our content area
+    auto crect = Rect::intersection(rect - origin, to_subordinate(content_area()));
+
+    // front to back, find what is left visible of the damage after removing
+    // every opaque subordinate
+    DrawScratchLevel scratch;
+    auto& visible = (*scratch).visible;
+    auto& covered = (*scratch).covered;
+    const bool culled = occlusion_cull(crect, visible, covered, (*scratch).remaining);
+    if (culled)
     {
-        const auto& origin = point();
-        painter.translate(origin);
-
-        // adjust our child rect for comparison's below
-        crect -= origin;
+        covered.translate(origin);
+        draw_own_box(painter, rect, &covered);
     }
+    else
+    {
+        draw_own_box(painter, rect, nullptr);
+    }
+
+    if (m_subordinates.empty())
+        return;
 
-    // keep the crect inside our content area
-    crect = Rect::intersection(crect, to_subordinate(content_area()));
+    painter.translate(origin);
 
+    size_t index = 0;
     for (auto& subordinate : m_subordinates)
     {
+        const auto i = index++;
+
         if (!subordinate->visible())
             continue;
 
@@ -1409,21 +1534,242 @@ void Widget::draw(Painter& painter, const Rect& rect)
         if (subordinate->plane_window())
             continue;
 
-        draw_subordinate(painter, crect, subordinate.get());
+        if (!culled)
+        {
+            draw_subordinate(painter, crect, subordinate.get());
+            continue;
+        }
+
+        for (const auto& r : visible[i])
+            draw_subordinate(painter, r, subordinate.get());
     }
 }
 
-static inline bool time_subordinate_draw_enabled()
+void Widget::prepare_draw(Painter& painter)
 {
-    static int value = 0;
-    if (value == 0)
+    for (auto& subordinate : m_subordinates)
     {
-        if (std::getenv("EGT_TIME_DRAW"))
-            value += 1;
-        else
-            value -= 1;
+        if (subordinate->visible() && !subordinate->plane_window())
+            subordinate->prepare_draw(painter);
     }
-    return value == 1;
+}
+
+bool Widget::occlusion_cull(const Rect& crect,
+                            std::vector<Region>& visible,
+                            Region& covered,
+                            Region& remaining) const
+{
+    // drawing is not clipped, or the special callback expects exactly one
+    // draw per child
+    if (!clip() || m_special_child_draw_callback)
+        return false;
+
+    auto covers = [&crect](const std::shared_ptr<Widget>& subordinate)
+    {
+        return subordinate->visible() &&
+               !subordinate->plane_window() &&
+               subordinate->box().intersect(crect) &&
+               subordinate->opaque();
+    };
+
+    if (std::none_of(m_subordinates.begin(), m_subordinates.end(), covers))
+        return false;
+
+    // never shrink, so the storage of every region is kept for the next time
+    if (visible.size() < m_subordinates.size())
+        visible.resize(m_subordinates.size());
+
+    remaining.clear();
+    remaining.add(crect);
+    auto i = m_subordinates.size();
+    for (auto s = m_subordinates.rbegin(); s != m_subordinates.rend(); ++s)
+    {
+        --i;
+        visible[i].clear();
+        if (remaining.empty())
+            continue;
+
+        const auto& box = (*s)->box();
+        if (!(*s)->visible() || (*s)->plane_window() || !remaining.intersects(box))
+            continue;
+
+        visible[i] = remaining;
+        visible[i].intersect(box);
+
+        if (covers(*s))
+            remaining.subtract(box);
+    }
+
+    covered.clear();
+    covered.add(crect);
+    covered.subtract(remaining);
+    return true;
+}
+
+void Widget::draw_own_box(Painter& painter, const Rect& rect, const Region* covered)
+{
+    auto draw = [this, &painter]()
+    {
+        // draw our widget box, but now that the physical origin has possibly changed
+        // and our box() is relative to our parent, we have to adjust to our local
+        // origin
+        if (!fill_flags().empty() || border())
+        {
+            draw_box(painter, Palette::ColorId::bg, Palette::ColorId::border);
+        }
+        else if (Application::instance().is_composer())
+        {
+            constexpr static Color composer_border = Palette::black;
+            constexpr static Color composer_bg = Color(0x00000020);
+
+            theme().draw_box(painter,
+            {Theme::FillFlag::blend},
+            box(),
+            composer_border,
+            composer_bg,
+            1,
+            0,
+            0,
+            {});
+        }
+    };
+
+    if (!covered || covered->empty())
+    {
+        draw();
+        return;
+    }
+
+    // not reentrant, drawing the box does not draw other widgets
+    thread_local Region region;
+    region.clear();
+    region.add(rect);
+    region.subtract(*covered);
+
+    // completely hidden by subordinates
+    if (region.empty())
+        return;
+
+    Painter::AutoSaveRestore sr(painter);
+    for (const auto& r : region)
+        painter.draw(r);
+    painter.clip();
+
+    draw();
+}
+
+void Widget::cached(bool value)
+{
+    if (flags().is_set(Widget::Flag::cached) == value)
+        return;
+
+    if (value)
+    {
+        flags().set(Widget::Flag::cached);
+    }
+    else
+    {
+        flags().clear(Widget::Flag::cached);
+        if (!has_retained_rendering(*this))
+            detail::render_cache().remove(this);
+    }
+}
+
+bool Widget::parallel_paint_tree() const
+{
+    // the render cache is only used from the UI thread
+    if (!parallel_paint() || has_retained_rendering(*this))
+        return false;
+
+    // plane windows are drawn on their own
+    return std::all_of(m_subordinates.begin(), m_subordinates.end(),
+                       [](const std::shared_ptr<Widget>& subordinate)
+    {
+        return !subordinate->visible() ||
+               subordinate->plane_window() ||
+               subordinate->parallel_paint_tree();
+    });
+}
+
+/*
+ * Get the retained rendering of a widget, rendering it first if it is out of
+ * date.  Returns nullptr if the widget could not be cached.
+ */
+static shared_cairo_surface_t retained_surface(Painter& painter, Widget* widget)
+{
+    auto& cache = detail::render_cache();
+    const auto box = widget->box();
+
+    auto entry = cache.get(widget, box.size());
+    if (!entry)
+        return nullptr;
+
+    // hold on to the surface, drawing cached children may release the entry
+    auto surface = entry->surface;
+
+    if (entry->valid)
+    {
+        cache.hit();
+    }
+    else
+    {
+        cache.miss();
+
+        shared_cairo_t cr(cairo_create(surface.get()), cairo_destroy);
+        cairo_set_operator(cr.get(), CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr.get());
+        cairo_set_operator(cr.get(), CAIRO_OPERATOR_OVER);
+
+        cairo_font_options_t* cfo = cairo_font_options_create();
+        cairo_get_font_options(painter.context().get(), cfo);
+        cairo_set_font_options(cr.get(), cfo);
+        cairo_font_options_destroy(cfo);
+        cairo_set_antialias(cr.get(), cairo_get_antialias(painter.context().get()));
+
+        // the widget draws in the coordinates of its parent
+        cairo_translate(cr.get(), -box.x(), -box.y());
+
+        Painter offscreen(cr);
+        widget->draw(offscreen, box);
+        cache.validate(widget);
+    }
+
+    return surface;
+}
+
+/*
+ * Blend part of the retained rendering of a widget.  Returns false if the
+ * widget could not be cached.
+ */
+static bool draw_retained(Painter& painter, const Rect& rect, Widget* widget, float alpha)
+{
+    auto surface = retained_surface(painter, widget);
+    if (!surface)
+        return false;
+
+    const auto& box = widget->box();
+    auto cr = painter.context().get();
+    cairo_save(cr);
+    cairo_set_source_surface(cr, surface.get(), box.x(), box.y());
+    cairo_rectangle(cr, rect.x(), rect.y(), rect.width(), rect.height());
+    if (detail::float_equal(alpha, 1.f))
+    {
+        cairo_fill(cr);
+    }
+    else
+    {
+        cairo_clip(cr);
+        cairo_paint_with_alpha(cr, alpha);
+    }
+    cairo_restore(cr);
+
+    return true;
+}
+
+static void paint_subordinate(Painter& painter, const Rect& rect, Widget* subordinate)
+{
+    if (!subordinate->cached() || !draw_retained(painter, rect, subordinate, 1.f))
+        subordinate->draw(painter, rect);
 }
 
 void Widget::draw_subordinate(Painter& painter, const Rect& crect, Widget* subordinate)
@@ -1447,11 +1793,17 @@ void Widget::draw_subordinate(Painter& painter, const Rect& crect, Widget* subor
                 painter.clip();
             }
 
-            detail::code_timer(time_subordinate_draw_enabled(), subordinate->name() + " draw: ", [subordinate, &painter, &r]()
+            detail::draw_timer([subordinate]() { return subordinate->name() + " draw: "; },
+                               [subordinate, &painter, &r]()
             {
-                subordinate->draw(painter, r);
+                paint_subordinate(painter, r, subordinate);
             });
         }
+        else if (draw_retained(painter, r, subordinate, subordinate->alpha()))
+        {
+            // blended straight from the retained rendering, without pushing
+            // a group and drawing the child into it every time
+        }
         else
         {
             {
@@ -1465,9 +1817,10 @@ void Widget::draw_subordinate(Painter& painter, const Rect& crect, Widget* subor
                     painter.clip();
                 }
 
-                detail::code_timer(time_subordinate_draw_enabled(), subordinate->name() + " draw: ", [subordinate, &painter, &r]()
+                detail::draw_timer([subordinate]() { return subordinate->name() + " draw: "; },
+                                   [subordinate, &painter, &r]()
                 {
-                    subordinate->draw(painter, r);
+                    paint_subordinate(painter, r, subordinate);
                 });
             }
 
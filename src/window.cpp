@@ -9,6 +9,7 @@
 
 #include "detail/egtlog.h"
 #include "detail/dump.h"
+#include "detail/renderpool.h"
 #include "detail/window/basicwindow.h"
 #include "detail/window/planewindow.h"
 #include "egt/app.h"
@@ -21,6 +22,12 @@
 #include "egt/painter.h"
 #include "egt/window.h"
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
 #ifdef SRCDIR
 EGT_EMBED(internal_cursor, SRCDIR "/icons/16px/cursor.png")
@@ -160,17 +167,95 @@ void Window::allocate_screen()
         m_impl->allocate_screen();
 }
 
-static inline bool time_child_draw_enabled()
+static detail::RenderPool* render_pool()
 {
-    static int value = 0;
-    if (value == 0)
+    static std::unique_ptr<detail::RenderPool> pool;
+    static std::once_flag env_flag;
+    std::call_once(env_flag, []()
     {
-        if (std::getenv("EGT_TIME_DRAW"))
-            value += 1;
+        const auto* value = std::getenv("EGT_PARALLEL_RENDER");
+        if (!value || !strlen(value))
+            return;
+
+        long threads = 0;
+        if (std::string(value) == "auto")
+            threads = std::thread::hardware_concurrency();
         else
-            value -= 1;
+            threads = std::strtol(value, nullptr, 10);
+
+        if (threads > 1)
+        {
+            threads = std::min(threads, 16L);
+            detail::info("parallel render ({} threads)", threads);
+            pool = std::make_unique<detail::RenderPool>(threads);
+        }
+    });
+    return pool.get();
+}
+
+// smallest height of a strip a damage rectangle is split into
+static constexpr DefaultDim MIN_RENDER_STRIP = 16;
+
+/*
+ * Split the damage into disjoint rectangles to be drawn by different threads.
+ * A region's rectangles never overlap, and when there are fewer of them than
+ * threads, they are cut into horizontal strips.
+ */
+static void render_tasks(const Region& damage, size_t threads, Region::RectArray& tasks)
+{
+    tasks.clear();
+
+    for (const auto& rect : damage)
+    {
+        DefaultDim strips = 1;
+        if (damage.size() < threads)
+            strips = std::max<DefaultDim>(1, std::min<DefaultDim>(threads, rect.height() / MIN_RENDER_STRIP));
+
+        auto y = rect.top();
+        for (DefaultDim i = 0; i < strips; ++i)
+        {
+            const auto bottom = rect.top() + rect.height() * (i + 1) / strips;
+            tasks.emplace_back(rect.left(), y, rect.width(), bottom - y);
+            y = bottom;
+        }
     }
-    return value == 1;
+}
+
+void Window::parallel_draw(detail::RenderPool& pool, const Region& damage)
+{
+    auto& tasks = m_parallel_tasks;
+    render_tasks(damage, pool.threads(), tasks);
+
+    const auto& context = screen()->context();
+    auto target = cairo_get_target(context.get());
+
+    cairo_font_options_t* cfo = cairo_font_options_create();
+    cairo_get_font_options(context.get(), cfo);
+    const auto antialias = cairo_get_antialias(context.get());
+
+    auto cleanup = detail::on_scope_exit([cfo]() { cairo_font_options_destroy(cfo); });
+
+    // bring what draw() reads up to date, so the threads below only read it
+    {
+        Painter painter(context);
+        prepare_draw(painter);
+    }
+
+    pool.run(tasks.size(), [&](size_t index)
+    {
+        const auto& rect = tasks[index];
+
+        // every thread gets its own context, clipped to its own rectangle of
+        // the shared surface
+        shared_cairo_t cr(cairo_create(target), cairo_destroy);
+        cairo_set_font_options(cr.get(), cfo);
+        cairo_set_antialias(cr.get(), antialias);
+        cairo_rectangle(cr.get(), rect.x(), rect.y(), rect.width(), rect.height());
+        cairo_clip(cr.get());
+
+        Painter painter(cr);
+        draw(painter, rect);
+    });
 }
 
 void Window::do_draw()
@@ -184,12 +269,24 @@ void Window::do_draw()
 
     EGTLOG_TRACE("{} do draw", name());
 
-    detail::code_timer(time_child_draw_enabled(), name() + " draw: ", [this]()
+    detail::draw_timer([this]() { return name() + " draw: "; }, [this]()
     {
-        Painter painter(screen()->context());
+        // when drawing directly into a screen buffer, the damage of the
+        // frames it missed has to be redrawn as well
+        const auto damage = screen()->frame_damage(m_damage);
 
-        for (auto& damage : m_damage)
-            draw(painter, damage);
+        auto pool = render_pool();
+        if (pool && (damage.size() > 1 || damage.extents().height() >= MIN_RENDER_STRIP * 2) &&
+            parallel_paint_tree())
+        {
+            parallel_draw(*pool, damage);
+        }
+        else
+        {
+            Painter painter(screen()->context());
+            for (const auto& rect : damage)
+                draw(painter, rect);
+        }
 
         screen()->flip(m_damage);
         m_damage.clear();
@@ -3,9 +3,49 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include "detail/screen/flipthread.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <egt/detail/glyphcache.h>
+#include <egt/detail/imagecache.h>
+#include <egt/detail/rendercache.h>
+#include <egt/detail/textlayout.h>
 #include <egt/ui>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+/*
+ * Count every allocation made through operator new, so tests can check that a
+ * code path does not allocate.
+ */
+static std::atomic<size_t> allocation_count{0};
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
 
 static constexpr float calculate(float start, float decrement, int count)
 {
@@ -131,6 +171,223 @@ TEST(TextBox, Basic)
     ASSERT_EQ("", text1.text());
 }
 
+TEST(GlyphCache, Basic)
+{
+    egt::Canvas canvas(egt::Size(100, 100));
+    egt::Painter painter(canvas.context());
+    painter.set(egt::Font(20));
+    auto cr = painter.context().get();
+
+    auto& glyphs = egt::detail::GlyphCache::get(cr);
+    EXPECT_EQ(&glyphs, &egt::detail::GlyphCache::get(cr));
+
+    for (const std::string text : {"hello world", "\xc3\xa9t\xc3\xa9 \xe2\x82\xac", " ", ""})
+    {
+        cairo_text_extents_t expected;
+        cairo_text_extents(cr, text.c_str(), &expected);
+
+        cairo_text_extents_t te;
+        glyphs.extents(text, te);
+        EXPECT_NEAR(te.x_advance, expected.x_advance, 0.001);
+        EXPECT_NEAR(te.x_bearing, expected.x_bearing, 0.001);
+        EXPECT_NEAR(te.y_bearing, expected.y_bearing, 0.001);
+        EXPECT_NEAR(te.width, expected.width, 0.001);
+        EXPECT_NEAR(te.height, expected.height, 0.001);
+        EXPECT_NEAR(glyphs.advance(text), expected.x_advance, 0.001);
+    }
+
+    // each code point is measured once
+    EXPECT_EQ(glyphs.size(), 11U);
+    EXPECT_DOUBLE_EQ(glyphs.advance('l'), glyphs.extents('l').x_advance);
+    EXPECT_EQ(glyphs.size(), 11U);
+
+    // invalid UTF-8
+    EXPECT_EQ(glyphs.advance("\xff"), 0);
+}
+
+TEST(Font, Cache)
+{
+    const egt::Font small(egt::Font::DEFAULT_FACE, 12);
+    const egt::Font large(egt::Font::DEFAULT_FACE, 24);
+    ASSERT_NE(small.scaled_font(), nullptr);
+    EXPECT_EQ(small.scaled_font(), egt::Font(egt::Font::DEFAULT_FACE, 12).scaled_font());
+    EXPECT_NE(small.scaled_font(), large.scaled_font());
+
+    // all the sizes of a font share its face
+    EXPECT_EQ(cairo_scaled_font_get_font_face(small.scaled_font()),
+              cairo_scaled_font_get_font_face(large.scaled_font()));
+
+    const egt::Font preloaded(egt::Font::DEFAULT_FACE, 31);
+    egt::Font::preload({preloaded});
+    EXPECT_EQ(egt::detail::GlyphCache::get(preloaded.scaled_font()).size(), 95U);
+}
+
+TEST(TextLayout, Basic)
+{
+    egt::Canvas canvas(egt::Size(200, 100));
+    egt::Painter painter(canvas.context());
+
+    const egt::TextBox::TextFlags flags({egt::TextBox::TextFlag::multiline,
+                                         egt::TextBox::TextFlag::word_wrap});
+    const egt::Font font;
+    const egt::Size size(200, 100);
+
+    egt::detail::TextLayout layout;
+    EXPECT_TRUE(layout.layout(painter, size, "hello world", font, flags,
+                              egt::AlignFlag::center, egt::Justification::middle));
+    EXPECT_EQ(layout.glyph_count(), 11U);
+
+    // nothing changed
+    EXPECT_FALSE(layout.layout(painter, size, "hello world", font, flags,
+                               egt::AlignFlag::center, egt::Justification::middle));
+    EXPECT_EQ(layout.layouts(), 1U);
+
+    EXPECT_TRUE(layout.layout(painter, egt::Size(100, 100), "hello world", font, flags,
+                              egt::AlignFlag::center, egt::Justification::middle));
+    EXPECT_TRUE(layout.layout(painter, size, "hello world", egt::Font(30), flags,
+                              egt::AlignFlag::center, egt::Justification::middle));
+    EXPECT_TRUE(layout.layout(painter, size, "hello\nworld", font, flags,
+                              egt::AlignFlag::center, egt::Justification::middle));
+    EXPECT_EQ(layout.glyph_count(), 10U);
+    EXPECT_EQ(layout.layouts(), 4U);
+
+    layout.clear();
+    EXPECT_TRUE(layout.layout(painter, size, "hello\nworld", font, flags,
+                              egt::AlignFlag::center, egt::Justification::middle));
+
+    // a leading newline puts the text on the second line
+    EXPECT_TRUE(layout.layout(painter, size, "\nhello", font, flags,
+                              egt::AlignFlag::top | egt::AlignFlag::left,
+                              egt::Justification::start));
+    painter.set(font);
+    cairo_font_extents_t fe;
+    cairo_font_extents(painter.context().get(), &fe);
+
+    std::vector<egt::Point> cursors;
+    const auto cursor = [&cursors](const egt::Point & offset, size_t)
+    {
+        cursors.push_back(offset);
+    };
+    layout.draw(painter, egt::Point(), egt::Palette::black, nullptr, cursor, 0);
+    layout.draw(painter, egt::Point(), egt::Palette::black, nullptr, cursor, 1);
+    layout.draw(painter, egt::Point(), egt::Palette::black, nullptr, cursor, 6);
+    ASSERT_EQ(cursors.size(), 3U);
+    EXPECT_EQ(cursors[0].y(), 0);
+    EXPECT_EQ(cursors[1], egt::Point(0, static_cast<egt::DefaultDim>(fe.height)));
+    EXPECT_EQ(cursors[2].y(), static_cast<egt::DefaultDim>(fe.height));
+    EXPECT_GT(cursors[2].x(), 0);
+}
+
+TEST(Label, TextLayout)
+{
+    egt::Application app;
+
+    egt::Label label("label", egt::Rect(0, 0, 100, 40));
+    egt::Canvas canvas(egt::Size(100, 40));
+    egt::Painter painter(canvas.context());
+
+    // unchanged text is not laid out again
+    label.draw(painter, label.box());
+    label.draw(painter, label.box());
+    EXPECT_EQ(label.text_layout().layouts(), 1U);
+
+    label.text("changed");
+    label.draw(painter, label.box());
+    EXPECT_EQ(label.text_layout().layouts(), 2U);
+
+    // laid out before a parallel draw, which then only reads it
+    label.text("prepared");
+    label.prepare_draw(painter);
+    EXPECT_EQ(label.text_layout().layouts(), 3U);
+    label.draw(painter, label.box());
+    EXPECT_EQ(label.text_layout().layouts(), 3U);
+}
+
+namespace
+{
+struct LayoutTextBox : public egt::TextBox
+{
+    using egt::TextBox::TextBox;
+    using egt::TextBox::m_rects;
+
+    // top, left and text of every line
+    static std::string lines(const egt::TextRects& rects)
+    {
+        std::string result;
+        egt::DefaultDim y = -1;
+        for (const auto& r : rects)
+        {
+            if (r.rect().y() != y || result.empty())
+            {
+                y = r.rect().y();
+                result += "|" + std::to_string(y) + "," + std::to_string(r.rect().x()) + ":";
+            }
+            result += r.text();
+        }
+        return result;
+    }
+
+    std::string laid_out() const
+    {
+        return lines(m_rects);
+    }
+
+    std::string prepared()
+    {
+        egt::TextRects rects;
+        prepare_text(rects);
+        return lines(rects);
+    }
+};
+}
+
+TEST(TextBox, Relayout)
+{
+    egt::Application app;
+
+    LayoutTextBox text("", egt::Rect(0, 0, 200, 100), egt::AlignFlag::expand,
+    {egt::TextBox::TextFlag::multiline, egt::TextBox::TextFlag::word_wrap});
+
+    text.append("first line\n");
+    const auto front = &text.m_rects.front();
+
+    for (auto i = 0; i < 20; i++)
+        text.append("log line " + std::to_string(i) + " with enough words to wrap it\n");
+
+    // appending does not lay out the previous lines again
+    EXPECT_EQ(&text.m_rects.front(), front);
+    EXPECT_EQ(text.laid_out(), text.prepared());
+
+    text.cursor_set(5);
+    text.insert(" with more words inserted to wrap it\nand a new line");
+    EXPECT_EQ(text.laid_out(), text.prepared());
+
+    text.selection(3, 60);
+    text.selection_delete();
+    EXPECT_EQ(text.laid_out(), text.prepared());
+
+    text.cursor_end();
+    text.insert("no line break");
+    EXPECT_EQ(text.laid_out(), text.prepared());
+
+    // the length and the line breaks are kept along with multi-byte code points
+    LayoutTextBox small("\xc3\xa9t\xc3\xa9\nhiver", egt::Rect(0, 0, 200, 100), egt::AlignFlag::expand,
+    {egt::TextBox::TextFlag::multiline, egt::TextBox::TextFlag::word_wrap});
+    EXPECT_EQ(small.len(), 9U);
+
+    small.cursor_set(3);
+    small.insert("\n\xe2\x82\xac");
+    EXPECT_EQ(small.len(), 11U);
+    EXPECT_EQ(small.text(), "\xc3\xa9t\xc3\xa9\n\xe2\x82\xac\nhiver");
+    EXPECT_EQ(small.laid_out(), small.prepared());
+
+    small.selection(4, 2);
+    small.selection_delete();
+    EXPECT_EQ(small.len(), 9U);
+    EXPECT_EQ(small.text(), "\xc3\xa9t\xc3\xa9\nhiver");
+    EXPECT_EQ(small.laid_out(), small.prepared());
+}
+
 TEST(TextBoxFixed, Basic)
 {
     egt::Application app;
@@ -172,6 +429,325 @@ TEST(Screen, DamageAlgorithm)
     EXPECT_EQ(damage.front(), egt::Rect(0, 0, 200, 200));
 }
 
+TEST(Screen, DamagePolicy)
+{
+    const auto policy = egt::Screen::damage_policy();
+
+    egt::Screen::damage_policy(egt::Screen::DamagePolicy::exact);
+    egt::Region damage;
+    egt::Screen::damage_algorithm(damage, egt::Rect(0, 0, 10, 10));
+    egt::Screen::damage_algorithm(damage, egt::Rect(790, 470, 10, 10));
+    EXPECT_EQ(damage.size(), 2U);
+    EXPECT_EQ(damage.area(), 200);
+
+    egt::Screen::damage_policy(egt::Screen::DamagePolicy::bounding_box);
+    egt::Screen::damage_algorithm(damage, egt::Rect(0, 0, 10, 10));
+    EXPECT_EQ(damage.size(), 1U);
+    EXPECT_EQ(damage.front(), egt::Rect(0, 0, 800, 480));
+
+    egt::Screen::damage_policy(egt::Screen::DamagePolicy::cost, 0.25f);
+    damage.clear();
+    egt::Screen::damage_algorithm(damage, egt::Rect(0, 0, 10, 10));
+    egt::Screen::damage_algorithm(damage, egt::Rect(5, 5, 10, 10));
+    EXPECT_EQ(damage.size(), 1U);
+    EXPECT_EQ(damage.front(), egt::Rect(0, 0, 15, 15));
+    egt::Screen::damage_algorithm(damage, egt::Rect(790, 470, 10, 10));
+    EXPECT_EQ(damage.size(), 2U);
+
+    // too many rectangles fall back to the bounding box
+    damage.clear();
+    for (auto i = 0; i < 64; ++i)
+        egt::Screen::damage_algorithm(damage, egt::Rect(i * 12, (i % 2) * 100, 2, 2));
+    EXPECT_LE(damage.size(), 32U);
+    EXPECT_TRUE(damage.contains(egt::Rect(0, 0, 2, 2)));
+    EXPECT_TRUE(damage.contains(egt::Rect(756, 100, 2, 2)));
+
+    egt::Screen::damage_policy(policy);
+}
+
+namespace
+{
+/// In-memory screen with several buffers that are flipped in turn.
+class BufferedScreen : public egt::Screen
+{
+public:
+
+    explicit BufferedScreen(uint32_t count, bool direct = false,
+                            const egt::Size& size = egt::Size(100, 100))
+        : m_data(count, std::vector<uint32_t>(size.width() * size.height())),
+          m_direct_requested(direct)
+    {
+        std::vector<void*> ptrs;
+        for (auto& data : m_data)
+            ptrs.push_back(data.data());
+        init(ptrs.data(), count, size);
+    }
+
+    uint32_t index() override { return m_index; }
+
+    void schedule_flip() override
+    {
+        if (rotate)
+            m_index = (m_index + 1) % m_data.size();
+    }
+
+    /// Damage copied to a buffer by the last flip.
+    egt::Region copied;
+
+    /// Move to the next buffer on every flip.
+    bool rotate{true};
+
+protected:
+
+    bool direct_render_requested() const override { return m_direct_requested; }
+
+    void copy_to_buffer(ScreenBuffer& buffer) override
+    {
+        copied = buffer.damage;
+        egt::Screen::copy_to_buffer(buffer);
+    }
+
+    std::vector<std::vector<uint32_t>> m_data;
+    bool m_direct_requested;
+    uint32_t m_index{0};
+};
+}
+
+TEST(Screen, TileDamage)
+{
+    BufferedScreen screen(2);
+    screen.tile_size(32);
+    EXPECT_EQ(screen.tile_size(), 32);
+
+    // buffers never copied to get the whole screen
+    screen.flip(egt::Region(egt::Rect(0, 0, 10, 10)));
+    EXPECT_EQ(screen.copied, egt::Region(screen.box()));
+    screen.flip(egt::Region(egt::Rect(40, 40, 30, 10)));
+    EXPECT_EQ(screen.copied, egt::Region(screen.box()));
+
+    // damage of every frame since the last copy, merged on the tile grid
+    screen.flip(egt::Region(egt::Rect(70, 0, 10, 10)));
+    EXPECT_EQ(screen.copied, egt::Region(egt::Region::RectArray
+    {
+        egt::Rect(64, 0, 32, 32),
+        egt::Rect(32, 32, 64, 32),
+    }));
+
+    // tiles are clipped to the screen
+    screen.flip(egt::Region(egt::Rect(90, 90, 10, 10)));
+    EXPECT_EQ(screen.copied, egt::Region(egt::Region::RectArray
+    {
+        egt::Rect(64, 0, 32, 32),
+        egt::Rect(64, 64, 36, 36),
+    }));
+
+    // changing the tile size damages the whole screen again
+    screen.tile_size(16);
+    screen.flip(egt::Region(egt::Rect(0, 0, 1, 1)));
+    EXPECT_EQ(screen.copied, egt::Region(screen.box()));
+}
+
+TEST(Screen, FrameDamage)
+{
+    BufferedScreen screen(3, true);
+    ASSERT_TRUE(screen.direct_render());
+
+    const egt::Rect a(0, 0, 10, 10);
+    const egt::Rect b(20, 0, 10, 10);
+    const egt::Rect c(40, 0, 10, 10);
+    const egt::Rect d(60, 0, 10, 10);
+    const egt::Rect e(80, 0, 10, 10);
+
+    // buffers never drawn are drawn completely
+    for (const auto& rect : {a, b, c})
+    {
+        EXPECT_EQ(screen.frame_damage(egt::Region(rect)), egt::Region(screen.box()));
+        screen.flip(egt::Region(rect));
+    }
+
+    // a buffer gets the damage of every frame since it was drawn
+    EXPECT_EQ(screen.frame_damage(egt::Region(d)), egt::Region(egt::Region::RectArray{b, c, d}));
+    screen.flip(egt::Region(d));
+    EXPECT_EQ(screen.frame_damage(egt::Region(e)), egt::Region(egt::Region::RectArray{c, d, e}));
+    screen.flip(egt::Region(e));
+
+    // drawing the same buffer again only needs its own damage
+    screen.rotate = false;
+    screen.flip(egt::Region(a));
+    EXPECT_EQ(screen.frame_damage(egt::Region(b)), egt::Region(b));
+    screen.flip(egt::Region(b));
+    screen.rotate = true;
+    screen.flip(egt::Region(c));
+
+    // a buffer that missed more frames than are kept is drawn completely
+    EXPECT_EQ(screen.frame_damage(egt::Region(d)), egt::Region(screen.box()));
+}
+
+TEST(FlipThread, Ring)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool release = false;
+
+    {
+        // the stub flip blocks until released, like a page flip waiting on vsync
+        egt::detail::FlipThread pool(0, [&](const egt::detail::FlipRequest&)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&release]() { return release; });
+        });
+        EXPECT_EQ(pool.stats().capacity, 1U);
+
+        auto wait_flips = [&pool](uint64_t flips)
+        {
+            for (auto i = 0; i < 500 && pool.stats().flips < flips; ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            return pool.stats().flips;
+        };
+
+        // the first request fills the ring until its flip completes
+        pool.enqueue(nullptr, 0, false);
+
+        std::atomic<bool> queued{false};
+        std::thread producer([&pool, &queued]()
+        {
+            pool.enqueue(nullptr, 1, false);
+            queued = true;
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_FALSE(queued);
+
+        // completing the flip wakes the producer up
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            release = true;
+        }
+        cv.notify_all();
+        producer.join();
+        EXPECT_TRUE(queued);
+
+        EXPECT_EQ(wait_flips(2), 2U);
+        EXPECT_EQ(pool.stats().blocked, 1U);
+        EXPECT_EQ(pool.stats().depth, 0U);
+        EXPECT_EQ(pool.stats().max_depth, 1U);
+
+        // give the flip thread time to go to sleep on an empty ring
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    // destroying the queue wakes up and joins the waiting flip thread
+    SUCCEED();
+}
+
+TEST(Region, Basic)
+{
+    egt::Region region;
+    EXPECT_TRUE(region.empty());
+
+    region.add(egt::Rect(0, 0, 10, 10));
+    region.add(egt::Rect(5, 5, 10, 10));
+    EXPECT_EQ(region.area(), 175);
+    EXPECT_EQ(region.extents(), egt::Rect(0, 0, 15, 15));
+    EXPECT_TRUE(region.contains(egt::Rect(0, 0, 10, 10)));
+    EXPECT_FALSE(region.contains(egt::Rect(0, 0, 15, 15)));
+    EXPECT_TRUE(region.intersects(egt::Rect(12, 12, 5, 5)));
+    EXPECT_FALSE(region.intersects(egt::Rect(12, 0, 5, 5)));
+
+    // no rectangles in a region overlap
+    egt::DefaultDim total = 0;
+    for (const auto& rect : region)
+        total += rect.area();
+    EXPECT_EQ(total, region.area());
+
+    region.subtract(egt::Rect(5, 5, 10, 10));
+    EXPECT_EQ(region.area(), 75);
+
+    region.add(egt::Rect(5, 5, 10, 10));
+    region.intersect(egt::Rect(0, 0, 5, 15));
+    EXPECT_EQ(region.size(), 1U);
+    EXPECT_EQ(region.front(), egt::Rect(0, 0, 5, 10));
+
+    // adjacent bands with the same spans are coalesced
+    egt::Region region2;
+    region2.add(egt::Rect(0, 0, 10, 5));
+    region2.add(egt::Rect(0, 5, 10, 5));
+    EXPECT_EQ(region2.size(), 1U);
+    EXPECT_EQ(region2.front(), egt::Rect(0, 0, 10, 10));
+}
+
+TEST(Region, Merge)
+{
+    egt::Region region;
+    region.merge(egt::Rect(0, 0, 10, 10), 0.25f);
+    region.merge(egt::Rect(100, 100, 10, 10), 0.25f);
+
+    // bounding box wastes too much area
+    region.merge(egt::Rect(30, 0, 10, 10), 0.25f);
+    EXPECT_EQ(region.size(), 3U);
+
+    // a rectangle in the touching band is merged
+    region.merge(egt::Rect(0, 10, 40, 10), 0.25f);
+    EXPECT_EQ(region.size(), 2U);
+    EXPECT_EQ(region.front(), egt::Rect(0, 0, 40, 20));
+    EXPECT_TRUE(region.contains(egt::Rect(100, 100, 10, 10)));
+
+    egt::Region region2;
+    region2.add(egt::Rect(0, 0, 10, 10));
+    region2.add(egt::Rect(5, 5, 10, 10));
+    region2.simplify(0.25f);
+    EXPECT_EQ(region2.size(), 1U);
+    EXPECT_EQ(region2.front(), egt::Rect(0, 0, 15, 15));
+}
+
+TEST(FrameClock, Basic)
+{
+    egt::asio::io_context io;
+    egt::FrameClock clock(io, std::chrono::milliseconds(10));
+
+    int updates = 0;
+    int paints = 0;
+    clock.on_frame([&updates](egt::FrameClock::clock::time_point) { ++updates; });
+    clock.on_frame([&updates, &paints](egt::FrameClock::clock::time_point)
+    {
+        // update always runs before paint
+        EXPECT_EQ(updates, paints + 1);
+        ++paints;
+    }, egt::FrameClock::Phase::paint);
+
+    // requests are coalesced into one frame
+    for (auto i = 0; i < 5; ++i)
+        clock.request_frame();
+    EXPECT_TRUE(clock.frame_pending());
+    io.run();
+    EXPECT_FALSE(clock.frame_pending());
+    EXPECT_EQ(paints, 1);
+
+    // the next frame is paced one interval later
+    auto first = clock.frame_time();
+    clock.request_frame();
+    io.restart();
+    io.run();
+    EXPECT_EQ(paints, 2);
+    EXPECT_GE(clock.frame_time() - first, std::chrono::milliseconds(10));
+    EXPECT_EQ(clock.stats().frames, 2U);
+
+    // a request made while painting schedules the next frame
+    bool again = true;
+    clock.on_frame([&clock, &again](egt::FrameClock::clock::time_point)
+    {
+        EXPECT_TRUE(clock.painting());
+        if (again)
+            clock.request_frame();
+        again = false;
+    }, egt::FrameClock::Phase::paint);
+    clock.request_frame();
+    io.restart();
+    io.run();
+    EXPECT_EQ(paints, 4);
+    EXPECT_FALSE(clock.frame_pending());
+}
+
 TEST(Canvas, Basic)
 {
     egt::Canvas canvas1(egt::Size(100, 100));
@@ -354,6 +930,765 @@ TEST(WidgetFlags, Basic)
     EXPECT_EQ(flags1.to_string(), "window|readonly");
 }
 
+TEST(WidgetFlags, ParallelPaint)
+{
+    egt::Application app;
+
+    egt::Frame frame;
+    auto child = std::make_shared<egt::Frame>();
+    auto grandchild = std::make_shared<egt::Widget>();
+    child->add(grandchild);
+    frame.add(child);
+
+    EXPECT_FALSE(frame.parallel_paint_tree());
+    frame.parallel_paint(true);
+    child->parallel_paint(true);
+    EXPECT_FALSE(frame.parallel_paint_tree());
+    grandchild->parallel_paint(true);
+    EXPECT_TRUE(frame.parallel_paint_tree());
+
+    // hidden widgets are not drawn, so they do not matter
+    grandchild->parallel_paint(false);
+    grandchild->hide();
+    EXPECT_TRUE(frame.parallel_paint_tree());
+
+    egt::Widget::Flags flags("parallel_paint");
+    EXPECT_TRUE(flags.is_set(egt::Widget::Flag::parallel_paint));
+}
+
+TEST(Widget, PrepareDraw)
+{
+    egt::Application app;
+
+    struct Prepared : egt::Widget
+    {
+        void prepare_draw(egt::Painter& painter) override
+        {
+            ++prepared;
+            egt::Widget::prepare_draw(painter);
+        }
+
+        int prepared{0};
+    };
+
+    egt::Frame frame;
+    auto child = std::make_shared<egt::Frame>();
+    auto visible = std::make_shared<Prepared>();
+    auto hidden = std::make_shared<Prepared>();
+    child->add(visible);
+    frame.add(child);
+    frame.add(hidden);
+    hidden->hide();
+
+    egt::Canvas canvas(egt::Size(10, 10));
+    egt::Painter painter(canvas.context());
+    frame.prepare_draw(painter);
+    EXPECT_EQ(visible->prepared, 1);
+    EXPECT_EQ(hidden->prepared, 0);
+}
+
+TEST(Widget, Opaque)
+{
+    egt::Application app;
+
+    egt::Frame frame;
+    frame.fill_flags(egt::Theme::FillFlag::solid);
+    EXPECT_FALSE(frame.opaque());
+
+    frame.occlude(true);
+    frame.fill_flags().clear();
+    EXPECT_FALSE(frame.opaque());
+
+    frame.fill_flags(egt::Theme::FillFlag::solid);
+    EXPECT_TRUE(frame.opaque());
+
+    frame.border_radius(4);
+    EXPECT_FALSE(frame.opaque());
+    frame.border_radius(0);
+
+    frame.alpha(0.5);
+    EXPECT_FALSE(frame.opaque());
+    frame.alpha(1.0);
+
+    frame.fill_flags(egt::Theme::FillFlag::blend);
+    frame.color(egt::Palette::ColorId::bg, egt::Palette::red);
+    EXPECT_TRUE(frame.opaque());
+    frame.color(egt::Palette::ColorId::bg, egt::Palette::transparent);
+    EXPECT_FALSE(frame.opaque());
+
+    frame.hide();
+    EXPECT_FALSE(frame.opaque());
+}
+
+TEST(Widget, OpaqueCustomDraw)
+{
+    egt::Application app;
+
+    // a widget with the default box, but which only draws an outline
+    struct Outline : egt::Widget
+    {
+        using egt::Widget::Widget;
+
+        void draw(egt::Painter& painter, const egt::Rect&) override
+        {
+            painter.set(egt::Palette::black);
+            painter.draw(box());
+            painter.line_width(1);
+            painter.stroke();
+        }
+    };
+
+    egt::Frame frame(egt::Rect(0, 0, 40, 40));
+    frame.fill_flags().clear();
+    egt::Widget back(frame, egt::Rect(0, 0, 40, 40));
+    back.fill_flags(egt::Theme::FillFlag::solid);
+    back.color(egt::Palette::ColorId::bg, egt::Palette::red);
+    Outline front(frame, egt::Rect(0, 0, 40, 40));
+    front.fill_flags(egt::Theme::FillFlag::solid);
+    EXPECT_FALSE(front.opaque());
+
+    egt::Canvas canvas(egt::Size(40, 40));
+    {
+        egt::Painter painter(canvas.context());
+        frame.draw(painter, frame.box());
+    }
+
+    // what is behind the outline is still drawn
+    auto surface = canvas.surface().get();
+    cairo_surface_flush(surface);
+    const auto data = cairo_image_surface_get_data(surface);
+    const auto stride = cairo_image_surface_get_stride(surface);
+    EXPECT_EQ(*reinterpret_cast<const uint32_t*>(data + 20 * stride + 20 * 4), 0xffff0000);
+}
+
+TEST(Widget, DrawAllocations)
+{
+    egt::Application app;
+
+    egt::Frame frame(egt::Rect(0, 0, 200, 200));
+    frame.fill_flags(egt::Theme::FillFlag::solid);
+
+    // an opaque child, so occlusion culling runs, and one blended over it
+    egt::Widget a(frame, egt::Rect(10, 10, 100, 100));
+    a.fill_flags(egt::Theme::FillFlag::solid);
+    a.occlude(true);
+    egt::Widget b(frame, egt::Rect(50, 50, 100, 100));
+    b.fill_flags(egt::Theme::FillFlag::blend);
+    b.border(2);
+
+    egt::Frame nested(frame, egt::Rect(120, 0, 80, 80));
+    nested.fill_flags(egt::Theme::FillFlag::solid);
+    egt::Widget c(nested, egt::Rect(0, 0, 40, 40));
+    c.fill_flags(egt::Theme::FillFlag::solid);
+    c.occlude(true);
+
+    egt::Canvas canvas(egt::Size(200, 200));
+    egt::Painter painter(canvas.context());
+
+    // the first draw sizes the buffers that are reused afterwards
+    frame.draw(painter, frame.box());
+
+    const auto before = allocation_count.load();
+    for (auto i = 0; i < 3; ++i)
+    {
+        frame.draw(painter, frame.box());
+        frame.draw(painter, egt::Rect(40, 40, 100, 100));
+    }
+    EXPECT_EQ(allocation_count.load() - before, 0U);
+}
+
+TEST(RenderCache, Basic)
+{
+    egt::Application app;
+
+    egt::Widget a;
+    egt::Widget b;
+    egt::detail::RenderCache cache;
+    cache.budget(100 * 100 * 4 * 2);
+
+    auto entry = cache.get(&a, egt::Size(100, 100));
+    ASSERT_NE(entry, nullptr);
+    EXPECT_FALSE(entry->valid);
+    cache.validate(&a);
+    EXPECT_TRUE(cache.get(&a, egt::Size(100, 100))->valid);
+    cache.invalidate(&a);
+    EXPECT_FALSE(cache.get(&a, egt::Size(100, 100))->valid);
+
+    // a surface that can never fit is refused
+    EXPECT_EQ(cache.get(&b, egt::Size(1000, 1000)), nullptr);
+
+    // a changed size replaces the surface
+    EXPECT_NE(cache.get(&b, egt::Size(100, 100)), nullptr);
+    EXPECT_EQ(cache.used(), cache.budget());
+    EXPECT_NE(cache.get(&a, egt::Size(100, 150)), nullptr);
+    EXPECT_EQ(cache.stats().evictions, 1U);
+    EXPECT_LE(cache.used(), cache.budget());
+
+    cache.clear();
+    EXPECT_EQ(cache.used(), 0U);
+}
+
+TEST(RenderCache, Alpha)
+{
+    egt::Application app;
+
+    auto& cache = egt::detail::render_cache();
+    cache.clear();
+
+    egt::Widget widget(egt::Rect(0, 0, 100, 100));
+    widget.alpha(0.5);
+    ASSERT_NE(cache.get(&widget, widget.size()), nullptr);
+    cache.validate(&widget);
+
+    // changing the alpha only changes blending
+    widget.alpha(0.25);
+    EXPECT_TRUE(cache.get(&widget, widget.size())->valid);
+
+    // any other damage invalidates the rendering
+    widget.damage();
+    EXPECT_FALSE(cache.get(&widget, widget.size())->valid);
+
+    // an opaque widget no longer needs it
+    widget.alpha(1.0);
+    EXPECT_EQ(cache.used(), 0U);
+}
+
+TEST(ImageCache, Budget)
+{
+    egt::Application app;
+
+    egt::detail::ImageCache cache;
+    cache.budget(0);
+
+    auto image = cache.get("icon:calculator.png");
+    EXPECT_EQ(cache.stats().misses, 1U);
+    EXPECT_EQ(cache.get("icon:calculator.png"), image);
+    EXPECT_EQ(cache.stats().hits, 1U);
+
+    auto scaled = cache.get("icon:calculator.png", 0.5, 0.5);
+    ASSERT_EQ(cache.size(), 2U);
+    const auto used = cache.used();
+    EXPECT_GT(used, 0U);
+
+    // surfaces that are still referenced are pinned
+    cache.budget(1);
+    EXPECT_EQ(cache.size(), 2U);
+    EXPECT_EQ(cache.stats().evictions, 0U);
+
+    scaled.reset();
+    cache.budget(1);
+    EXPECT_EQ(cache.size(), 1U);
+    EXPECT_EQ(cache.stats().evictions, 1U);
+    EXPECT_LT(cache.used(), used);
+
+    cache.clear();
+    EXPECT_EQ(cache.used(), 0U);
+}
+
+TEST(ResourceManager, Gzip)
+{
+    // gzip of "compressed resource " 8 times
+    static const unsigned char gz[] =
+    {
+        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4b, 0xce,
+        0xcf, 0x2d, 0x28, 0x4a, 0x2d, 0x2e, 0x4e, 0x4d, 0x51, 0x00, 0x52, 0xf9,
+        0xa5, 0x45, 0xc9, 0xa9, 0x0a, 0xc9, 0x83, 0x48, 0x0c, 0x00, 0x04, 0x5a,
+        0x0e, 0x8d, 0xa0, 0x00, 0x00, 0x00
+    };
+
+    std::string expected;
+    for (auto i = 0; i < 8; ++i)
+        expected += "compressed resource ";
+
+    auto& resources = egt::ResourceManager::instance();
+    resources.add("gzip", gz, sizeof(gz));
+
+    // built without zlib
+    if (resources.size("gzip") == sizeof(gz))
+    {
+        resources.remove("gzip");
+        return;
+    }
+
+    size_t len = 0;
+    auto data = resources.share("gzip", len);
+    ASSERT_EQ(len, expected.size());
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(data.get()), len), expected);
+
+    // shared data outlives trim()
+    resources.trim();
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(data.get()), len), expected);
+    data.reset();
+
+    // streaming inflates on the fly
+    resources.stream_reset("gzip");
+    std::string streamed(expected.size(), '\0');
+    for (size_t offset = 0; offset < streamed.size(); offset += 16)
+    {
+        const auto length = std::min<size_t>(16, streamed.size() - offset);
+        ASSERT_TRUE(resources.stream_read("gzip",
+                                          reinterpret_cast<unsigned char*>(&streamed[offset]),
+                                          length));
+    }
+    EXPECT_EQ(streamed, expected);
+
+    unsigned char past;
+    EXPECT_THROW(resources.stream_read("gzip", &past, 1), std::runtime_error);
+
+    // a stream on inflated data continues where it was after a trim()
+    ASSERT_NE(resources.data("gzip"), nullptr);
+    resources.stream_reset("gzip");
+    std::string resumed(expected.size(), '\0');
+    ASSERT_TRUE(resources.stream_read("gzip", reinterpret_cast<unsigned char*>(&resumed[0]), 30));
+    resources.trim();
+    ASSERT_TRUE(resources.stream_read("gzip", reinterpret_cast<unsigned char*>(&resumed[30]),
+                                      resumed.size() - 30));
+    EXPECT_EQ(resumed, expected);
+
+    resources.remove("gzip");
+
+    // a corrupt size in the trailer does not allocate it up front
+    unsigned char bad[sizeof(gz)];
+    std::memcpy(bad, gz, sizeof(gz));
+    std::memset(bad + sizeof(bad) - 4, 0xff, 4);
+    resources.add("gzip_bad", bad, sizeof(bad));
+    EXPECT_NO_THROW(resources.size("gzip_bad"));
+    EXPECT_NO_THROW(resources.data("gzip_bad"));
+    resources.remove("gzip_bad");
+}
+
+TEST(ResourceManager, Bundle)
+{
+    static const unsigned char one[] = "first resource";
+    static const unsigned char two[] = "second resource";
+
+    auto& resources = egt::ResourceManager::instance();
+    resources.add("bundle_one", one, sizeof(one));
+    resources.add("bundle_two", two, sizeof(two));
+    resources.add("bundle_two@2", two, sizeof(two));
+
+    const auto path = testing::TempDir() + "egt_resources.egtb";
+    resources.save_bundle(path, {"bundle_one", "bundle_two", "bundle_two@2"});
+    resources.remove("bundle_one");
+    resources.remove("bundle_two");
+    resources.remove("bundle_two@2");
+    EXPECT_FALSE(resources.exists("bundle_one"));
+    EXPECT_TRUE(resources.variants("bundle_two").empty());
+
+    resources.add_bundle(path);
+    EXPECT_TRUE(resources.exists("bundle_one"));
+    EXPECT_TRUE(resources.exists("bundle_two"));
+    EXPECT_FALSE(resources.exists("bundle_three"));
+
+    const auto names = resources.list();
+    EXPECT_NE(std::find(names.begin(), names.end(), "bundle_two"), names.end());
+
+    // variants in bundles are found, and stay after a removal
+    const egt::ResourceManager::ItemArray variants{"bundle_two@2"};
+    EXPECT_EQ(resources.variants("bundle_two"), variants);
+    resources.remove("bundle_two@2");
+    EXPECT_EQ(resources.variants("bundle_two"), variants);
+
+    size_t len = 0;
+    auto data = resources.share("bundle_two", len);
+    ASSERT_EQ(len, sizeof(two));
+    EXPECT_EQ(std::memcmp(data.get(), two, len), 0);
+
+    // resources are looked up before bundles
+    resources.add("bundle_one", two, sizeof(two));
+    EXPECT_EQ(resources.size("bundle_one"), sizeof(two));
+
+    static const unsigned char garbage[64] = {};
+    EXPECT_THROW(resources.add_bundle(garbage, sizeof(garbage)), std::runtime_error);
+
+    resources.clear();
+    EXPECT_FALSE(resources.exists("bundle_two"));
+    std::remove(path.c_str());
+}
+
+/*
+ * PNG data of an image filled with one color.
+ */
+static std::vector<unsigned char> png(int width, int height, uint32_t color)
+{
+    auto surface = egt::shared_cairo_surface_t(
+                       cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height),
+                       cairo_surface_destroy);
+    auto cr = egt::shared_cairo_t(cairo_create(surface.get()), cairo_destroy);
+    cairo_set_source_rgba(cr.get(), ((color >> 16) & 0xff) / 255.,
+                          ((color >> 8) & 0xff) / 255., (color & 0xff) / 255.,
+                          ((color >> 24) & 0xff) / 255.);
+    cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr.get());
+
+    std::vector<unsigned char> data;
+    cairo_surface_write_to_png_stream(surface.get(),
+                                      [](void* closure, const unsigned char* d, unsigned int length)
+    {
+        auto v = static_cast<std::vector<unsigned char>*>(closure);
+        v->insert(v->end(), d, d + length);
+        return CAIRO_STATUS_SUCCESS;
+    }, &data);
+    return data;
+}
+
+TEST(ImageCache, Variants)
+{
+    egt::Application app;
+
+    auto pixel = [](const egt::shared_cairo_surface_t& surface)
+    {
+        return *reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(surface.get()));
+    };
+
+    auto& resources = egt::ResourceManager::instance();
+    resources.add("variant_png", png(40, 20, 0xffff0000));
+    resources.add("variant_png@0.5", png(20, 10, 0xff0000ff));
+    EXPECT_EQ(resources.variants("variant_png"),
+              egt::ResourceManager::ItemArray{"variant_png@0.5"});
+
+    egt::detail::ImageCache cache;
+
+    // exact match is used as is
+    auto half = cache.get("res:variant_png", 0.5, 0.5);
+    EXPECT_EQ(cairo_image_surface_get_width(half.get()), 20);
+    EXPECT_EQ(cairo_image_surface_get_height(half.get()), 10);
+    EXPECT_EQ(pixel(half), 0xff0000ffU);
+
+    // smaller scales are scaled from the closest variant
+    auto quarter = cache.get("res:variant_png", 0.25, 0.25);
+    EXPECT_EQ(cairo_image_surface_get_width(quarter.get()), 10);
+    EXPECT_EQ(cairo_image_surface_get_height(quarter.get()), 5);
+    EXPECT_EQ(pixel(quarter), 0xff0000ffU);
+
+    // and scales closer to the original are scaled from the original
+    auto most = cache.get("res:variant_png", 0.9, 0.9);
+    EXPECT_EQ(cairo_image_surface_get_width(most.get()), 36);
+    EXPECT_EQ(pixel(most), 0xffff0000U);
+
+    resources.remove("variant_png");
+    resources.remove("variant_png@0.5");
+    EXPECT_TRUE(resources.variants("variant_png").empty());
+}
+
+TEST(ImageCache, NativeFormat)
+{
+    egt::Application app;
+
+    auto& resources = egt::ResourceManager::instance();
+    resources.add("opaque_png", png(8, 8, 0xff00ff00));
+    resources.add("translucent_png", png(8, 8, 0x8000ff00));
+
+    egt::detail::ImageCache cache;
+    cache.native_format(CAIRO_FORMAT_RGB16_565);
+
+    // opaque images are converted once, and stay converted when scaled
+    auto opaque = cache.get("res:opaque_png");
+    EXPECT_EQ(cairo_image_surface_get_format(opaque.get()), CAIRO_FORMAT_RGB16_565);
+    EXPECT_EQ(*reinterpret_cast<uint16_t*>(cairo_image_surface_get_data(opaque.get())), 0x07e0);
+    auto scaled = cache.get("res:opaque_png", 0.5, 0.5);
+    EXPECT_EQ(cairo_image_surface_get_format(scaled.get()), CAIRO_FORMAT_RGB16_565);
+
+    // anything with alpha is left alone
+    auto translucent = cache.get("res:translucent_png");
+    EXPECT_EQ(cairo_image_surface_get_format(translucent.get()), CAIRO_FORMAT_ARGB32);
+
+    // drawing an opaque image only replaces the pixels under it
+    auto target = egt::shared_cairo_surface_t(
+                      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 16, 16),
+                      cairo_surface_destroy);
+    auto cr = egt::shared_cairo_t(cairo_create(target.get()), cairo_destroy);
+    egt::Painter painter(cr);
+    painter.set(egt::Palette::red);
+    painter.paint();
+    painter.draw(egt::Point(4, 4));
+    painter.draw(egt::Image(opaque));
+    cairo_surface_flush(target.get());
+
+    auto pixel = [&target](int x, int y)
+    {
+        return reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(target.get()) +
+                                           y * cairo_image_surface_get_stride(target.get()))[x];
+    };
+    EXPECT_EQ(pixel(4, 4), 0xff00ff00U);
+    EXPECT_EQ(pixel(11, 11), 0xff00ff00U);
+    EXPECT_EQ(pixel(3, 3), 0xffff0000U);
+    EXPECT_EQ(pixel(12, 12), 0xffff0000U);
+
+    resources.remove("opaque_png");
+    resources.remove("translucent_png");
+}
+
+TEST(Image, LoadAsync)
+{
+    egt::Application app;
+
+    egt::Image result;
+    auto calls = 0;
+    auto load = egt::Image::load_async("icon:calculator.png", [&](const egt::Image & image)
+    {
+        result = image;
+        ++calls;
+    }, 0.5, 0.5);
+    EXPECT_TRUE(load.pending());
+
+    // a cancelled load never calls back
+    auto cancelled = egt::Image::load_async("icon:cursor_hand.png", [&](const egt::Image&)
+    {
+        ++calls;
+    });
+    cancelled.cancel();
+    EXPECT_FALSE(cancelled.pending());
+
+    for (auto i = 0; i < 500 && load.pending(); ++i)
+    {
+        app.event().poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(calls, 1);
+    ASSERT_FALSE(result.empty());
+    EXPECT_FLOAT_EQ(result.hscale(), 0.5);
+
+    // the decoded surface was added to the image cache
+    EXPECT_EQ(result.surface(), egt::Image("icon:calculator.png", 0.5, 0.5).surface());
+}
+
+TEST(EventLoop, AsyncWork)
+{
+    std::atomic<int> started{0};
+    auto done = 0;
+    {
+        egt::Application app;
+
+        app.event().async_work([&started]() { ++started; return true; }, [&done]() { ++done; });
+        app.event().async_work([]() { return false; }, [&done]() { ++done; });
+        for (auto i = 0; i < 500 && !done; ++i)
+        {
+            app.event().poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(done, 1);
+
+        // still running when the application goes away
+        app.event().async_work([&started]()
+        {
+            ++started;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return true;
+        }, [&done]() { ++done; });
+        while (started < 2)
+            std::this_thread::yield();
+    }
+
+    // the worker was joined, and its result dropped
+    EXPECT_EQ(started, 2);
+    EXPECT_EQ(done, 1);
+}
+
+TEST(Image, ErawV2)
+{
+    egt::Application app;
+
+    // uncompressed 4x2 ARGB32, pixel data at offset 64
+    const uint32_t header[] = {0x50502AA3, 4, 2, 0, 16, 0, 64, 32};
+    uint32_t pixels[8];
+    for (auto i = 0; i < 8; ++i)
+        pixels[i] = 0xff000000 | (i * 0x10101);
+
+    const auto path = testing::TempDir() + "egt_v2.eraw";
+    {
+        std::ofstream o(path, std::ios_base::binary);
+        o.write(reinterpret_cast<const char*>(header), sizeof(header));
+        const char padding[64 - sizeof(header)] = {};
+        o.write(padding, sizeof(padding));
+        o.write(reinterpret_cast<const char*>(pixels), sizeof(pixels));
+    }
+
+    egt::Image image("file:" + path);
+    ASSERT_FALSE(image.empty());
+    EXPECT_EQ(image.size(), egt::Size(4, 2));
+
+    auto surface = image.surface().get();
+    ASSERT_EQ(cairo_image_surface_get_format(surface), CAIRO_FORMAT_ARGB32);
+    ASSERT_EQ(cairo_image_surface_get_stride(surface), 16);
+    EXPECT_EQ(std::memcmp(cairo_image_surface_get_data(surface), pixels, sizeof(pixels)), 0);
+}
+
+TEST(ImageAtlas, Basic)
+{
+    egt::Application app;
+
+    egt::Image image(egt::shared_cairo_surface_t(
+                         cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 64, 32),
+                         cairo_surface_destroy));
+    egt::ImageAtlas atlas(image);
+    atlas.add("left", egt::Rect(0, 0, 32, 32));
+    atlas.add("right", egt::Rect(32, 0, 32, 32));
+    EXPECT_THROW(atlas.add("outside", egt::Rect(48, 0, 32, 32)), std::out_of_range);
+    EXPECT_EQ(atlas.size(), 2U);
+    EXPECT_TRUE(atlas.image("missing").empty());
+
+    // images use the pixels of the atlas in place
+    auto data = cairo_image_surface_get_data(image.surface().get());
+    auto right = atlas.image("right");
+    EXPECT_EQ(right.size(), egt::Size(32, 32));
+    EXPECT_EQ(cairo_image_surface_get_data(right.surface().get()), data + 32 * 4);
+
+    egt::add_image_atlas("test", atlas);
+    egt::Image left("atlas:test/left");
+    EXPECT_EQ(left.size(), egt::Size(32, 32));
+    EXPECT_EQ(cairo_image_surface_get_data(left.surface().get()), data);
+    EXPECT_THROW(egt::Image("atlas:test/missing"), std::runtime_error);
+    egt::remove_image_atlas("test");
+}
+
+static double total_alpha(const egt::Canvas& canvas)
+{
+    auto surface = canvas.surface().get();
+    cairo_surface_flush(surface);
+    const auto data = cairo_image_surface_get_data(surface);
+    const auto stride = cairo_image_surface_get_stride(surface);
+    double total = 0;
+    for (auto y = 0; y < cairo_image_surface_get_height(surface); ++y)
+        for (auto x = 0; x < cairo_image_surface_get_width(surface); ++x)
+            total += data[y * stride + x * 4 + 3];
+    return total;
+}
+
+TEST(GlyphAtlas, Basic)
+{
+    const egt::Font font(16);
+    egt::GlyphAtlas atlas(font, "abc a");
+    EXPECT_EQ(atlas.size(), 4U);
+    EXPECT_TRUE(atlas.contains('a'));
+    EXPECT_TRUE(atlas.contains(' '));
+    EXPECT_FALSE(atlas.contains('d'));
+    EXPECT_THROW(egt::GlyphAtlas(font, "\xff"), std::runtime_error);
+
+    const auto name = testing::TempDir() + "egt_glyphs";
+    atlas.save(name);
+    egt::GlyphAtlas loaded(font, "file:" + name + ".eraw", "file:" + name + ".glyphs");
+    EXPECT_EQ(loaded.size(), atlas.size());
+    EXPECT_EQ(loaded.atlas().size(), atlas.atlas().size());
+    EXPECT_TRUE(loaded.contains('c'));
+
+    // the glyphs are not used for the font with other font options
+    auto scaled_font = font.scaled_font();
+    EXPECT_TRUE(loaded.matches(scaled_font));
+    cairo_matrix_t font_matrix;
+    cairo_matrix_t ctm;
+    cairo_scaled_font_get_font_matrix(scaled_font, &font_matrix);
+    cairo_scaled_font_get_ctm(scaled_font, &ctm);
+    std::unique_ptr<cairo_font_options_t, decltype(&cairo_font_options_destroy)>
+    options(cairo_font_options_create(), cairo_font_options_destroy);
+    cairo_scaled_font_get_font_options(scaled_font, options.get());
+    cairo_font_options_set_antialias(options.get(), CAIRO_ANTIALIAS_NONE);
+    egt::shared_cairo_scaled_font_t aliased(cairo_scaled_font_create(cairo_scaled_font_get_font_face(scaled_font),
+                                            &font_matrix, &ctm, options.get()),
+                                            cairo_scaled_font_destroy);
+    EXPECT_FALSE(loaded.matches(aliased.get()));
+
+    // glyphs from the atlas look like the ones drawn by cairo
+    egt::Canvas expected(egt::Size(100, 30));
+    {
+        egt::Painter painter(expected.context());
+        painter.set(font);
+        painter.set(egt::Palette::black);
+        auto cr = painter.context().get();
+        cairo_move_to(cr, 10, 20);
+        cairo_show_text(cr, "cab d");
+    }
+
+    egt::Canvas drawn(egt::Size(100, 30));
+    {
+        egt::Painter painter(drawn.context());
+        painter.set(egt::Palette::black);
+        loaded.draw(painter, egt::Point(10, 20), "cab d");
+    }
+
+    EXPECT_GT(total_alpha(expected), 0);
+    EXPECT_NEAR(total_alpha(drawn), total_alpha(expected), total_alpha(expected) * 0.02);
+
+    // widgets draw with registered atlases
+    egt::add_glyph_atlas(loaded);
+    egt::Canvas registered(egt::Size(100, 30));
+    {
+        egt::Painter painter(registered.context());
+        painter.set(font);
+        painter.set(egt::Palette::black);
+        auto cr = painter.context().get();
+        cairo_glyph_t* glyphs = nullptr;
+        int count = 0;
+        ASSERT_EQ(cairo_scaled_font_text_to_glyphs(cairo_get_scaled_font(cr), 10, 20,
+                  "cab d", 5, &glyphs, &count, nullptr, nullptr, nullptr),
+                  CAIRO_STATUS_SUCCESS);
+        egt::detail::show_glyphs(cr, glyphs, count);
+        cairo_glyph_free(glyphs);
+    }
+    egt::remove_glyph_atlas(font);
+
+    EXPECT_NEAR(total_alpha(registered), total_alpha(drawn), 0.001);
+}
+
+#ifdef EGT_HAS_SVG
+TEST(SvgImage, Cache)
+{
+    const auto path = testing::TempDir() + "egt_cache.svg";
+    auto write = [&path](int width)
+    {
+        std::ofstream out(path);
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"10\">"
+            "<rect id=\"left\" x=\"0\" y=\"0\" width=\"10\" height=\"10\" fill=\"red\"/>"
+            "<rect id=\"right\" x=\"10\" y=\"0\" width=\"10\" height=\"10\" fill=\"blue\"/>"
+            "</svg>";
+    };
+    write(20);
+
+    auto& cache = egt::detail::image_cache();
+    cache.clear();
+
+    egt::SvgImage svg("file:" + path);
+    auto whole = svg.render();
+    EXPECT_EQ(whole.size(), egt::Size(20, 10));
+    const auto entries = cache.size();
+    EXPECT_FALSE(svg.render().empty());
+    EXPECT_EQ(cache.size(), entries);
+    EXPECT_FALSE(svg.render("#left").empty());
+    EXPECT_EQ(cache.size(), entries + 1);
+
+    // every image gets its own pixels, so drawing into one changes no other
+    EXPECT_NE(svg.render().surface(), whole.surface());
+
+    // another instance shares the renderings
+    egt::SvgImage other("file:" + path);
+    EXPECT_FALSE(other.render().empty());
+    EXPECT_EQ(cache.size(), entries + 1);
+
+    // the size is part of the key
+    other.size(egt::SizeF(40, 0));
+    auto large = other.render();
+    EXPECT_EQ(large.size(), egt::Size(40, 20));
+    EXPECT_EQ(cache.size(), entries + 2);
+
+    // without an application, prerender() renders right away
+    const auto box = svg.id_box("#right");
+    svg.prerender("#right", box);
+    EXPECT_EQ(cache.size(), entries + 3);
+    EXPECT_FALSE(svg.render("#right", box).empty());
+    EXPECT_EQ(cache.size(), entries + 3);
+
+    // a changed file is parsed and rendered again
+    write(30);
+    egt::SvgImage changed("file:" + path);
+    EXPECT_EQ(changed.render().size(), egt::Size(30, 10));
+
+    egt::SvgImage::clear_cache();
+    cache.clear();
+    std::remove(path.c_str());
+}
+#endif
+
 TEST(AlignFlags, Basic)
 {
     bool state = false;
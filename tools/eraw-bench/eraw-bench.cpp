@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <erawimage.h>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+using egt::detail::ErawImage;
+
+struct Stream
+{
+    const std::vector<unsigned char>* data;
+    size_t offset;
+};
+
+static cairo_status_t read_stream(void* closure, unsigned char* data, unsigned int length)
+{
+    auto stream = static_cast<Stream*>(closure);
+    if (stream->offset + length > stream->data->size())
+        return CAIRO_STATUS_READ_ERROR;
+    memcpy(data, stream->data->data() + stream->offset, length);
+    stream->offset += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static std::vector<unsigned char> read_file(const std::string& path)
+{
+    std::ifstream i(path, std::ios_base::binary);
+    return {std::istreambuf_iterator<char>(i), std::istreambuf_iterator<char>()};
+}
+
+/*
+ * Run a decoder repeatedly and print the average time of one decode.
+ */
+template<class Decode>
+static bool bench(const std::string& name, size_t bytes, size_t pixels,
+                  int iterations, Decode&& decode)
+{
+    // warm up caches and page in the source
+    if (!decode())
+        return false;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < iterations; ++i)
+        decode();
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto us = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+    std::printf("  %-16s %10zu bytes %12.1f us %10.1f Mpixel/s\n",
+                name.c_str(), bytes, us, pixels / us);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("eraw-bench", "eraw decode benchmark against png");
+    options.add_options()
+    ("h,help", "help")
+    ("n,iterations", "decodes per format",
+     cxxopts::value<int>()->default_value("100"))
+    ("positional", "PNG...", cxxopts::value<std::vector<std::string>>())
+    ;
+    options.positional_help("PNG...");
+
+    options.parse_positional({"positional"});
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help"))
+    {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (!result.count("positional"))
+    {
+        std::cerr << options.help() << std::endl;
+        return 1;
+    }
+
+    const auto iterations = std::max(1, result["iterations"].as<int>());
+    const auto tmp = (std::filesystem::temp_directory_path() / "eraw-bench.eraw").string();
+
+    for (auto& in : result["positional"].as<std::vector<std::string>>())
+    {
+        const auto png = read_file(in);
+
+        auto decode_png = [&png]()
+        {
+            Stream stream{&png, 0};
+            auto surface = cairo_image_surface_create_from_png_stream(read_stream, &stream);
+            const auto ok = cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS;
+            cairo_surface_destroy(surface);
+            return ok;
+        };
+
+        auto surface =
+            egt::shared_cairo_surface_t(cairo_image_surface_create_from_png(in.c_str()),
+                                        cairo_surface_destroy);
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS ||
+            cairo_image_surface_get_format(surface.get()) != CAIRO_FORMAT_ARGB32)
+        {
+            std::cerr << "error: unable to open argb32 png " << in << std::endl;
+            continue;
+        }
+
+        const auto data = cairo_image_surface_get_data(surface.get());
+        const uint32_t width = cairo_image_surface_get_width(surface.get());
+        const uint32_t height = cairo_image_surface_get_height(surface.get());
+        const uint32_t stride = cairo_image_surface_get_stride(surface.get());
+        const size_t pixels = static_cast<size_t>(width) * height;
+
+        std::cout << in << " " << width << "x" << height << std::endl;
+
+        bench("png", png.size(), pixels, iterations, decode_png);
+
+        ErawImage::save(tmp, data, width, height);
+        const auto v1 = read_file(tmp);
+
+        ErawImage::save_v2(tmp, data, ErawImage::Format::argb32, width, height, stride,
+                           ErawImage::Compression::rle);
+        const auto v2rle = read_file(tmp);
+
+        ErawImage::save_v2(tmp, data, ErawImage::Format::argb32, width, height, stride,
+                           ErawImage::Compression::none);
+        const auto v2raw = read_file(tmp);
+
+        auto decode_memory = [](const std::vector<unsigned char>& eraw)
+        {
+            return [&eraw]()
+            {
+                return !!ErawImage::load(eraw.data(), eraw.size());
+            };
+        };
+
+        bench("eraw v1", v1.size(), pixels, iterations, decode_memory(v1));
+        bench("eraw v2 rle", v2rle.size(), pixels, iterations, decode_memory(v2rle));
+        bench("eraw v2 raw", v2raw.size(), pixels, iterations, decode_memory(v2raw));
+        // only maps the file, the pixels are paged in when first drawn
+        bench("eraw v2 mmap", v2raw.size(), pixels, iterations, [&tmp]()
+        {
+            return !!ErawImage::load(tmp);
+        });
+
+        std::remove(tmp.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2018 Microchip Technology Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <cxxopts.hpp>
+#include <erawimage.h>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("eraw-convert", "eraw image format converter");
+    options.add_options()
+    ("h,help", "help")
+    ("i,input-format", "input format (png)",
+     cxxopts::value<std::string>()->default_value("png"))
+    ("o,output-format", "output format (eraw, png, raw)",
+     cxxopts::value<std::string>()->default_value("eraw"))
+    ("v,version", "eraw output version (1, 2)",
+     cxxopts::value<int>()->default_value("1"))
+    ("p,pixel-format", "eraw v2 pixel format (argb32, rgb565, a8)",
+     cxxopts::value<std::string>()->default_value("argb32"))
+    ("c,compression", "eraw v2 compression (none, rle)",
+     cxxopts::value<std::string>()->default_value("rle"))
+    ("a,alignment", "eraw v2 pixel data alignment in bytes",
+     cxxopts::value<uint32_t>()->default_value("64"))
+    ("positional", "SOURCE DEST", cxxopts::value<std::vector<std::string>>())
+    ;
+    options.positional_help("SOURCE DEST");
+
+    options.parse_positional({"positional"});
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help"))
+    {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    if (result.count("positional") != 2)
+    {
+        std::cerr << options.help() << std::endl;
+        return 1;
+    }
+
+    auto& positional = result["positional"].as<std::vector<std::string>>();
+
+    std::string in = positional[0];
+    std::string out = positional[1];
+
+    egt::shared_cairo_surface_t surface;
+
+    if (result["input-format"].as<std::string>() == "png")
+    {
+        surface =
+            egt::shared_cairo_surface_t(cairo_image_surface_create_from_png(in.c_str()),
+                                        cairo_surface_destroy);
+    }
+    else if (result["input-format"].as<std::string>() == "eraw")
+    {
+        egt::detail::ErawImage e;
+        surface = e.load(in);
+    }
+    else
+    {
+        std::cerr << "error: unknown input-format " <<
+                  result["input-format"].as<std::string>() << std::endl;
+        return 1;
+    }
+
+    if (!surface ||
+        cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+    {
+        std::cerr << "error: unable to open input " << in << std::endl;
+        return 1;
+    }
+
+    const auto data = cairo_image_surface_get_data(surface.get());
+    const auto width = cairo_image_surface_get_width(surface.get());
+    const auto height = cairo_image_surface_get_height(surface.get());
+
+    if (result["output-format"].as<std::string>() == "eraw" &&
+        result["version"].as<int>() == 1)
+    {
+        if (cairo_image_surface_get_format(surface.get()) != CAIRO_FORMAT_ARGB32)
+        {
+            std::cerr << "error: eraw v1 only supports argb32 input" << std::endl;
+            return 1;
+        }
+
+        egt::detail::ErawImage e;
+        e.save(out, data, width, height);
+    }
+    else if (result["output-format"].as<std::string>() == "eraw")
+    {
+        using egt::detail::ErawImage;
+
+        ErawImage::Format format;
+        const auto& f = result["pixel-format"].as<std::string>();
+        if (f == "argb32")
+            format = ErawImage::Format::argb32;
+        else if (f == "rgb565")
+            format = ErawImage::Format::rgb565;
+        else if (f == "a8")
+            format = ErawImage::Format::a8;
+        else
+        {
+            std::cerr << "error: unknown pixel-format " << f << std::endl;
+            return 1;
+        }
+
+        ErawImage::Compression compression;
+        const auto& c = result["compression"].as<std::string>();
+        if (c == "none")
+            compression = ErawImage::Compression::none;
+        else if (c == "rle")
+            compression = ErawImage::Compression::rle;
+        else
+        {
+            std::cerr << "error: unknown compression " << c << std::endl;
+            return 1;
+        }
+
+        // let cairo convert the pixels to the target format
+        auto target = surface;
+        if (cairo_image_surface_get_format(surface.get()) != ErawImage::cairo_format(format))
+        {
+            target =
+                egt::shared_cairo_surface_t(cairo_image_surface_create(ErawImage::cairo_format(format),
+                                            width, height),
+                                            cairo_surface_destroy);
+            auto cr = cairo_create(target.get());
+            cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_surface(cr, surface.get(), 0, 0);
+            cairo_paint(cr);
+            cairo_destroy(cr);
+            cairo_surface_flush(target.get());
+        }
+
+        if (!ErawImage::save_v2(out, cairo_image_surface_get_data(target.get()),
+                                format, width, height,
+                                cairo_image_surface_get_stride(target.get()),
+                                compression, result["alignment"].as<uint32_t>()))
+        {
+            std::cerr << "error: unable to write to file file " << out << std::endl;
+            return 1;
+        }
+    }
+    else if (result["output-format"].as<std::string>() == "raw")
+    {
+        auto size = cairo_image_surface_get_stride(surface.get()) * height;
+        std::ofstream o(out, std::ios_base::binary);
+        if (!o.is_open())
+        {
+            std::cerr << "error: unable to write to file file " << out << std::endl;
+            return 1;
+        }
+
+        o.write(reinterpret_cast<const char*>(data), size);
+        o.close();
+    }
+    else if (result["output-format"].as<std::string>() == "png")
+    {
+        if (cairo_surface_write_to_png(surface.get(), out.c_str()) != CAIRO_STATUS_SUCCESS)
+        {
+            std::cerr << "error: unable to write to file file " << out << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cerr << "error: unknown output-format " <<
+                  result["output-format"].as<std::string>() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -5,6 +5,8 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
 #include <egt/ui>
 #include <iostream>
 #include <string>
@@ -40,6 +42,8 @@ static void InitErawHFile(void);
 static void EndErawHFile(void);
 static void WriteTableIndexFile(void);
 static void ReadTableIndexFile(void);
+static int PackAtlas(const string& name, const vector<string>& pngs, int max_width);
+static int RenderGlyphAtlas(const string& name, const Font& font, const string& characters);
 
 constexpr uint32_t hash_str_to_uint32(const char* data)
 {
@@ -301,6 +305,145 @@ static void EndErawHFile(void)
     erawmap.close();
 }
 
+typedef struct
+{
+    string name;
+    shared_cairo_surface_t surface;
+    Rect rect;
+} atlas_st;
+
+/*
+ * Pack PNG files into one atlas image, NAME.eraw, and write the position of
+ * each one to the atlas index, NAME.atlas, for ImageAtlas.
+ *
+ * Images are placed on shelves, tallest first, in an atlas about as wide as
+ * it is tall.
+ */
+static int PackAtlas(const string& name, const vector<string>& pngs, int max_width)
+{
+    vector<atlas_st> entries;
+    DefaultDim widest = 0;
+    double area = 0;
+    for (auto& png : pngs)
+    {
+        atlas_st entry;
+        auto slash = png.find_last_of('/');
+        entry.name = slash == string::npos ? png : png.substr(slash + 1);
+        entry.surface =
+            shared_cairo_surface_t(cairo_image_surface_create_from_png(png.c_str()),
+                                   cairo_surface_destroy);
+        if (cairo_surface_status(entry.surface.get()) != CAIRO_STATUS_SUCCESS)
+        {
+            cerr << "unable to open " << png << endl;
+            return 1;
+        }
+
+        entry.rect.size(Size(cairo_image_surface_get_width(entry.surface.get()),
+                             cairo_image_surface_get_height(entry.surface.get())));
+        widest = std::max(widest, entry.rect.width());
+        area += entry.rect.width() * entry.rect.height();
+        entries.push_back(entry);
+    }
+
+    if (widest > max_width)
+    {
+        cerr << "image wider than the atlas width " << max_width << endl;
+        return 1;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const atlas_st & a, const atlas_st & b)
+    {
+        return a.rect.height() > b.rect.height();
+    });
+
+    const auto width = std::min(max_width,
+                                std::max(widest, static_cast<DefaultDim>(std::ceil(std::sqrt(area)))));
+    DefaultDim x = 0;
+    DefaultDim y = 0;
+    DefaultDim shelf = 0;
+    for (auto& entry : entries)
+    {
+        if (x + entry.rect.width() > width)
+        {
+            y += shelf;
+            x = 0;
+            shelf = 0;
+        }
+
+        entry.rect.point(Point(x, y));
+        x += entry.rect.width();
+        shelf = std::max(shelf, entry.rect.height());
+    }
+    const auto height = y + shelf;
+
+    auto atlas =
+        shared_cairo_surface_t(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height),
+                               cairo_surface_destroy);
+    auto cr = shared_cairo_t(cairo_create(atlas.get()), cairo_destroy);
+    cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+
+    ofstream index(name + ".atlas");
+    if (!index.is_open())
+    {
+        cerr << name << ".atlas open ERROR!" << endl;
+        return 1;
+    }
+
+    index << "# x y width height name" << endl;
+    for (auto& entry : entries)
+    {
+        cairo_set_source_surface(cr.get(), entry.surface.get(),
+                                 entry.rect.x(), entry.rect.y());
+        cairo_rectangle(cr.get(), entry.rect.x(), entry.rect.y(),
+                        entry.rect.width(), entry.rect.height());
+        cairo_fill(cr.get());
+
+        index << entry.rect.x() << " " << entry.rect.y() << " "
+              << entry.rect.width() << " " << entry.rect.height() << " "
+              << entry.name << endl;
+    }
+    index.close();
+
+    cairo_surface_flush(atlas.get());
+    if (!detail::ErawImage::save_v2(name + ".eraw",
+                                    cairo_image_surface_get_data(atlas.get()),
+                                    detail::ErawImage::Format::argb32,
+                                    width, height,
+                                    cairo_image_surface_get_stride(atlas.get())))
+    {
+        cerr << name << ".eraw write ERROR!" << endl;
+        return 1;
+    }
+
+    cout << "Packed " << entries.size() << " images into " << width << "x" << height
+         << " atlas " << name << ".eraw and " << name << ".atlas" << endl;
+    return 0;
+}
+
+/*
+ * Render the glyphs of a font into an A8 atlas image, NAME.eraw, and write
+ * the position of each one to the glyph index, NAME.glyphs, for GlyphAtlas.
+ */
+static int RenderGlyphAtlas(const string& name, const Font& font, const string& characters)
+{
+    try
+    {
+        GlyphAtlas atlas(font, characters);
+        atlas.save(name);
+
+        cout << "Rendered " << atlas.size() << " glyphs into " << atlas.atlas().width()
+             << "x" << atlas.atlas().height() << " atlas " << name << ".eraw and "
+             << name << ".glyphs" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
 
 int main(int argc, char** argv)
 {
@@ -311,6 +454,19 @@ int main(int argc, char** argv)
     ("e,endtoken", "end token of eraw.h")
     ("i,input-format", "input format (svg, png)",
      cxxopts::value<string>()->default_value("svg"))
+    ("a,atlas", "pack the PNG SOURCE files into atlas NAME",
+     cxxopts::value<string>())
+    ("w,atlas-width", "maximum width of the atlas",
+     cxxopts::value<int>()->default_value("1024"))
+    ("g,glyph-atlas", "render the glyphs of a font into atlas NAME",
+     cxxopts::value<string>())
+    ("font-face", "font face of the glyph atlas",
+     cxxopts::value<string>()->default_value(Font::DEFAULT_FACE))
+    ("font-size", "font size of the glyph atlas",
+     cxxopts::value<float>()->default_value("16"))
+    ("font-bold", "render bold glyphs")
+    ("characters", "UTF-8 characters of the glyph atlas, printable ASCII and Latin-1 by default",
+     cxxopts::value<string>())
     ("positional", "SOURCE", cxxopts::value<vector<string>>())
     ;
     options.positional_help("SOURCE");
@@ -344,6 +500,31 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    if (result.count("atlas"))
+    {
+        if (!result.count("positional"))
+        {
+            cerr << options.help() << endl;
+            return 1;
+        }
+
+        return PackAtlas(result["atlas"].as<string>(),
+                         result["positional"].as<vector<string>>(),
+                         result["atlas-width"].as<int>());
+    }
+
+    if (result.count("glyph-atlas"))
+    {
+        const Font font(result["font-face"].as<string>(),
+                        result["font-size"].as<float>(),
+                        result.count("font-bold") ? Font::Weight::bold : Font::Weight::normal);
+
+        return RenderGlyphAtlas(result["glyph-atlas"].as<string>(), font,
+                                result.count("characters") ?
+                                result["characters"].as<string>() :
+                                GlyphAtlas::default_characters());
+    }
+
     if (result.count("positional") != 1)
     {
         cerr << options.help() << endl;